@@ -0,0 +1,162 @@
+
+// External imports
+import java.io.*;
+
+// Local imports
+import vlc.image.ByteBufferImage;
+import vlc.net.content.image.ImageBuilder;
+import vlc.net.content.image.MultiPageImage;
+
+/**
+ * Test that a page which fails to decode doesn't stop the other pages of a
+ * multi-page image from being decoded. A two page TIFF is built in memory
+ * where the first page uses a compression scheme the library doesn't know
+ * and the second is a plain 2x2 grayscale image. The pages are decoded in
+ * turn, more than once, and every decode of the second page must work.
+ *
+ * @author Justin Couch
+ * @version $Revision: 1.1 $
+ */
+public class PageErrorTest
+{
+    /** Number of directory entries in each page */
+    private static final int NUM_ENTRIES = 9;
+
+    /** Size of each page directory in bytes */
+    private static final int IFD_SIZE = 2 + NUM_ENTRIES * 12 + 4;
+
+    /** Offset of the first page directory */
+    private static final int IFD_OFFSET = 16;
+
+    /**
+     * Build a little endian TIFF file holding two 2x2 8 bit gray pages.
+     * The pixels of both pages come right after the header.
+     */
+    private static byte[] buildImage()
+    {
+        byte[] data = new byte[IFD_OFFSET + 2 * IFD_SIZE];
+
+        data[0] = 'I';
+        data[1] = 'I';
+        putShort(data, 2, 42);
+        putInt(data, 4, IFD_OFFSET);
+
+        for(int i = 0; i < 4; i++)
+        {
+            data[8 + i] = (byte)(10 * (i + 1));
+            data[12 + i] = (byte)(50 * (i + 1));
+        }
+
+        // compression 99 doesn't exist, so the first page can't be decoded
+        putPage(data, IFD_OFFSET, 8, 99, IFD_OFFSET + IFD_SIZE);
+        putPage(data, IFD_OFFSET + IFD_SIZE, 12, 1, 0);
+
+        return data;
+    }
+
+    /**
+     * Write a page directory describing a 2x2 8 bit gray strip.
+     */
+    private static void putPage(byte[] data,
+                                int offset,
+                                int stripOffset,
+                                int compression,
+                                int next)
+    {
+        int[][] entries = {
+            { 256, 3, 2 },              // width
+            { 257, 3, 2 },              // height
+            { 258, 3, 8 },              // bits per sample
+            { 259, 3, compression },
+            { 262, 3, 1 },              // black is zero
+            { 273, 4, stripOffset },
+            { 277, 3, 1 },              // samples per pixel
+            { 278, 3, 2 },              // rows per strip
+            { 279, 4, 4 },              // strip byte count
+        };
+
+        putShort(data, offset, NUM_ENTRIES);
+        offset += 2;
+
+        for(int i = 0; i < NUM_ENTRIES; i++)
+        {
+            putShort(data, offset, entries[i][0]);
+            putShort(data, offset + 2, entries[i][1]);
+            putInt(data, offset + 4, 1);
+
+            if(entries[i][1] == 3)
+                putShort(data, offset + 8, entries[i][2]);
+            else
+                putInt(data, offset + 8, entries[i][2]);
+
+            offset += 12;
+        }
+
+        putInt(data, offset, next);
+    }
+
+    private static void putShort(byte[] data, int offset, int value)
+    {
+        data[offset] = (byte)value;
+        data[offset + 1] = (byte)(value >> 8);
+    }
+
+    private static void putInt(byte[] data, int offset, int value)
+    {
+        putShort(data, offset, value);
+        putShort(data, offset + 2, value >> 16);
+    }
+
+    /**
+     * Decode one page, returning true if it worked.
+     */
+    private static boolean decode(MultiPageImage pages, int page)
+    {
+        try
+        {
+            ByteBufferImage image = (ByteBufferImage)
+                pages.decodePage(page, ImageBuilder.BYTEBUFFERIMAGE_REQD);
+
+            System.out.println("page " + page + " decoded " +
+                               image.getWidth() + "x" + image.getHeight());
+
+            return true;
+        }
+        catch(IOException ioe)
+        {
+            System.out.println("page " + page + " failed: " +
+                               ioe.getMessage());
+
+            return false;
+        }
+    }
+
+    public static void main(String[] args)
+        throws IOException
+    {
+        byte[] data = buildImage();
+
+        ImageBuilder builder = new ImageBuilder("tiff");
+        MultiPageImage pages = builder.openPages(data, 0, data.length);
+
+        boolean passed = (pages.getPageCount() == 2);
+
+        try
+        {
+            for(int i = 0; i < 2; i++)
+            {
+                passed &= !decode(pages, 0);
+                passed &= decode(pages, 1);
+            }
+        }
+        finally
+        {
+            pages.close();
+        }
+
+        System.out.println(passed ? "PASSED" : "FAILED");
+
+        if(!passed)
+            System.exit(1);
+    }
+}
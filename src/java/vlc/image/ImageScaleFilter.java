@@ -33,6 +33,9 @@ public class ImageScaleFilter {
 	/** The filter type currently in use */
 	private String filterType;
 	
+	/** Most threads to scale with, 0 for one per processor */
+	private int numThreads;
+	
 	/**
 	 * Static initializer to set up the native library and determine which
 	 * filter types are available.
@@ -42,7 +45,9 @@ public class ImageScaleFilter {
 	}
 	
 	/**
-	 * Construct a new image scale filter of the specified type
+	 * Construct a new image scale filter of the specified type. The types
+	 * built into the native library are AreaAverage, Bilinear, Bicubic,
+	 * Mitchell and Lanczos3. Case is ignored.
 	 *
 	 * @param type The scale filter type to use.
 	 * @throws IllegalArgumentException if an invalid type is specified
@@ -52,20 +57,47 @@ public class ImageScaleFilter {
 			throw new IllegalArgumentException( "Unsupported scale filter type " + type );
 		}
 		
-		filterType = type;
-		boolean valid = false;
+		filterType = null;
 		
-		// ensure that the library can handle this filter type
+		// ensure that the library can handle this filter type, using the
+		// library's own spelling of the name since it matches exactly
 		for( int i = 0; i < validTypes.length; i++ ) {
 			if( type.equalsIgnoreCase( validTypes[i] ) ) {
-				valid = true;
+				filterType = validTypes[i];
 				break;
 			}
 		}
 		
-		if( !valid ) {
+		if( filterType == null ) {
 			throw new IllegalArgumentException( "Unsupported scale filter type " + type );
 		}
+		
+		numThreads = ImageScaleFilterDriver.getDefaultThreadCount( );
+	}
+	
+	/**
+	 * Set the most threads each scale is split between. Images too small
+	 * to be worth splitting use fewer, and parts only get a thread of their
+	 * own while a processor is free. The scaled image is the same however
+	 * many threads are used.
+	 *
+	 * @param threads The most threads to use, 0 for one per processor
+	 * @throws IllegalArgumentException if threads is negative
+	 */
+	public void setThreadCount( int threads ) {
+		if( threads < 0 ) {
+			throw new IllegalArgumentException( "Invalid thread count " + threads );
+		}
+		numThreads = threads;
+	}
+	
+	/**
+	 * Get the most threads each scale is split between.
+	 *
+	 * @return The thread count, or 0 for one thread per processor
+	 */
+	public int getThreadCount( ) {
+		return( numThreads );
 	}
 	
 	/**
@@ -77,19 +109,23 @@ public class ImageScaleFilter {
 	 * @param dstWidth the width of the scaled image to return
 	 * @param dstHeight the height of the scaled image to return
 	 * @return The scaled image
+	 * @throws IllegalArgumentException if the scaled size is not positive
 	 */
 	public ByteBufferImage getScaledImage( ByteBufferImage srcImage, int dstWidth, int dstHeight ) {
 		
+		checkSize( dstWidth, dstHeight );
+		
 		ImageScaleFilterDriver driver = new ImageScaleFilterDriver( );
 		
-		// our id, in the range 0 to MAX_THREADS-1
-		int thread_id = driver.acquireThreadId( );
+		// our native scaling context
+		long context = driver.acquireContext( );
 		
 		ByteBufferImage dstImage = null;
 		
 		try {
 			// initialize
-			driver.initScaleFilter( thread_id, filterType );
+			driver.initScaleFilter( context, filterType );
+			driver.setThreadCount( context, numThreads );
 			
 			int srcWidth = srcImage.getWidth( );
 			int srcHeight = srcImage.getHeight( );
@@ -99,7 +135,7 @@ public class ImageScaleFilter {
 			ByteBuffer dstBuffer = ByteBuffer.allocateDirect( dstWidth * dstHeight * numCmp );
 			dstBuffer.order( ByteOrder.nativeOrder( ) );
 			
-			driver.scaleImage( thread_id, srcWidth, srcHeight, numCmp, srcBuffer,
+			driver.scaleImage( context, srcWidth, srcHeight, numCmp, srcBuffer,
 				dstWidth, dstHeight, dstBuffer );
 			
 			dstImage = new ByteBufferImage( dstWidth, dstHeight, numCmp, srcImage.isGrayScale( ), dstBuffer );
@@ -110,7 +146,7 @@ public class ImageScaleFilter {
 		}
 		finally {
 			// we have finished with the native library now
-			driver.releaseThreadId( thread_id );
+			driver.releaseContext( context );
 		}
 		return( dstImage );
 	}
@@ -127,25 +163,30 @@ public class ImageScaleFilter {
 	 * @param dstWidth the width of the scaled image to return
 	 * @param dstHeight the height of the scaled image to return
 	 * @return The image data of the scaled image
+	 * @throws IllegalArgumentException if either size is not positive
 	 */
 	public ByteBuffer getScaledImage( int srcWidth, int srcHeight, int numCmp, ByteBuffer srcBuffer, 
 		int dstWidth, int dstHeight ) {
 		
+		checkSize( srcWidth, srcHeight );
+		checkSize( dstWidth, dstHeight );
+		
 		ImageScaleFilterDriver driver = new ImageScaleFilterDriver( );
 		
-		// our id, in the range 0 to MAX_THREADS-1
-		int thread_id = driver.acquireThreadId( );
+		// our native scaling context
+		long context = driver.acquireContext( );
 		
 		ByteBuffer dstBuffer = null;
 		
 		try {
 			// initialize
-			driver.initScaleFilter( thread_id, filterType );
+			driver.initScaleFilter( context, filterType );
+			driver.setThreadCount( context, numThreads );
 			
 			dstBuffer = ByteBuffer.allocateDirect( dstWidth * dstHeight * numCmp );
 			dstBuffer.order( ByteOrder.nativeOrder( ) );
 			
-			driver.scaleImage( thread_id, srcWidth, srcHeight, numCmp, srcBuffer,
+			driver.scaleImage( context, srcWidth, srcHeight, numCmp, srcBuffer,
 				dstWidth, dstHeight, dstBuffer );
 		}
 		catch(InternalError e1) {
@@ -154,9 +195,94 @@ public class ImageScaleFilter {
 		}
 		finally {
 			// we have finished with the native library now
-			driver.releaseThreadId( thread_id );
+			driver.releaseContext( context );
 		}
 		return( dstBuffer );
 	}
+	
+	/**
+	 * Check that an image size is one the native filters can scale.
+	 *
+	 * @param width The width of the image
+	 * @param height The height of the image
+	 * @throws IllegalArgumentException if either dimension is not positive
+	 */
+	private static void checkSize( int width, int height ) {
+		if( ( width < 1 ) || ( height < 1 ) ) {
+			throw new IllegalArgumentException( "Invalid image size: " +
+				width + "x" + height );
+		}
+	}
+	
+	/**
+	 * Return a copy of the argument source image with a full chain of
+	 * mipmap levels. Each level is half the size of the one before, rounded
+	 * down but never below 1, down to a single pixel, and is the area
+	 * average of the level before whatever the filter type. The levels are
+	 * slices of a single direct buffer, one after the other, so the whole
+	 * chain can also be handed on in one piece from the first level.
+	 *
+	 * @param srcImage The source image, which becomes the first level
+	 * @return The image with all of its levels
+	 * @throws IllegalArgumentException if the chain is too big for a buffer
+	 */
+	public static ByteBufferImage getMipmappedImage( ByteBufferImage srcImage ) {
+		
+		int srcWidth = srcImage.getWidth( );
+		int srcHeight = srcImage.getHeight( );
+		int numCmp = srcImage.getType( );
+		
+		// work out the size of every level
+		int numLevels = 1;
+		long totalSize = (long)srcWidth * srcHeight * numCmp;
+		int width = srcWidth;
+		int height = srcHeight;
+		while( ( width > 1 ) || ( height > 1 ) ) {
+			width = Math.max( width / 2, 1 );
+			height = Math.max( height / 2, 1 );
+			totalSize += (long)width * height * numCmp;
+			numLevels++;
+		}
+		
+		if( totalSize > Integer.MAX_VALUE ) {
+			throw new IllegalArgumentException( "Mipmap chain too large for " +
+				srcWidth + "x" + srcHeight + " image" );
+		}
+		
+		ByteBuffer levelBuffer = ByteBuffer.allocateDirect( (int)totalSize );
+		levelBuffer.order( ByteOrder.nativeOrder( ) );
+		
+		// copy through a view so the caller's buffer is left alone
+		ByteBuffer srcBuffer = srcImage.getBuffer( ).duplicate( );
+		srcBuffer.position( 0 );
+		srcBuffer.limit( srcWidth * srcHeight * numCmp );
+		levelBuffer.put( srcBuffer );
+		
+		ImageScaleFilterDriver driver = new ImageScaleFilterDriver( );
+		driver.generateMipmaps( levelBuffer, srcWidth, srcHeight, numCmp );
+		
+		// hand each level out as its own view of the buffer
+		ByteBuffer[] levels = new ByteBuffer[numLevels];
+		int offset = 0;
+		width = srcWidth;
+		height = srcHeight;
+		for( int i = 0; i < numLevels; i++ ) {
+			int size = width * height * numCmp;
+			levelBuffer.limit( offset + size );
+			levelBuffer.position( offset );
+			levels[i] = levelBuffer.slice( );
+			levels[i].order( ByteOrder.nativeOrder( ) );
+			offset += size;
+			width = Math.max( width / 2, 1 );
+			height = Math.max( height / 2, 1 );
+		}
+		levelBuffer.clear( );
+		
+		ByteBufferImage dstImage = new ByteBufferImage( srcWidth, srcHeight, numCmp,
+			srcImage.isGrayScale( ), levels[0] );
+		dstImage.setBuffer( levels );
+		
+		return( dstImage );
+	}
 }
 
@@ -14,6 +14,8 @@ package vlc.image;
 // External imports
 import java.nio.ByteBuffer;
 
+import java.util.concurrent.Semaphore;
+
 // Local imports
 // none
 
@@ -26,30 +28,67 @@ import java.nio.ByteBuffer;
  */
 public class ImageScaleFilterDriver {
 	
-	/** Maximum number of threads that can access the library at a time */
-	private static final int MAX_THREADS = 10;
+	/**
+	 * Name of the system property that sets the maximum number of scale
+	 * operations that can run at once. Further requests block until one of
+	 * the current operations finishes, and are served in the order they
+	 * arrived.
+	 */
+	public static final String MAX_FILTERS_PROP = "vlc.image.maxScaleFilters";
+	
+	/**
+	 * Name of the system property that sets the most threads a single
+	 * scale operation is split between. The default of 0 uses one thread
+	 * per processor.
+	 */
+	public static final String THREADS_PROP = "vlc.image.scaleThreads";
 	
-	/** array to record which threads are currently using the library */
-	private static boolean[] threadInUse;
+	/** Lowest default limit, regardless of the number of processors */
+	private static final int MIN_DEFAULT_FILTERS = 10;
 	
-	/** mutex object for this class */
-	private static Object mutex = new Object( );
+	/** Limits the number of scale operations in progress at once */
+	private static final Semaphore filterLimit;
 	
-	// load library and initialise it
+	/** Default most threads for each scale operation, 0 for one per processor */
+	private static final int defaultThreads;
+	
+	// load library and set up the limit
 	static {
 		System.loadLibrary( "image_decode" );
 		
-		threadInUse = new boolean[MAX_THREADS];
+		int num_cpus = Runtime.getRuntime( ).availableProcessors( );
+		int def_limit = Math.max( MIN_DEFAULT_FILTERS, num_cpus );
+		int limit = def_limit;
 		
 		try {
-			for ( int i = 0; i < MAX_THREADS; i++ )
-				threadInUse[i] = false;
-			
-			initialize( MAX_THREADS );
+			limit = Integer.getInteger( MAX_FILTERS_PROP, def_limit ).intValue( );
+		}
+		catch( SecurityException se ) {
+			// not allowed to read properties, so stick with the default
 		}
-		catch( InternalError e ) {
-			System.err.println( "Error initialising library: " + e.getMessage( ) ) ;
+		
+		if ( limit < 1 ) {
+			System.err.println( "Invalid " + MAX_FILTERS_PROP + ": " + limit );
+			limit = def_limit;
 		}
+		
+		filterLimit = new Semaphore( limit, true );
+		
+		int threads = 0;
+		
+		try {
+			threads = Integer.getInteger( THREADS_PROP, 0 ).intValue( );
+		}
+		catch( SecurityException se ) {
+			// not allowed to read properties, so stick with the default
+		}
+		
+		if ( threads < 0 ) {
+			System.err.println( "Invalid " + THREADS_PROP + ": " + threads );
+			threads = 0;
+		}
+		
+		defaultThreads = threads;
 	}
 	
 	/**
@@ -59,58 +98,52 @@ public class ImageScaleFilterDriver {
 	}
 	
 	/**
-	 * Request to become a user of an image scale filter. The driver supports
-	 * a maximum number of simultaneous threads and won't let access happen until a
-	 * thread ID is given. This is then used for all subsequent accesses until
-	 * that thread is no longer needed. After that point, the thread ID should
-	 * be released.
+	 * Request a native context to perform one scale operation with. The
+	 * context handle is used for all subsequent accesses until the operation
+	 * is finished. After that point, the context must be released.
 	 * <p>
-	 * This is a blocking call that will not return until a thread ID has been
-	 * made available.
+	 * This is a blocking call. If the maximum number of operations are
+	 * already in progress it will not return until one of them releases its
+	 * context. Waiting threads are served in the order they arrived.
 	 *
-	 * @return The ID to use in subsequent accesses
+	 * @return The handle to use in subsequent accesses
+	 * @exception OutOfMemoryError if the native context can't be allocated
 	 */
-	public int acquireThreadId( ) {
-		// the id, in the range 0 to MAX_THREADS-1
-		int threadId = -1;
+	public long acquireContext( ) {
+		filterLimit.acquireUninterruptibly( );
 		
-		// obtain a unique thread id
-		// Note that this is a busy wait loop.
-		// However, the busy wait will only occur when more than
-		// MAX_THREADS threads are currently decoding an image
-		//(which *should* be very unlikely)
-		out:
-			synchronized( mutex ) {
-				for ( ; ; ) {
-					for ( int i = 0; i < MAX_THREADS; i++ ) {
-						if ( !threadInUse[i] ) {
-							threadInUse[i] = true;
-							threadId = i;
-							break out;
-						}
-					}
-					Thread.currentThread( ).yield( );
-				}
-			} 
-		return( threadId );
+		try {
+			return( createContext( ) );
+		}
+		catch( OutOfMemoryError e ) {
+			filterLimit.release( );
+			throw e;
+		}
 	}
 	
 	/**
-	 * Release the thread ID back to the global pool of available IDs.
+	 * Release a context obtained from acquireContext(), freeing all of the
+	 * native resources it holds. The handle must not be used again.
 	 *
-	 * @param id The ID of the thread to release
+	 * @param context The handle of the context to release
 	 */
-	public void releaseThreadId( int id ) {
-		if ( id < 0 || id >= MAX_THREADS ) {
-			throw new IllegalArgumentException("Invalid thread ID");
+	public void releaseContext( long context ) {
+		if ( context == 0 ) {
+			throw new IllegalArgumentException( "Invalid context" );
 		}
 		
-		// Catch all, should never hit this, for debugging purposes only.
-		if( !threadInUse[id] ) {
-			throw new IllegalArgumentException("ID was not in use");
-		}
-		
-		threadInUse[id] = false;
+		destroyContext( context );
+		filterLimit.release( );
+	}
+	
+	/**
+	 * Get the most threads a scale operation is split between, unless
+	 * told otherwise, as set by the vlc.image.scaleThreads property.
+	 *
+	 * @return The thread count, or 0 for one thread per processor
+	 */
+	public static int getDefaultThreadCount( ) {
+		return( defaultThreads );
 	}
 	
 	//
@@ -126,35 +159,53 @@ public class ImageScaleFilterDriver {
 	public static native String[] getScaleFilterTypes( );
 	
 	/**
-	 * Initialize the library to be able to handle the given number
-	 * of threads.
+	 * Allocates the native state for one scale operation.
 	 *
-	 * @param numThreads the number of threads to handle
-	 * @exception InternalError if this is called more than once
+	 * @return Handle to the new context
+	 * @exception OutOfMemoryError if there is not enough native memory
 	 */
-	private static native void initialize( int numThreads )
-		throws InternalError;
+	private static native long createContext( );
+	
+	/**
+	 * Frees the native state of a context.
+	 *
+	 * @param context Handle returned by createContext()
+	 */
+	private static native void destroyContext( long context );
 	
 	/**
 	 * Performs initialization prior to use.
 	 * The filter type must be one of the valid types returned by
 	 * getScaleFilterTypes().
 	 *
-	 * @param id Identify this thread to the native library
+	 * @param context The scaling context from acquireContext()
 	 * @param filter_type Filter type. Must be one of the valid types returned by
 	 * getScaleFilterTypes().
 	 * @exception InternalError If filter_type is not recognised, or library has
 	 * not been initialized.
 	 * @see #getFileFormats
 	 */
-	native void initScaleFilter( int id, String filter_type )
+	native void initScaleFilter( long context, String filter_type )
 		throws InternalError;
 	
+	/**
+	 * Set the most threads the scale operations of a context are split
+	 * between. Small images use fewer. There is no upper limit, but a part
+	 * only gets a thread of its own while a processor is free, counting the
+	 * threads of every other scale in progress, and otherwise runs on the
+	 * calling thread. The scaled image is the same however many threads
+	 * are used.
+	 *
+	 * @param context The scaling context from acquireContext()
+	 * @param num_threads The most threads to use, 0 for one per processor
+	 */
+	native void setThreadCount( long context, int num_threads );
+	
 	/**
 	 * Generate the scaled image data and place it in the argument
 	 * destination byte buffer.
 	 *
-	 * @param id Identify this thread to the native library
+	 * @param context The scaling context from acquireContext()
 	 * @param srcWidth The width of the source image
 	 * @param srcheight The height of the source image
 	 * @param srcCmp The number of components in the source image
@@ -162,8 +213,24 @@ public class ImageScaleFilterDriver {
 	 * @param dstWidth The destination image width
 	 * @param dstHeight The destination image height
 	 * @param dstBuffer The buffer to initialize with the scaled image data
+	 * @exception OutOfMemoryError if there is not enough native memory
 	 */
-	native void scaleImage( int id, int srcWidth, int srcHeight, int srcCmp, ByteBuffer srcBuffer,
+	native void scaleImage( long context, int srcWidth, int srcHeight, int srcCmp, ByteBuffer srcBuffer,
 		int dstWidth, int dstHeight, ByteBuffer dstBuffer );
+	
+	/**
+	 * Fill in the smaller levels of a mipmap chain. The levels are held one
+	 * after the other in the buffer, each half the size of the one before,
+	 * rounded down but never below 1, down to a single pixel. The first
+	 * level must already hold the image.
+	 *
+	 * @param buffer The direct buffer holding the levels
+	 * @param width The width of the image
+	 * @param height The height of the image
+	 * @param cmp The number of components in the image
+	 * @exception IllegalArgumentException if the buffer is not direct, or is
+	 * too small to hold every level
+	 */
+	native void generateMipmaps( ByteBuffer buffer, int width, int height, int cmp );
 }
 
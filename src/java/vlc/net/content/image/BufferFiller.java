@@ -40,8 +40,8 @@ class BufferFiller implements Runnable
     /** Number of bytes in the read buffer */
     private static final int BUF_SIZE = 8192;
 
-    /** The thread ID */
-    private int id;
+    /** The native decoding context */
+    private long context;
 
     /** Stream to read data from */
     private InputStream stream;
@@ -61,17 +61,17 @@ class BufferFiller implements Runnable
     /**
      * Construct an instance of the buffer filler for a specific thread.
      *
-     * @param threadId id number to pass to native side
+     * @param ctx decoding context to pass to native side
      * @param is the input stream containing data to be decoded.
      * @param dec The decoder to use to process image info
      * @param finishLock A lock object for thread management on die commands
      */
-    BufferFiller(int threadId,
+    BufferFiller(long ctx,
                  InputStream is,
                  ImageDecoder dec,
                  Object finishLock)
     {
-        id = threadId;
+        context = ctx;
         stream = is;
         decoder = dec;
         finish = finishLock;
@@ -113,7 +113,7 @@ class BufferFiller implements Runnable
             // the input stream is exhausted.  This is correct behaviour
             // as the -1 is used to signal the native side that input
             // has finished
-            decoder.sendData(id, buffer, num_read);
+            decoder.sendData(context, buffer, num_read);
 
             // yield every so often to allow other threads to run
             if(++count >= 5)
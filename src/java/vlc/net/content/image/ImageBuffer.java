@@ -149,6 +149,40 @@ class ImageBuffer
         System.arraycopy(rowData, 0, data[currentChunk], offset, width);
     }
 
+    /**
+     * Get the number of chunks the image data is split across.
+     *
+     * @return The number of chunks
+     */
+    int getNumChunks()
+    {
+        return data.length;
+    }
+
+    /**
+     * Get the array holding one chunk of the image data. The rows of the
+     * chunk are stored one after another, each as wide as the image. The
+     * array is live, so writing to it sets the image data directly.
+     *
+     * @param chunk The index of the chunk
+     * @return The array for that chunk
+     */
+    int[] getChunk(int chunk)
+    {
+        return data[chunk];
+    }
+
+    /**
+     * Get the number of image rows held in one chunk.
+     *
+     * @param chunk The index of the chunk
+     * @return The number of rows in that chunk
+     */
+    int getChunkRows(int chunk)
+    {
+        return rowsForChunk[chunk];
+    }
+
     /**
      * This method is used to register an ImageConsumer with the ImageProducer
      * for access to the image data during a later reconstruction of the Image.
@@ -25,6 +25,7 @@ import java.awt.color.ColorSpace;
 
 // Local imports
 import vlc.image.ByteBufferImage;
+import vlc.image.ImageScaleFilterDriver;
 
 /**
  * This is a generic decoder class that will load and create an image
@@ -83,6 +84,27 @@ public class ImageBuilder
     /** Counter so that we get individual thread names */
     private int threadCount;
 
+    /** Should ByteBufferImage rows be stored bottom up */
+    private boolean flipByteBuffer;
+
+    /** Should streams be fed to the decoder from a separate thread */
+    private boolean useFillerThread;
+
+    /** Smallest width the caller needs, 0 for full size */
+    private int targetWidth;
+
+    /** Smallest height the caller needs, 0 for full size */
+    private int targetHeight;
+
+    /** Width to scale ByteBufferImages to while decoding, 0 for none */
+    private int scaledWidth;
+
+    /** Height to scale ByteBufferImages to while decoding, 0 for none */
+    private int scaledHeight;
+
+    /** The scale filter to scale while decoding with */
+    private String scaleFilter;
+
     /**
      * Static initializer to set up the native library and find out what is
      * available to the system.
@@ -118,6 +140,13 @@ public class ImageBuilder
 
         imageType = type;
         threadCount = 0;
+        flipByteBuffer = true;
+        useFillerThread = false;
+        targetWidth = 0;
+        targetHeight = 0;
+        scaledWidth = 0;
+        scaledHeight = 0;
+        scaleFilter = null;
         boolean valid = false;
 
         // ensure that the library can handle this image type
@@ -135,10 +164,112 @@ public class ImageBuilder
             type);
     }
 
+    /**
+     * Set whether images requested as a ByteBufferImage have their rows
+     * stored bottom up, which is the order OpenGL expects texture data in.
+     * The default is to flip the image.
+     *
+     * @param flip true to store the last row first, false to store the
+     *   rows in the order they appear in the image
+     */
+    public void setFlipByteBufferImage(boolean flip)
+    {
+        flipByteBuffer = flip;
+    }
+
+    /**
+     * Set the smallest image size needed from subsequent decodes. Formats
+     * that can decode a reduced image more cheaply than the full one, such
+     * as JPEG, will then return an image somewhere between the full size and
+     * the target, but never smaller than the target. Other formats are
+     * always decoded at full size. Any remaining scaling is left to the
+     * caller, for example through
+     * {@link vlc.image.ImageScaleFilter#getScaledImage}. The sizes reported
+     * by probe() match what a decode would return. Pass 0 for both to
+     * decode at full size again, which is the default.
+     *
+     * @param width The smallest width needed, or 0 for no limit
+     * @param height The smallest height needed, or 0 for no limit
+     */
+    public void setTargetSize(int width, int height)
+    {
+        targetWidth = Math.max(width, 0);
+        targetHeight = Math.max(height, 0);
+    }
+
+    /**
+     * Set the size that images requested as a ByteBufferImage are scaled to
+     * while they are decoded. Each decoded row is fed straight into the
+     * scale filter, so the full size image is never held in memory, only
+     * the scaled one. Unless a target size has been set, the scaled size is
+     * used as the target, so formats that can decode a reduced image do so
+     * first. Other image types are not scaled. Pass 0 for both sizes to stop
+     * scaling, which is the default.
+     *
+     * @param width The width to scale to, or 0 to not scale
+     * @param height The height to scale to, or 0 to not scale
+     * @param filterType The scale filter to use, one of those returned by
+     *   {@link vlc.image.ImageScaleFilterDriver#getScaleFilterTypes}.
+     *   Case is ignored. Not used when not scaling.
+     * @throws IllegalArgumentException if only one size is 0 or either is
+     *   negative, or the filter type is not supported
+     */
+    public void setScaledSize(int width, int height, String filterType)
+    {
+        if((width < 0) || (height < 0) || ((width == 0) != (height == 0)))
+            throw new IllegalArgumentException("Invalid scaled size " +
+                width + "x" + height);
+
+        if(width == 0)
+        {
+            scaledWidth = 0;
+            scaledHeight = 0;
+            scaleFilter = null;
+            return;
+        }
+
+        String[] filters = ImageScaleFilterDriver.getScaleFilterTypes();
+        String filter = null;
+
+        // the native side wants the filter's own spelling of the name
+        for(int i = 0; filterType != null && i < filters.length; i++)
+        {
+            if(filterType.equalsIgnoreCase(filters[i]))
+            {
+                filter = filters[i];
+                break;
+            }
+        }
+
+        if(filter == null)
+            throw new IllegalArgumentException(
+                "Unsupported scale filter type " + filterType);
+
+        scaledWidth = width;
+        scaledHeight = height;
+        scaleFilter = filter;
+    }
+
+    /**
+     * Set how image data is passed from an input stream to the native
+     * decoder. By default the decoder reads the stream itself, on the
+     * thread calling decode(), as it needs more data. Alternatively a new
+     * thread is started for each image to push the stream's data down a
+     * pipe (or into a temp file under green threads) to the decoder.
+     *
+     * @param useThread true to feed the data from a separate thread,
+     *   false to have the decoder read the stream directly
+     */
+    public void setUseFillerThread(boolean useThread)
+    {
+        useFillerThread = useThread;
+    }
+
     /**
      * Decodes the given image stream in the appropriate image type and return
      * it as the object type requested. If this is JDK 1.1, ignore the request
-     * if it is for a Raster object, and only return an Image.
+     * if it is for a Raster object, and only return an Image. The stream is
+     * read up to the end of the image data, but is not closed.
      *
      * @param is input stream containing the image data in specified format.
      * @param type The requested image output type
@@ -148,31 +279,23 @@ public class ImageBuilder
     public Object decode(InputStream is, int type)
         throws IOException
     {
-        int i;
-        int[] data;
+        if(!useFillerThread)
+            return decodeStream(is, type);
 
         ImageDecoder decoder = new ImageDecoder();
 
-        // our id, in the range 0 to MAX_THREADS-1
-        int thread_id = decoder.acquireThreadId();
+        // our native decoding context
+        long context = decoder.acquireContext();
 
-        int width;
-        int height;
-        int num_components;
-
-        ImageBuffer imBuffer = null;
         BufferFiller filler = null;
 
-        // byte buffer & format - for ByteBufferImage req
-        ByteBuffer byteBuffer = null;
-
         try
         {
             // perform initialisation
-            decoder.initDecoder(thread_id, imageType, !hasNativeThreads);
+            decoder.initDecoder(context, imageType, !hasNativeThreads);
 
             // start sending data to be decoded
-            filler = new BufferFiller(thread_id, is, decoder, finishLock);
+            filler = new BufferFiller(context, is, decoder, finishLock);
 
             // A problem exists with green threads(native code).
             // If a thread blocks, then the entire process blocks.
@@ -196,160 +319,717 @@ public class ImageBuilder
                 filler.run();
             }
 
-            // start the decoding
-            decoder.startDecoding(thread_id);
-
-            // decoding has been started so we can now get image dimensions
-            width = decoder.getImageWidth(thread_id);
-            height = decoder.getImageHeight(thread_id);
-            num_components = decoder.getNumColorComponents(thread_id);
-
-            if(jdk1_1 || (type == IMAGEPRODUCER_REQD))
-                imBuffer = new ImageBuffer(width, height, num_components);
+            return readImage(decoder, context, type);
+        }
+        catch(InternalError e1)
+        {
+            // error occured, so halt the BufferFiller if it is still going
+            if(filler != null)
+                filler.die();
 
-            data = createIntArray(width*height);
+            // any errors, just pass them on
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            // error occured, so halt the BufferFiller if it is still going
+            if(filler != null)
+                filler.die();
 
-            // temporary buffer to receive data one row at a time
-            int[] tmpBuffer = new int[width];
+            // any errors, just pass them on
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            // Ensure that we perform cleanup
+            decoder.finishDecoding(context);
 
-            // now extract the image data
-            if(jdk1_1 || (type == IMAGEPRODUCER_REQD))
+            if(filler != null)
             {
-                for(i = 0; i < height; i++)
+                // Halt the filler, just in case it is still running
+                filler.die();
+
+                // ensure that the buffer filler has completed before freeing
+                // resources
+                while(filler.stillSending())
                 {
-                    decoder.getNextImageRow(thread_id, tmpBuffer);
-                    imBuffer.setImageRow(i, tmpBuffer);
+                    synchronized(finishLock)
+                    {
+                        try
+                        {
+                            // wait to be notified that the buffer filler
+                            // object has finished sending data
+                            finishLock.wait();
+                        }
+                        catch(InterruptedException e3)
+                        {
+                            e3.printStackTrace();
+                        }
+                    }
                 }
             }
-            else if ( type == BYTEBUFFERIMAGE_REQD )
-            {
 
-                byteBuffer = ByteBuffer.allocateDirect( width * height * num_components );
-                byteBuffer.order( ByteOrder.nativeOrder( ) );
+            // we have finished with the native library now
+            decoder.releaseContext(context);
+        }
+    }
 
-                switch ( num_components ) {
+    /**
+     * Decodes the given image stream by having the native decoder pull the
+     * data from the stream as it needs it. No filler thread or pipe is
+     * involved.
+     *
+     * @param is input stream containing the image data in specified format.
+     * @param type The requested image output type
+     * @return the decoded image
+     * @throws IOException on errors decoding the image.
+     */
+    private Object decodeStream(InputStream is, int type)
+        throws IOException
+    {
+        ImageDecoder decoder = new ImageDecoder();
 
-                case 4:
+        // our native decoding context
+        long context = decoder.acquireContext();
 
-                    int y_inv = height - 1;
+        try
+        {
+            decoder.initStreamDecoder(context, imageType, is);
 
-                    for( int y = 0; y < height; y++ ) {
-                        decoder.getNextImageRow(thread_id, tmpBuffer);
-                        int index = y_inv * width * num_components;
-                        for( int x = 0; x < width; x++ ) {
-                            int pixel = tmpBuffer[x];
-                            byteBuffer.put( index++, (byte)(pixel >> 16) );
-                            byteBuffer.put( index++, (byte)(pixel >> 8) );
-                            byteBuffer.put( index++, (byte)pixel );
-                            byteBuffer.put( index++, (byte)(pixel >> 24) );
-                        }
-                        y_inv--;
-                    }
-                    break;
+            return readImage(decoder, context, type);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            decoder.finishDecoding(context);
+            decoder.releaseContext(context);
+        }
+    }
 
-                case 3:
+    /**
+     * Decodes an image that is already held completely in memory and return
+     * it as the object type requested. The native decoder reads the encoded
+     * data in place, so no copy of it is made and no filler thread is
+     * needed. The bytes between the buffer's position and limit are used,
+     * and the position is left unchanged.
+     *
+     * @param data Buffer containing the image data in specified format.
+     *   Must either be a direct buffer or be backed by an array.
+     * @param type The requested image output type
+     * @return the decoded image
+     * @throws IOException on errors decoding the image.
+     * @throws IllegalArgumentException if the buffer is neither direct nor
+     *   backed by an accessible array
+     */
+    public Object decode(ByteBuffer data, int type)
+        throws IOException
+    {
+        if(!data.isDirect())
+        {
+            if(!data.hasArray())
+                throw new IllegalArgumentException(
+                    "Buffer must be direct or have an accessible array");
+
+            return decode(data.array(),
+                          data.arrayOffset() + data.position(),
+                          data.remaining(),
+                          type);
+        }
 
-                    y_inv = height - 1;
+        ImageDecoder decoder = new ImageDecoder();
 
-                    for( int y = 0; y < height; y++ ) {
-                        decoder.getNextImageRow(thread_id, tmpBuffer);
-                        int index = y_inv * width * num_components;
-                        for( int x = 0; x < width; x++ ) {
-                            int pixel = tmpBuffer[x];
-                            byteBuffer.put( index++, (byte)(pixel >> 16) );
-                            byteBuffer.put( index++, (byte)(pixel >> 8) );
-                            byteBuffer.put( index++, (byte)pixel );
-                        }
-                        y_inv--;
-                    }
-                    break;
+        // our native decoding context
+        long context = decoder.acquireContext();
 
-                case 2:
+        try
+        {
+            decoder.initBufferDecoder(context,
+                                      imageType,
+                                      data,
+                                      data.position(),
+                                      data.remaining());
 
-                    y_inv = height - 1;
+            return readImage(decoder, context, type);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            decoder.finishDecoding(context);
+            decoder.releaseContext(context);
+        }
+    }
 
-                    for( int y = 0; y < height; y++ ) {
-                        decoder.getNextImageRow(thread_id, tmpBuffer);
-                        int index = y_inv * width * num_components;
-                        for( int x = 0; x < width; x++ ) {
-                            int pixel = tmpBuffer[x];
-                            byteBuffer.put( index++, (byte)pixel );
-                            byteBuffer.put( index++, (byte)(pixel >> 8) );
-                        }
-                        y_inv--;
-                    }
-                    break;
+    /**
+     * Decodes an image that is already held completely in a byte array and
+     * return it as the object type requested. The native decoder reads the
+     * encoded data in place, so no copy of it is made and no filler thread
+     * is needed.
+     *
+     * @param data Array containing the image data in specified format
+     * @param offset The index of the first byte of image data
+     * @param length The number of bytes of image data
+     * @param type The requested image output type
+     * @return the decoded image
+     * @throws IOException on errors decoding the image.
+     * @throws IndexOutOfBoundsException if offset and length do not
+     *   describe a region of the array
+     */
+    public Object decode(byte[] data, int offset, int length, int type)
+        throws IOException
+    {
+        if((offset < 0) || (length < 0) || (offset + length > data.length))
+            throw new IndexOutOfBoundsException("Invalid image data region");
 
-                case 1:
+        ImageDecoder decoder = new ImageDecoder();
 
-                    y_inv = height - 1;
+        // our native decoding context
+        long context = decoder.acquireContext();
 
-                    for( int y = 0; y < height; y++ ) {
-                        decoder.getNextImageRow(thread_id, tmpBuffer);
-                        int index = y_inv * width;
-                        for( int x = 0; x < width; x++ ) {
-                            int pixel = tmpBuffer[x];
-                            byteBuffer.put( index++, (byte)pixel );
-                        }
-                        y_inv--;
-                    }
-                }
-            }
-            else
+        try
+        {
+            decoder.initArrayDecoder(context,
+                                     imageType,
+                                     data,
+                                     offset,
+                                     length);
+
+            return readImage(decoder, context, type);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            decoder.finishDecoding(context);
+            decoder.releaseContext(context);
+        }
+    }
+
+    /**
+     * Read the header of the given image stream to find out the size and
+     * format of the image, without decoding it. Only as much of the stream
+     * as the header takes up is read, which for most formats is the first
+     * few KB. The stream is left part way through the image.
+     *
+     * @param is input stream containing the image data in specified format.
+     * @return the details of the image
+     * @throws IOException on errors reading the header.
+     */
+    public ImageInfo probe(InputStream is)
+        throws IOException
+    {
+        ImageDecoder decoder = new ImageDecoder();
+
+        // our native decoding context
+        long context = decoder.acquireContext();
+
+        try
+        {
+            decoder.initStreamDecoder(context, imageType, is);
+
+            return readInfo(decoder, context);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            decoder.finishDecoding(context);
+            decoder.releaseContext(context);
+        }
+    }
+
+    /**
+     * Read the header of an image that is held completely in memory to find
+     * out the size and format of the image, without decoding it. The bytes
+     * between the buffer's position and limit are used, and the position
+     * is left unchanged.
+     *
+     * @param data Buffer containing the image data in specified format.
+     *   Must either be a direct buffer or be backed by an array.
+     * @return the details of the image
+     * @throws IOException on errors reading the header.
+     * @throws IllegalArgumentException if the buffer is neither direct nor
+     *   backed by an accessible array
+     */
+    public ImageInfo probe(ByteBuffer data)
+        throws IOException
+    {
+        if(!data.isDirect())
+        {
+            if(!data.hasArray())
+                throw new IllegalArgumentException(
+                    "Buffer must be direct or have an accessible array");
+
+            return probe(data.array(),
+                         data.arrayOffset() + data.position(),
+                         data.remaining());
+        }
+
+        ImageDecoder decoder = new ImageDecoder();
+
+        // our native decoding context
+        long context = decoder.acquireContext();
+
+        try
+        {
+            decoder.initBufferDecoder(context,
+                                      imageType,
+                                      data,
+                                      data.position(),
+                                      data.remaining());
+
+            return readInfo(decoder, context);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            decoder.finishDecoding(context);
+            decoder.releaseContext(context);
+        }
+    }
+
+    /**
+     * Read the header of an image that is held completely in a byte array
+     * to find out the size and format of the image, without decoding it.
+     *
+     * @param data Array containing the image data in specified format
+     * @param offset The index of the first byte of image data
+     * @param length The number of bytes of image data
+     * @return the details of the image
+     * @throws IOException on errors reading the header.
+     * @throws IndexOutOfBoundsException if offset and length do not
+     *   describe a region of the array
+     */
+    public ImageInfo probe(byte[] data, int offset, int length)
+        throws IOException
+    {
+        if((offset < 0) || (length < 0) || (offset + length > data.length))
+            throw new IndexOutOfBoundsException("Invalid image data region");
+
+        ImageDecoder decoder = new ImageDecoder();
+
+        // our native decoding context
+        long context = decoder.acquireContext();
+
+        try
+        {
+            decoder.initArrayDecoder(context,
+                                     imageType,
+                                     data,
+                                     offset,
+                                     length);
+
+            return readInfo(decoder, context);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            decoder.finishDecoding(context);
+            decoder.releaseContext(context);
+        }
+    }
+
+    /**
+     * Open an image that may hold more than one page, so that its pages can
+     * be decoded one at a time in any order. The whole stream is read in
+     * when the page count is first needed, and shared by every page after
+     * that. The stream is not closed, and must stay open until the image
+     * is closed.
+     *
+     * @param is input stream containing the image data in specified format.
+     * @return the pages of the image, which must be closed when done with
+     * @throws IOException on errors reading the image.
+     */
+    public MultiPageImage openPages(InputStream is)
+        throws IOException
+    {
+        ImageDecoder decoder = new ImageDecoder();
+
+        // our native decoding context
+        long context = decoder.acquireContext();
+
+        MultiPageImage pages = null;
+
+        try
+        {
+            decoder.initStreamDecoder(context, imageType, is);
+
+            pages = new MultiPageImage(this,
+                                       decoder,
+                                       context,
+                                       decoder.getPageCount(context));
+
+            return pages;
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            // the pages keep the context if they were opened
+            if(pages == null)
             {
-                for(i = 0; i < height; i++)
-                {
-                    decoder.getNextImageRow(thread_id, tmpBuffer);
-                    System.arraycopy(tmpBuffer, 0, data, i*width, width);
-                }
+                decoder.finishDecoding(context);
+                decoder.releaseContext(context);
             }
         }
-        catch(InternalError e1)
+    }
+
+    /**
+     * Open an image that is held completely in memory and may hold more
+     * than one page, so that its pages can be decoded one at a time in any
+     * order. The native decoder reads the encoded data in place, so the
+     * buffer must not be changed until the image is closed. The bytes
+     * between the buffer's position and limit are used, and the position
+     * is left unchanged.
+     *
+     * @param data Buffer containing the image data in specified format.
+     *   Must either be a direct buffer or be backed by an array.
+     * @return the pages of the image, which must be closed when done with
+     * @throws IOException on errors reading the image.
+     * @throws IllegalArgumentException if the buffer is neither direct nor
+     *   backed by an accessible array
+     */
+    public MultiPageImage openPages(ByteBuffer data)
+        throws IOException
+    {
+        if(!data.isDirect())
         {
-            // error occured, so halt the BufferFiller if it is still going
-            filler.die();
+            if(!data.hasArray())
+                throw new IllegalArgumentException(
+                    "Buffer must be direct or have an accessible array");
 
-            // any errors, just pass them on
+            return openPages(data.array(),
+                             data.arrayOffset() + data.position(),
+                             data.remaining());
+        }
+
+        ImageDecoder decoder = new ImageDecoder();
+
+        // our native decoding context
+        long context = decoder.acquireContext();
+
+        MultiPageImage pages = null;
+
+        try
+        {
+            decoder.initBufferDecoder(context,
+                                      imageType,
+                                      data,
+                                      data.position(),
+                                      data.remaining());
+
+            pages = new MultiPageImage(this,
+                                       decoder,
+                                       context,
+                                       decoder.getPageCount(context));
+
+            return pages;
+        }
+        catch(InternalError e1)
+        {
             throw new IOException(e1.getMessage());
         }
         catch(OutOfMemoryError e2)
         {
-            // error occured, so halt the BufferFiller if it is still going
-            filler.die();
+            throw new IOException("Not enough memory");
+        }
+        finally
+        {
+            // the pages keep the context if they were opened
+            if(pages == null)
+            {
+                decoder.finishDecoding(context);
+                decoder.releaseContext(context);
+            }
+        }
+    }
 
-            // any errors, just pass them on
+    /**
+     * Open an image that is held completely in a byte array and may hold
+     * more than one page, so that its pages can be decoded one at a time in
+     * any order. The native decoder reads the encoded data in place, so the
+     * array must not be changed until the image is closed.
+     *
+     * @param data Array containing the image data in specified format
+     * @param offset The index of the first byte of image data
+     * @param length The number of bytes of image data
+     * @return the pages of the image, which must be closed when done with
+     * @throws IOException on errors reading the image.
+     * @throws IndexOutOfBoundsException if offset and length do not
+     *   describe a region of the array
+     */
+    public MultiPageImage openPages(byte[] data, int offset, int length)
+        throws IOException
+    {
+        if((offset < 0) || (length < 0) || (offset + length > data.length))
+            throw new IndexOutOfBoundsException("Invalid image data region");
+
+        ImageDecoder decoder = new ImageDecoder();
+
+        // our native decoding context
+        long context = decoder.acquireContext();
+
+        MultiPageImage pages = null;
+
+        try
+        {
+            decoder.initArrayDecoder(context,
+                                     imageType,
+                                     data,
+                                     offset,
+                                     length);
+
+            pages = new MultiPageImage(this,
+                                       decoder,
+                                       context,
+                                       decoder.getPageCount(context));
+
+            return pages;
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
             throw new IOException("Not enough memory");
         }
         finally
         {
-            // Ensure that we perform cleanup
-            decoder.finishDecoding(thread_id);
+            // the pages keep the context if they were opened
+            if(pages == null)
+            {
+                decoder.finishDecoding(context);
+                decoder.releaseContext(context);
+            }
+        }
+    }
+
+    /**
+     * Decode one page of an image opened by openPages(). The context is left
+     * open for decoding further pages.
+     *
+     * @param decoder The decoder holding the image
+     * @param context The context the decoder was initialised with
+     * @param page The index of the page, from 0
+     * @param type The requested image output type
+     * @return the decoded page
+     * @throws IOException on errors decoding the page.
+     * @throws IndexOutOfBoundsException if there is no such page
+     */
+    Object decodePage(ImageDecoder decoder, long context, int page, int type)
+        throws IOException
+    {
+        try
+        {
+            decoder.setPage(context, page);
+
+            return readImage(decoder, context, type);
+        }
+        catch(InternalError e1)
+        {
+            throw new IOException(e1.getMessage());
+        }
+        catch(OutOfMemoryError e2)
+        {
+            throw new IOException("Not enough memory");
+        }
+    }
+
+    /**
+     * Read the header of an image whose source has already been set up.
+     *
+     * @param decoder The decoder to read the header with
+     * @param context The context the decoder was initialised with
+     * @return the details of the image
+     * @throws InternalError on errors reading the header
+     */
+    private ImageInfo readInfo(ImageDecoder decoder, long context)
+    {
+        int[] info = new int[5];
+
+        if((targetWidth != 0) || (targetHeight != 0))
+            decoder.setTargetSize(context, targetWidth, targetHeight);
+
+        decoder.probeImage(context, info);
+
+        return new ImageInfo(info[0],
+                             info[1],
+                             info[2],
+                             info[3],
+                             info[4] != 0);
+    }
+
+    /**
+     * Run the decoder over an image whose source has already been set up,
+     * and build the object type requested from the decoded pixels. If this
+     * is JDK 1.1, ignore the request if it is for a Raster object, and only
+     * return an Image.
+     *
+     * @param decoder The decoder to fetch the pixels from
+     * @param context The context the decoder was initialised with
+     * @param type The requested image output type
+     * @return the decoded image
+     * @throws InternalError on errors decoding the image
+     */
+    private Object readImage(ImageDecoder decoder, long context, int type)
+    {
+        int i;
+
+        int width;
+        int height;
+        int num_components;
+
+        ImageBuffer imBuffer = null;
+
+        // byte buffer & format - for ByteBufferImage req
+        ByteBuffer byteBuffer = null;
+
+        // backing store for the BufferedImage and Raster reqs
+        DataBuffer dataBuffer = null;
+
+        boolean scale = (scaledWidth != 0) && (type == BYTEBUFFERIMAGE_REQD) &&
+                        !jdk1_1;
+
+        // let the decoder skip work the caller doesn't need
+        if((targetWidth != 0) || (targetHeight != 0))
+            decoder.setTargetSize(context, targetWidth, targetHeight);
+        else if(scale)
+            decoder.setTargetSize(context, scaledWidth, scaledHeight);
+
+        // start the decoding
+        decoder.startDecoding(context);
 
-            // Halt the filler, just in case it is still running
-            filler.die();
+        // scale the rows as they are decoded, without ever holding the
+        // full size image
+        if(scale)
+        {
+            num_components = decoder.getNumColorComponents(context);
+
+            byteBuffer = ByteBuffer.allocateDirect(
+                scaledWidth * scaledHeight * num_components);
+            byteBuffer.order(ByteOrder.nativeOrder());
+
+            decoder.getScaledImageBuffer(context,
+                                         scaleFilter,
+                                         byteBuffer,
+                                         scaledWidth,
+                                         scaledHeight,
+                                         flipByteBuffer);
+
+            return new ByteBufferImage(scaledWidth,
+                                       scaledHeight,
+                                       num_components,
+                                       byteBuffer);
+        }
+
+        // decoding has been started so we can now get image dimensions
+        width = decoder.getImageWidth(context);
+        height = decoder.getImageHeight(context);
+        num_components = decoder.getNumColorComponents(context);
+
+        if(jdk1_1 || (type == IMAGEPRODUCER_REQD))
+            imBuffer = new ImageBuffer(width, height, num_components);
 
-            // ensure that the buffer filler has completed before freeing
-            // resources
-            while(filler.stillSending())
+        // now extract the image data. The native side decodes as many rows
+        // as it can per call, straight into the destination.
+        if(jdk1_1 || (type == IMAGEPRODUCER_REQD))
+        {
+            int num_chunks = imBuffer.getNumChunks();
+            for(i = 0; i < num_chunks; i++)
             {
-                synchronized(finishLock)
-                {
-                    try
-                    {
-                        // wait to be notified that the buffer filler object
-                        // has finished sending data
-                        finishLock.wait();
-                    }
-                    catch(InterruptedException e3)
-                    {
-                        e3.printStackTrace();
-                    }
-                }
+                decoder.getImageRows(context,
+                                     imBuffer.getChunk(i),
+                                     0,
+                                     width,
+                                     imBuffer.getChunkRows(i));
             }
+        }
+        else if ( type == BYTEBUFFERIMAGE_REQD )
+        {
+            int row_size = width * num_components;
+
+            byteBuffer = ByteBuffer.allocateDirect( row_size * height );
+            byteBuffer.order( ByteOrder.nativeOrder( ) );
+
+            // The decoder writes packed bytes straight into the buffer. To
+            // store the image bottom up, start at the last row and work
+            // back towards the start of the buffer.
+            if(flipByteBuffer)
+                decoder.getImageRowBuffer(context,
+                                          byteBuffer,
+                                          (height - 1) * row_size,
+                                          -row_size,
+                                          height);
+            else
+                decoder.getImageRowBuffer(context,
+                                          byteBuffer,
+                                          0,
+                                          row_size,
+                                          height);
+        }
+        else if(num_components == 1)
+        {
+            // Gray images are stored one byte per pixel, so decode them
+            // straight into the array backing the final DataBuffer.
+            byte[] gray = new byte[width * height];
 
+            decoder.getImageRowBytes(context, gray, 0, width, height);
 
-            // we have finished with the native library now
-            decoder.releaseThreadId(thread_id);
+            dataBuffer = new DataBufferByte(gray, width * height);
+        }
+        else
+        {
+            int[] pixels = new int[width * height];
+
+            decoder.getImageRows(context, pixels, 0, width, height);
+
+            dataBuffer = new DataBufferInt(pixels, width * height);
         }
 
         Object ret_val = null;
@@ -370,58 +1050,24 @@ public class ImageBuilder
         {
             ColorModel cm = getColorModel(num_components);
             SampleModel sm = cm.createCompatibleSampleModel(width, height);
-            DataBuffer buffer;
-
-            if (num_components == 1)
-            {
-                int len = data.length;
-
-                byte[] new_data = new byte[len];
-                for(int j=0; j < len; j++)
-                {
-                    new_data[j] = (byte) (data[j] & 0xFF);
-                }
-
-                buffer = new DataBufferByte(new_data, (width * height));
-            }
-            // rem ////////////////////////////////////////////////////////////
-            //else if (num_components == 2)
-            //{
-            //  int len = data.length;
-            //
-            //  byte[] new_data = new byte[len*2];
-            //  int k = 0;
-            //  for(int j=0; j < len; j++)
-            //  {
-            //      new_data[k++] = (byte)(data[j] & 0xFF);
-            //      new_data[k++] = (byte)((data[j] >> 8) & 0xFF);
-            //  }
-            //
-            //  buffer = new DataBufferByte(new_data, (width * height));
-            //}
-            ///////////////////////////////////////////////////////////////////
-            else
-            {
-                buffer = new DataBufferInt(data, (width * height));
-            }
 
             switch(type)
             {
             case IMAGE_REQD:
                 // create our raster
                 WritableRaster raster =
-                    Raster.createWritableRaster(sm, buffer, null);
+                    Raster.createWritableRaster(sm, dataBuffer, null);
 
                 // now create and return our buffered image
                 ret_val = new BufferedImage(cm, raster, false, null);
                 break;
 
             case RASTER_REQD:
-                ret_val = Raster.createRaster(sm, buffer, null);
+                ret_val = Raster.createRaster(sm, dataBuffer, null);
                 break;
 
             case WRITABLE_RASTER_REQD:
-                ret_val = Raster.createWritableRaster(sm, buffer, null);
+                ret_val = Raster.createWritableRaster(sm, dataBuffer, null);
                 break;
             }
 
@@ -430,61 +1076,6 @@ public class ImageBuilder
         return ret_val;
     }
 
-    /**
-     * Allocates an integer array of the given size.
-     * If the initial attempt at creating the array fails, then the
-     * garbage collector is run and the memory allocation is retried.
-     * @param size number of integer elements in the array
-     * @return the allocated array
-     * @throws OutOfMemoryError if not enough memory
-     */
-    private int[] createIntArray(int size)
-    {
-        // just to prevent an infinite loop.  see below
-        final int LOOP_CHECK = 20;
-
-        // number of times to attempt memory allocation
-        final int NUM_TRIES = 10;
-
-        Runtime runtime = null;
-
-        for(int i=0; i<NUM_TRIES; i++)
-        {
-            try
-            {
-                // return array if we allocate memory
-                return new int[size];
-            }
-            catch(OutOfMemoryError e)
-            {
-                // get current runtime instance
-                if(runtime == null)
-                    runtime = Runtime.getRuntime();
-
-                // first run any finalisations.
-                runtime.runFinalization();
-
-                long free_memory = runtime.freeMemory();
-                long was_free;
-                int count = 0;
-
-                do
-                {
-                    count++;
-                    was_free = free_memory;
-                    runtime.gc();
-
-                    free_memory = runtime.freeMemory();
-                }
-                while((free_memory > was_free)&&(count <= LOOP_CHECK));
-            }
-        }
-
-        // if we are here then we have done some garbage collection
-        // so try allocating memory again.
-        return new int[size];
-    }
-
     /**
      * Create a colour model instance for the number of components
      *
@@ -12,7 +12,11 @@
 package vlc.net.content.image;
 
 // Standard imports
-// none
+import java.io.InputStream;
+
+import java.nio.ByteBuffer;
+
+import java.util.concurrent.Semaphore;
 
 // Application specific imports
 // none
@@ -37,33 +41,44 @@ package vlc.net.content.image;
  */
 public class ImageDecoder
 {
-    /** Maximum number of threads that can access the library at a time */
-    private static final int MAX_THREADS = 10;
+    /**
+     * Name of the system property that sets the maximum number of images
+     * that can be decoded at once. Further requests block until one of the
+     * current decodes finishes, and are served in the order they arrived.
+     */
+    public static final String MAX_DECODERS_PROP = "vlc.image.maxDecoders";
 
-    /** array to record which threads are currently using the library */
-    private static boolean[] threadInUse;
+    /** Lowest default limit, regardless of the number of processors */
+    private static final int MIN_DEFAULT_DECODERS = 10;
 
-    /** used for mutual exclusion for this class */
-    private static Object mutex = new Object();
+    /** Limits the number of decodes in progress at once */
+    private static final Semaphore decoderLimit;
 
-    // load library and initialise it
+    // load library and set up the limit
     static
     {
         System.loadLibrary("image_decode");
 
-        threadInUse = new boolean[MAX_THREADS];
+        int num_cpus = Runtime.getRuntime().availableProcessors();
+        int def_limit = Math.max(MIN_DEFAULT_DECODERS, num_cpus);
+        int limit = def_limit;
 
         try
         {
-            for(int i = 0; i < MAX_THREADS; i++)
-                threadInUse[i] = false;
-
-            initialize(MAX_THREADS);
+            limit = Integer.getInteger(MAX_DECODERS_PROP, def_limit).intValue();
         }
-        catch(InternalError e)
+        catch(SecurityException se)
         {
-            System.err.println("Error initialising library: "+e.getMessage());
+            // not allowed to read properties, so stick with the default
         }
+
+        if(limit < 1)
+        {
+            System.err.println("Invalid " + MAX_DECODERS_PROP + ": " + limit);
+            limit = def_limit;
+        }
+
+        decoderLimit = new Semaphore(limit, true);
     }
 
     /**
@@ -77,63 +92,45 @@ public class ImageDecoder
     }
 
     /**
-     * Request to become a user of the decoder. The decoder supports a maximum
-     * number of simultaneous threads and won't let access happen until a
-     * thread ID is given. This is then used for all subsequent accesses until
-     * that thread is no longer needed. After that point, the thread ID should
-     * be released.
+     * Request a native context to decode one image with. The context handle
+     * is used for all subsequent accesses until the image is finished with.
+     * After that point, the context must be released.
      * <p>
-     * This is a blocking call that will not return until a thread ID has been
-     * made available.
+     * This is a blocking call. If the maximum number of decodes are already
+     * in progress it will not return until one of them releases its context.
+     * Waiting threads are served in the order they arrived.
      *
-     * @return The ID to use in subsequent accesses
+     * @return The handle to use in subsequent accesses
+     * @exception OutOfMemoryError if the native context can't be allocated
      */
-    public int acquireThreadId()
+    public long acquireContext()
     {
-        // the id, in the range 0 to MAX_THREADS-1
-        int threadId = -1;
-
-        // obtain a unique thread id
-        // Note that this is a busy wait loop.
-        // However, the busy wait will only occur when more than
-        // MAX_THREADS threads are currently decoding an image
-        //(which *should* be very unlikely)
-        out:
-        synchronized(mutex)
+        decoderLimit.acquireUninterruptibly();
+
+        try
         {
-            for( ; ; )
-            {
-                for(int i = 0; i < MAX_THREADS; i++)
-                {
-                    if(!threadInUse[i])
-                    {
-                        threadInUse[i] = true;
-                        threadId = i;
-                        break out;
-                    }
-                }
-                Thread.currentThread().yield();
-            }
+            return createContext();
+        }
+        catch(OutOfMemoryError e)
+        {
+            decoderLimit.release();
+            throw e;
         }
-
-        return threadId;
     }
 
     /**
-     * Release the thread ID back to the global pool of available IDs.
+     * Release a context obtained from acquireContext(), freeing all of the
+     * native resources it holds. The handle must not be used again.
      *
-     * @param id The ID of the thread to release
+     * @param context The handle of the context to release
      */
-    public void releaseThreadId(int id)
+    public void releaseContext(long context)
     {
-        if(id < 0 || id >= MAX_THREADS)
-            throw new IllegalArgumentException("Invalid thread ID");
-
-        // Catch all, should never hit this, for debugging purposes only.
-        if(!threadInUse[id])
-            throw new IllegalArgumentException("ID was not in use");
+        if(context == 0)
+            throw new IllegalArgumentException("Invalid context");
 
-        threadInUse[id] = false;
+        destroyContext(context);
+        decoderLimit.release();
     }
 
     //
@@ -142,13 +139,18 @@ public class ImageDecoder
     //
 
     /**
-     * Initialises the library to be able to handle the given number
-     * of threads.
-     * @param numThreads the number of threads to handle
-     * @exception InternalError if this is called more than once
+     * Allocates the native state for decoding one image.
+     * @return handle to the new context
+     * @exception OutOfMemoryError if there is not enough native memory
      */
-    private static native void initialize(int numThreads)
-        throws InternalError;
+    private static native long createContext();
+
+    /**
+     * Frees the native state of a context, and anything still held by the
+     * decoder using it.
+     * @param context handle returned by createContext()
+     */
+    private static native void destroyContext(long context);
 
     /**
      * Returns a list of image file formats that this decoder can decode.
@@ -162,7 +164,7 @@ public class ImageDecoder
      * Performs initialisation prior to decoding.
      * The image type is one of the valid types returned by getFileFormats().
      *
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @param type image type must be one of the valid subtypes returned by
      * getFileFormats().
      * @param useTemp should the library use a temporary file to store the
@@ -171,7 +173,73 @@ public class ImageDecoder
      * not been initialised.
      * @see #getFileFormats
      */
-    native void initDecoder(int id, String type, boolean useTemp)
+    native void initDecoder(long context, String type, boolean useTemp)
+        throws InternalError;
+
+    /**
+     * Performs initialisation prior to decoding an image that is already
+     * held completely in a direct buffer. The native library reads the
+     * encoded data straight out of the buffer, so no data is sent.
+     * The buffer must not be modified until finishDecoding() is called.
+     *
+     * @param context the decoding context from acquireContext()
+     * @param type image type must be one of the valid subtypes returned by
+     * getFileFormats().
+     * @param data direct buffer containing the encoded image
+     * @param offset index in the buffer of the first byte of the image
+     * @param length number of bytes of encoded image
+     * @exception InternalError if type is not recognised, the buffer is
+     * not direct, or library has not been initialised.
+     * @see #getFileFormats
+     */
+    native void initBufferDecoder(long context,
+                                  String type,
+                                  ByteBuffer data,
+                                  int offset,
+                                  int length)
+        throws InternalError;
+
+    /**
+     * Performs initialisation prior to decoding an image that is already
+     * held completely in a byte array. The native library reads the
+     * encoded data straight out of the array, so no data is sent.
+     * The array must not be modified until finishDecoding() is called.
+     *
+     * @param context the decoding context from acquireContext()
+     * @param type image type must be one of the valid subtypes returned by
+     * getFileFormats().
+     * @param data array containing the encoded image
+     * @param offset index in the array of the first byte of the image
+     * @param length number of bytes of encoded image
+     * @exception InternalError if type is not recognised, or library has
+     * not been initialised.
+     * @see #getFileFormats
+     */
+    native void initArrayDecoder(long context,
+                                 String type,
+                                 byte[] data,
+                                 int offset,
+                                 int length)
+        throws InternalError;
+
+    /**
+     * Performs initialisation prior to decoding an image read from an
+     * input stream. The native library calls the stream's read() method
+     * itself, on the thread doing the decoding, whenever it needs more
+     * data, so no data is sent and no pipe is used. The stream is not
+     * closed by the library. If the stream throws an IOException, the
+     * decode stops and the native call that was reading throws that
+     * same exception.
+     *
+     * @param context the decoding context from acquireContext()
+     * @param type image type must be one of the valid subtypes returned by
+     * getFileFormats().
+     * @param is stream to read the encoded image from
+     * @exception InternalError if type is not recognised, or library has
+     * not been initialised.
+     * @see #getFileFormats
+     */
+    native void initStreamDecoder(long context, String type, InputStream is)
         throws InternalError;
 
     /**
@@ -182,66 +250,218 @@ public class ImageDecoder
      * be protected to allow the inner class 'BufferFiller' to access
      * this method.
      *
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @param buffer array containing data
      * @param size number of valid bytes in the array, or -1 when signalling
      * that there is no more data
      */
-    native void sendData(int id, byte[] buffer, int size);
+    native void sendData(long context, byte[] buffer, int size);
+
+    /**
+     * Tells the decoder the smallest image size the caller needs. Decoders
+     * that can produce a reduced image more cheaply than the full one, such
+     * as JPEG, may then decode at any size down to, but not below, the
+     * target. Others ignore it. Must be called before startDecoding().
+     * @param context the decoding context from acquireContext()
+     * @param width smallest width needed, 0 for no limit
+     * @param height smallest height needed, 0 for no limit
+     */
+    native void setTargetSize(long context, int width, int height);
+
+    /**
+     * Returns the number of pages in the image. Formats without pages,
+     * and files holding just the one, have a single page. For multi-page
+     * formats the whole of the encoded image is read in and kept until
+     * finishDecoding(), so any page can then be decoded from it.
+     * @param context the decoding context from acquireContext()
+     * @return the number of pages, at least 1
+     * @exception InternalError on error reading the image
+     */
+    native int getPageCount(long context)
+        throws InternalError;
+
+    /**
+     * Selects the page that the next startDecoding() or probeImage()
+     * works on. Multi-page formats may call startDecoding() again after
+     * each page to decode another. The default is page 0.
+     * @param context the decoding context from acquireContext()
+     * @param page index of the page, from 0
+     * @exception IndexOutOfBoundsException if there is no such page
+     * @exception InternalError on error reading the image
+     */
+    native void setPage(long context, int page)
+        throws InternalError;
 
     /**
      * Starts decoding the image.
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @exception InternalError if this is called before initialisation
      * has occured.
      */
-    native void startDecoding(int id)
+    native void startDecoding(long context)
+        throws InternalError;
+
+    /**
+     * Reads just the header of the image, without decoding or allocating
+     * space for any pixels. The context must be initialised again before
+     * the image can be decoded with it.
+     * @param context the decoding context from acquireContext()
+     * @param info array of at least 5 elements, filled in with the width,
+     * height, number of colour components, bits per sample and 1 if the
+     * image is interlaced or progressive, 0 otherwise
+     * @exception InternalError on error reading the header
+     */
+    native void probeImage(long context, int[] info)
         throws InternalError;
 
     /**
      * Returns the width of the image that is to be decoded.
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @return width of the image
      * @exception InternalError on unexpected error.
      */
-    native int getImageWidth(int id)
+    native int getImageWidth(long context)
         throws InternalError;
 
     /**
      * Returns the height of the image that is to be decoded.
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @return height of the image
      * @exception InternalError on unexpected error.
      */
-    native int getImageHeight(int id)
+    native int getImageHeight(long context)
         throws InternalError;
 
     /**
      * Returns the number of components in the color model used by
      * the image. This will be a value of 1 to 4.
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @return A value 1 - 4
      * @exception InternalError on unexpected error.
      */
-    native int getNumColorComponents(int id)
+    native int getNumColorComponents(long context)
         throws InternalError;
 
     /**
      * Returns the next decoded row of the image.
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      * @param array of integers representing pixel data for a row of the image,
      * to be filled in by this method.
      * @exception InternalError when trying to read more rows than exist
      * in the image file
      */
-    native void getNextImageRow(int id, int[] buffer)
+    native void getNextImageRow(long context, int[] buffer)
+        throws InternalError;
+
+    /**
+     * Decodes the next rows of the image straight into the given array,
+     * one pixel per element in the same form as getNextImageRow(). Passing
+     * the image height as the row count decodes the rest of the image in a
+     * single call.
+     *
+     * @param context the decoding context from acquireContext()
+     * @param buffer array to receive the pixel data
+     * @param offset index of the first pixel of the first row
+     * @param stride number of elements between the start of each row.
+     * A negative value fills the array from the bottom up.
+     * @param numRows number of rows to decode
+     * @return the number of rows decoded, less than numRows once the end
+     * of the image is reached
+     * @exception InternalError on error with the image decoding
+     * @exception ArrayIndexOutOfBoundsException if the rows do not fit in
+     * the array
+     */
+    native int getImageRows(long context,
+                            int[] buffer,
+                            int offset,
+                            int stride,
+                            int numRows)
+        throws InternalError;
+
+    /**
+     * Decodes the next rows of the image straight into the given array as
+     * packed bytes, one byte per color component. Color images are written
+     * as R, G, B (and A), gray images as gray (and alpha).
+     *
+     * @param context the decoding context from acquireContext()
+     * @param buffer array to receive the pixel data
+     * @param offset index of the first byte of the first row
+     * @param stride number of bytes between the start of each row.
+     * A negative value fills the array from the bottom up.
+     * @param numRows number of rows to decode
+     * @return the number of rows decoded, less than numRows once the end
+     * of the image is reached
+     * @exception InternalError on error with the image decoding
+     * @exception ArrayIndexOutOfBoundsException if the rows do not fit in
+     * the array
+     */
+    native int getImageRowBytes(long context,
+                                byte[] buffer,
+                                int offset,
+                                int stride,
+                                int numRows)
+        throws InternalError;
+
+    /**
+     * Decodes the next rows of the image straight into the given direct
+     * buffer as packed bytes, in the same form as getImageRowBytes(). The
+     * position and limit of the buffer are ignored.
+     *
+     * @param context the decoding context from acquireContext()
+     * @param buffer direct buffer to receive the pixel data
+     * @param offset index of the first byte of the first row
+     * @param stride number of bytes between the start of each row.
+     * A negative value fills the buffer from the bottom up.
+     * @param numRows number of rows to decode
+     * @return the number of rows decoded, less than numRows once the end
+     * of the image is reached
+     * @exception InternalError on error with the image decoding, or if
+     * the buffer is not direct
+     * @exception ArrayIndexOutOfBoundsException if the rows do not fit in
+     * the buffer
+     */
+    native int getImageRowBuffer(long context,
+                                 ByteBuffer buffer,
+                                 int offset,
+                                 int stride,
+                                 int numRows)
+        throws InternalError;
+
+    /**
+     * Decodes the whole image and scales it to the given size as it goes,
+     * into the given direct buffer as packed bytes in the same form as
+     * getImageRowBytes(). Decoded rows are fed straight into the scale
+     * filter, so the full size image is never held in memory. Must be
+     * called before any rows have been read. The position and limit of the
+     * buffer are ignored.
+     *
+     * @param context the decoding context from acquireContext()
+     * @param filterType the scale filter, exactly as returned by
+     * ImageScaleFilterDriver.getScaleFilterTypes()
+     * @param buffer direct buffer to receive the scaled pixels
+     * @param width the width to scale the image to
+     * @param height the height to scale the image to
+     * @param flip true to store the last row first
+     * @exception InternalError on error with the image decoding, if the
+     * buffer is not direct, the filter type is unknown or rows have already
+     * been read
+     * @exception ArrayIndexOutOfBoundsException if the scaled image does
+     * not fit in the buffer
+     * @exception OutOfMemoryError if there is not enough native memory
+     */
+    native void getScaledImageBuffer(long context,
+                                     String filterType,
+                                     ByteBuffer buffer,
+                                     int width,
+                                     int height,
+                                     boolean flip)
         throws InternalError;
 
     /**
      * Performs any necessary cleanup on the native side when the image has
      * been fully decoded.
-     * @param id identify this thread to the native library
+     * @param context the decoding context from acquireContext()
      */
-    native void finishDecoding(int id);
+    native void finishDecoding(long context);
 }
 
@@ -0,0 +1,126 @@
+/*****************************************************************************
+ *                     The Virtual Light Company Copyright(c)1999 - 2007
+ *                                         Java Source
+ *
+ * This code is licensed under the GNU Library GPL. Please read license.txt
+ * for the full details. A copy of the LGPL may be found at
+ *
+ * http://www.gnu.org/copyleft/lgpl.html
+ *
+ ****************************************************************************/
+
+package vlc.net.content.image;
+
+// Standard imports
+// none
+
+// Application specific imports
+// none
+
+/**
+ * The basic details of an image, as read from its header without
+ * decoding any of the pixels.
+ * <p>
+ *
+ * Instances are created by {@link ImageBuilder#probe(java.io.InputStream)} and
+ * its variants.
+ * <P>
+ *
+ * This softare is released under the
+ * <A HREF="http://www.gnu.org/copyleft/lgpl.html">GNU LGPL</A>
+ *
+ * @author  Justin Couch
+ * @version $Revision: 1.1 $
+ */
+public class ImageInfo
+{
+    /** Width of the image in pixels */
+    private final int width;
+
+    /** Height of the image in pixels */
+    private final int height;
+
+    /** Number of colour components a decode of the image returns */
+    private final int numComponents;
+
+    /** Bits per sample in the encoded image */
+    private final int bitDepth;
+
+    /** Is the image interlaced or progressive */
+    private final boolean interlaced;
+
+    /**
+     * Create a description of an image.
+     *
+     * @param width The image width
+     * @param height The image height
+     * @param numComponents The number of colour components, 1 - 4
+     * @param bitDepth The number of bits per sample
+     * @param interlaced true if the image is interlaced or progressive
+     */
+    ImageInfo(int width,
+              int height,
+              int numComponents,
+              int bitDepth,
+              boolean interlaced)
+    {
+        this.width = width;
+        this.height = height;
+        this.numComponents = numComponents;
+        this.bitDepth = bitDepth;
+        this.interlaced = interlaced;
+    }
+
+    /**
+     * Get the width of the image.
+     *
+     * @return The width in pixels
+     */
+    public int getWidth()
+    {
+        return width;
+    }
+
+    /**
+     * Get the height of the image.
+     *
+     * @return The height in pixels
+     */
+    public int getHeight()
+    {
+        return height;
+    }
+
+    /**
+     * Get the number of colour components that decoding the image will
+     * produce. This will be a value of 1 to 4.
+     *
+     * @return A value 1 - 4
+     */
+    public int getNumColorComponents()
+    {
+        return numComponents;
+    }
+
+    /**
+     * Get the number of bits per sample in the encoded image. For colour
+     * mapped images this is the number of bits per index.
+     *
+     * @return The bit depth of the encoded data
+     */
+    public int getBitDepth()
+    {
+        return bitDepth;
+    }
+
+    /**
+     * Check whether the image is stored interlaced, or for JPEG images,
+     * progressive.
+     *
+     * @return true if the image is interlaced or progressive
+     */
+    public boolean isInterlaced()
+    {
+        return interlaced;
+    }
+}
@@ -0,0 +1,137 @@
+/*****************************************************************************
+ *                     The Virtual Light Company Copyright(c)1999 - 2007
+ *                                         Java Source
+ *
+ * This code is licensed under the GNU Library GPL. Please read license.txt
+ * for the full details. A copy of the LGPL may be found at
+ *
+ * http://www.gnu.org/copyleft/lgpl.html
+ *
+ ****************************************************************************/
+
+package vlc.net.content.image;
+
+// Standard imports
+import java.io.IOException;
+
+// Application specific imports
+// none
+
+/**
+ * An encoded image that may hold more than one page, such as a multi-page
+ * TIFF file, opened so that its pages can be decoded in any order.
+ * <p>
+ *
+ * The encoded data is read in once when the image is opened and shared by
+ * every page decoded from it. Pages are only decoded when asked for. Formats
+ * that do not have pages are treated as a single page 0, which can only be
+ * decoded the once.
+ * <p>
+ *
+ * Instances are created by {@link ImageBuilder#openPages(java.io.InputStream)}
+ * and its variants, and hold native resources until {@link #close()} is
+ * called. An instance must not be used from more than one thread at a time.
+ * <P>
+ *
+ * This softare is released under the
+ * <A HREF="http://www.gnu.org/copyleft/lgpl.html">GNU LGPL</A>
+ *
+ * @author  Justin Couch
+ * @version $Revision: 1.1 $
+ */
+public class MultiPageImage
+{
+    /** The builder that turns decoded pages into the requested objects */
+    private final ImageBuilder builder;
+
+    /** The decoder holding the encoded image */
+    private final ImageDecoder decoder;
+
+    /** Our native decoding context, 0 once closed */
+    private long context;
+
+    /** Number of pages in the image */
+    private final int numPages;
+
+    /** Has the single page of a one page image been decoded */
+    private boolean decodedOnly;
+
+    /**
+     * Create a set of pages around a decoder that has been initialised with
+     * the encoded image. The context belongs to this object from here on.
+     *
+     * @param builder The builder to create the decoded images with
+     * @param decoder The decoder holding the image
+     * @param context The context the decoder was initialised with
+     * @param numPages The number of pages in the image
+     */
+    MultiPageImage(ImageBuilder builder,
+                   ImageDecoder decoder,
+                   long context,
+                   int numPages)
+    {
+        this.builder = builder;
+        this.decoder = decoder;
+        this.context = context;
+        this.numPages = numPages;
+
+        decodedOnly = false;
+    }
+
+    /**
+     * Get the number of pages in the image. This is at least 1.
+     *
+     * @return The number of pages
+     */
+    public int getPageCount()
+    {
+        return numPages;
+    }
+
+    /**
+     * Decode one page of the image and return it as the object type
+     * requested. The type is one of the ImageBuilder *_REQD flags.
+     *
+     * @param page The index of the page, from 0
+     * @param type The requested image output type
+     * @return the decoded page
+     * @throws IOException on errors decoding the page, or if the image
+     *   has been closed
+     * @throws IndexOutOfBoundsException if there is no such page
+     */
+    public Object decodePage(int page, int type)
+        throws IOException
+    {
+        if(context == 0)
+            throw new IOException("Image has been closed");
+
+        if((page < 0) || (page >= numPages))
+            throw new IndexOutOfBoundsException("No such page: " + page);
+
+        if(numPages == 1)
+        {
+            if(decodedOnly)
+                throw new IOException("Image has already been decoded");
+
+            decodedOnly = true;
+        }
+
+        return builder.decodePage(decoder, context, page, type);
+    }
+
+    /**
+     * Release the encoded image and the native resources holding it. Any
+     * stream the image was read from is left open. Calling this more than
+     * once has no effect.
+     */
+    public void close()
+    {
+        if(context == 0)
+            return;
+
+        decoder.finishDecoding(context);
+        decoder.releaseContext(context);
+
+        context = 0;
+    }
+}
@@ -1,6 +1,4 @@
-
 #include "image_scale_filter.h"
-#include "math.h"
 
 /* structure containing shared scalor paraameter */
 typedef struct _param_struct *param_ptr;
@@ -8,527 +6,512 @@ typedef struct _param_struct {
 	struct param pub;
 } param_struct;
 
-/* float scaled values per row */
-typedef struct _row_cmp *row_cmp_ptr;
-typedef struct _row_cmp {
-	float *red;
-	float *green;
-	float *blue;
-	float *alpha;
-} row_cmp;
+/*
+ * The source pixels one destination pixel covers along a row. A source
+ * pixel is dstWidth units wide and a destination pixel srcWidth units, so
+ * the covered widths are whole numbers. All but the first and last source
+ * pixels are covered completely, so only the two ends need their own
+ * weight. The spans are the same for every row, so are worked out once.
+ */
+typedef struct _x_span {
+	int first;                              /* first component of first pixel */
+	int last;                               /* first component of last pixel */
+	int first_weight;                       /* width of first pixel covered */
+	int last_weight;                        /* width of last pixel covered */
+} x_span;
 
 /*
- * Initialize the destination byte buffer with image data scaled to the
- * width and height specified from the source byte buffer.
+ * Work out the source pixels covered by each destination pixel of a row.
  */
-static void fillOneCompBuffer( FilterParam params ) {
-	
-	int srcWidth, srcHeight, srcComponents, srcPixels;
-	int dstWidth, dstHeight;
-	
-	int row_cmp_size;
-	row_cmp_ptr row;
-	
-	int sx, sy, dx, dy;
-	int sxrem, syrem, dxrem, dyrem;
-	int amtx, amty;
-	int srcRowByteOffset, srcColByteOffset;
-	int dstByteOffset;
-	int dstRowByteIndex;
-	int dstRowByteLength;
+static void build_x_spans( int srcWidth, int dstWidth, int cmp, x_span *spans ) {
+
+	int sx, dx;
+	int sxrem, dxrem;
+	int amtx;
+
+	sx = 0;
+	dx = 0;
+	sxrem = dstWidth;
+	dxrem = srcWidth;
+
+	while ( sx < srcWidth ) {
+		if ( sxrem < dxrem ) {
+			amtx = sxrem;
+		} else {
+			amtx = dxrem;
+		}
+		if ( dxrem == srcWidth ) {
+			spans[dx].first = sx * cmp;
+			spans[dx].first_weight = amtx;
+		}
+		spans[dx].last = sx * cmp;
+		spans[dx].last_weight = amtx;
+
+		if ( ( sxrem -= amtx ) == 0 ) {
+			sx++;
+			sxrem = dstWidth;
+		}
+		if ( ( dxrem -= amtx ) == 0 ) {
+			dx++;
+			dxrem = srcWidth;
+		}
+	}
+}
+
+/*
+ * Build the running totals of one source row, so that the sum of any run
+ * of pixels is one subtraction. sums[x * cmp + k] is the total of
+ * component k over the pixels before x. Gray alpha and RGBA images have
+ * their colour components premultiplied by the alpha, leaving them in
+ * units of 255 times their value.
+ *
+ * The totals are carried in locals rather than read back from the last
+ * pixel, which is why each component count has its own loop.
+ */
+static void sum_row( const jbyte *src, jlong *sums, int width,
+                     int cmp ) {
+
+	const unsigned char *in = (const unsigned char *)src;
+	jlong r, g, b, a;
 	int i;
-	float r;
-	float mult;
-	
-	jbyte *row_data;
-	jbyte *srcBuffer;
-	jbyte *dstBuffer;
-	
-	int r_int;
-	
-	param_ptr source = (param_ptr)params;
-	
-	srcWidth = source->pub.srcWidth;
-	srcHeight = source->pub.srcHeight;
-	srcComponents = source->pub.srcComponents;
-	srcPixels = srcWidth * srcHeight;
-	srcBuffer = source->pub.src_pixel_data;
-	
-	dstWidth = source->pub.dstWidth;
-	dstHeight = source->pub.dstHeight;
-	dstBuffer = source->pub.dst_pixel_data;
-	
-	row = (row_cmp_ptr)malloc( sizeof( row_cmp ) );
-	
-	row_cmp_size = dstWidth * sizeof( float );
-	row->red = (float*)malloc( row_cmp_size );
-	
-	dstRowByteLength = dstWidth*srcComponents;
-	row_data = (jbyte*)malloc( dstRowByteLength );
-	
-	///////////////////////////////////////////////////////////////////
-	sy = 0;
-	syrem = dstHeight;
-	dy = 0;
-	dyrem = 0;
-	
-	srcRowByteOffset = 0;
-	dstByteOffset = 0;
-	
-	while ( sy < srcHeight ) {
-		amty;
-		if ( dyrem == 0 ) {
-			for ( i = 0; i < dstWidth; i++ ) {
-				row->red[i] = 0;
-			}
-			dyrem = srcHeight;
+
+	r = g = b = a = 0;
+
+	switch ( cmp ) {
+		case 1:
+		*sums++ = 0;
+		for ( i = 0; i < width; i++ ) {
+			*sums++ = r += in[i];
 		}
-		if ( syrem < dyrem ) {
-			amty = syrem;
-		} else {
-			amty = dyrem;
+		break;
+		case 2:
+		*sums++ = 0;
+		*sums++ = 0;
+		for ( i = 0; i < width; i++, in += 2 ) {
+			*sums++ = r += in[0] * in[1];
+			*sums++ = a += in[1];
 		}
-		sx = 0;
-		dx = 0;
-		sxrem = 0;
-		dxrem = srcWidth;
-		r = 0;
-		while ( sx < srcWidth ) {
-			if ( sxrem == 0 ) {
-				sxrem = dstWidth;
-				srcColByteOffset = sx * srcComponents;
-				r = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset ];
-			}
-			int amtx;
-			if ( sxrem < dxrem ) {
-				amtx = sxrem;
-			} else {
-				amtx = dxrem;
-			}
-			mult = ((float)amtx) * amty;
-			row->red[dx] += mult * r;
-			if ( ( sxrem -= amtx ) == 0 ) {
-				sx++;
+		break;
+		case 3:
+		*sums++ = 0;
+		*sums++ = 0;
+		*sums++ = 0;
+		for ( i = 0; i < width; i++, in += 3 ) {
+			*sums++ = r += in[0];
+			*sums++ = g += in[1];
+			*sums++ = b += in[2];
+		}
+		break;
+		case 4:
+		*sums++ = 0;
+		*sums++ = 0;
+		*sums++ = 0;
+		*sums++ = 0;
+		for ( i = 0; i < width; i++, in += 4 ) {
+			*sums++ = r += in[0] * in[3];
+			*sums++ = g += in[1] * in[3];
+			*sums++ = b += in[2] * in[3];
+			*sums++ = a += in[3];
+		}
+		break;
+	}
+}
+
+/*
+ * Work out the weighted total of each destination pixel along one source
+ * row from its running totals. The components stay interleaved, so the
+ * one loop does any number of them.
+ */
+static void weigh_row( const x_span *spans, int width, const jlong *sums,
+                       jlong *row, int cmp, int full_weight ) {
+
+	const jlong *first;
+	const jlong *last;
+	jlong first_weight, last_weight;
+	int i, k;
+
+	for ( i = 0; i < width; i++ ) {
+		first = sums + spans[i].first;
+		last = sums + spans[i].last;
+		first_weight = spans[i].first_weight;
+		last_weight = spans[i].last_weight;
+
+		if ( first == last ) {
+			for ( k = 0; k < cmp; k++ ) {
+				row[k] = first_weight * ( first[k + cmp] - first[k] );
 			}
-			if ( ( dxrem -= amtx ) == 0 ) {
-				dx++;
-				dxrem = srcWidth;
+		} else {
+			for ( k = 0; k < cmp; k++ ) {
+				row[k] = first_weight * ( first[k + cmp] - first[k] ) +
+				         (jlong)full_weight * ( last[k] - first[k + cmp] ) +
+				         last_weight * ( last[k + cmp] - last[k] );
 			}
 		}
-		if ( ( dyrem -= amty ) == 0 ) {
-			///////////////////////////////////////////////////////////////////
-			dstRowByteIndex = 0;
-			for ( i = 0; i < dstWidth; i++ ) {
-				mult = (float)srcPixels;
-				r_int = (int)roundf( row->red[i] / mult );
-				
-				if ( r_int < 0 ) { 
-					r_int = 0; 
-				} else if ( r_int > 255 ) { 
-					r_int = 255; 
-				}
-				
-				row_data[dstRowByteIndex++] = (jbyte)r_int;
+
+		row += cmp;
+	}
+}
+
+/*
+ * Turn the totals for one destination row into bytes. Every destination
+ * pixel has a total weight of srcPixels. Premultiplied colour is divided
+ * back out by the pixel's total alpha, unless that rounds to fully clear
+ * or fully opaque.
+ */
+static void store_row( const jlong *totals, jbyte *out, int width, int cmp,
+                       int has_alpha, double srcPixels ) {
+
+	double scale, cmp_scale;
+	int i, k, v, a;
+
+	scale = 1.0 / srcPixels;
+
+	if ( !has_alpha ) {
+		for ( i = 0; i < width * cmp; i++ ) {
+			v = (int)( totals[i] * scale + 0.5 );
+			if ( v > 255 ) {
+				v = 255;
 			}
-			///////////////////////////////////////////////////////////////////
-			do {
-				for ( i = 0; i < dstRowByteLength; i++ ) {
-					dstBuffer[ dstByteOffset++ ] = row_data[i];
-				}
-				dy++;
-			} while ( ( ( syrem -= amty ) >= amty ) && ( amty == srcHeight ) );
+			out[i] = (jbyte)v;
+		}
+		return;
+	}
+
+	for ( i = 0; i < width; i++ ) {
+		a = (int)( totals[cmp - 1] * scale + 0.5 );
+		if ( a <= 0 ) {
+			a = 0;
+			cmp_scale = scale / 255;
+		} else if ( a >= 255 ) {
+			a = 255;
+			cmp_scale = scale / 255;
 		} else {
-			syrem -= amty;
+			cmp_scale = 1.0 / totals[cmp - 1];
 		}
-		if ( syrem == 0 ) {
-			syrem = dstHeight;
-			sy++;
-			srcRowByteOffset += srcWidth * srcComponents;
+
+		for ( k = 0; k < cmp - 1; k++ ) {
+			v = (int)( totals[k] * cmp_scale + 0.5 );
+			if ( v > 255 ) {
+				v = 255;
+			}
+			out[k] = (jbyte)v;
 		}
+		out[cmp - 1] = (jbyte)a;
+
+		totals += cmp;
+		out += cmp;
 	}
-	///////////////////////////////////////////////////////////////////
-	free( row_data );
-	free( row->red );
-	free( row );
 }
+
+/* Most source pixels added into one jint total, so that it can't */
+/* overflow even with premultiplied alpha */
+#define MAX_BLOCK_PIXELS ( 0x7fffffff / ( 255 * 255 ) )
+
+/* Number of samples of a row added into the column totals together, */
+/* a whole number of pixels for any component count */
+#define ADD_BLOCK 48
+
 /*
- * Initialize the destination byte buffer with image data scaled to the
- * width and height specified from the source byte buffer.
+ * Add one source row into a set of column totals, one per component.
+ * Gray alpha and RGBA images have their colour components premultiplied
+ * by the alpha, as in sum_row(). The row is done in blocks, each added up
+ * in a local array before any of it is stored, so the compiler knows the
+ * totals can't overlap the row and vectorises the adds. Any samples left
+ * over after the last whole block are done one at a time.
  */
-static void fillTwoCompBuffer( FilterParam params ) {
-	
-	int srcWidth, srcHeight, srcComponents, srcPixels;
-	int dstWidth, dstHeight;
-	
-	int row_cmp_size;
-	row_cmp_ptr row;
-	
-	int sx, sy, dx, dy;
-	int sxrem, syrem, dxrem, dyrem;
-	int amtx, amty;
-	int srcRowByteOffset, srcColByteOffset;
-	int dstByteOffset;
-	int dstRowByteIndex;
-	int dstRowByteLength;
-	int i;
-	float a, r;
-	float ascale, mult;
-	
-	jbyte *row_data;
-	jbyte *srcBuffer;
-	jbyte *dstBuffer;
-	
-	int a_int, r_int;
-	
-	param_ptr source = (param_ptr)params;
-	
-	srcWidth = source->pub.srcWidth;
-	srcHeight = source->pub.srcHeight;
-	srcComponents = source->pub.srcComponents;
-	srcPixels = srcWidth * srcHeight;
-	srcBuffer = source->pub.src_pixel_data;
-	
-	dstWidth = source->pub.dstWidth;
-	dstHeight = source->pub.dstHeight;
-	dstBuffer = source->pub.dst_pixel_data;
-	
-	row = (row_cmp_ptr)malloc( sizeof( row_cmp ) );
-	
-	row_cmp_size = dstWidth * sizeof( float );
-	row->red = (float*)malloc( row_cmp_size );
-	row->alpha = (float*)malloc( row_cmp_size );
-	
-	dstRowByteLength = dstWidth*srcComponents;
-	row_data = (jbyte*)malloc( dstRowByteLength );
-	
-	///////////////////////////////////////////////////////////////////
-	sy = 0;
-	syrem = dstHeight;
-	dy = 0;
-	dyrem = 0;
-	
-	srcRowByteOffset = 0;
-	dstByteOffset = 0;
-	
-	while ( sy < srcHeight ) {
-		amty;
-		if ( dyrem == 0 ) {
-			for ( i = 0; i < dstWidth; i++ ) {
-				row->alpha[i] = row->red[i] = 0;
+static void add_columns( const jbyte *src, jint *cols, int width, int cmp ) {
+
+	const unsigned char *in = (const unsigned char *)src;
+	jint block[ADD_BLOCK];
+	int length = width * cmp;
+	int i, j;
+
+	switch ( cmp ) {
+		case 1:
+		case 3:
+		for ( i = 0; i + ADD_BLOCK <= length; i += ADD_BLOCK ) {
+			for ( j = 0; j < ADD_BLOCK; j++ ) {
+				block[j] = cols[i + j] + in[i + j];
+			}
+			for ( j = 0; j < ADD_BLOCK; j++ ) {
+				cols[i + j] = block[j];
 			}
-			dyrem = srcHeight;
 		}
-		if ( syrem < dyrem ) {
-			amty = syrem;
-		} else {
-			amty = dyrem;
+		for ( ; i < length; i++ ) {
+			cols[i] += in[i];
 		}
-		sx = 0;
-		dx = 0;
-		sxrem = 0;
-		dxrem = srcWidth;
-		a = 0, r = 0;
-		while ( sx < srcWidth ) {
-			if ( sxrem == 0 ) {
-				sxrem = dstWidth;
-				srcColByteOffset = sx * srcComponents;
-				r = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset++ ];
-				a = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset ];
-				// premultiply the components if necessary
-				if ( a != 255.0 ) {
-					ascale = a / 255.0;
-					r *= ascale;
-				}
+		break;
+		case 2:
+		for ( i = 0; i + ADD_BLOCK <= length; i += ADD_BLOCK ) {
+			for ( j = 0; j < ADD_BLOCK; j += 2 ) {
+				block[j] = cols[i + j] + in[i + j] * in[i + j + 1];
+				block[j + 1] = cols[i + j + 1] + in[i + j + 1];
 			}
-			int amtx;
-			if ( sxrem < dxrem ) {
-				amtx = sxrem;
-			} else {
-				amtx = dxrem;
+			for ( j = 0; j < ADD_BLOCK; j++ ) {
+				cols[i + j] = block[j];
 			}
-			mult = ((float)amtx) * amty;
-			row->alpha[dx] += mult * a;
-			row->red[dx] += mult * r;
-			if ( ( sxrem -= amtx ) == 0 ) {
-				sx++;
+		}
+		for ( ; i < length; i += 2 ) {
+			cols[i] += in[i] * in[i + 1];
+			cols[i + 1] += in[i + 1];
+		}
+		break;
+		case 4:
+		for ( i = 0; i + ADD_BLOCK <= length; i += ADD_BLOCK ) {
+			for ( j = 0; j < ADD_BLOCK; j += 4 ) {
+				block[j] = cols[i + j] + in[i + j] * in[i + j + 3];
+				block[j + 1] = cols[i + j + 1] + in[i + j + 1] * in[i + j + 3];
+				block[j + 2] = cols[i + j + 2] + in[i + j + 2] * in[i + j + 3];
+				block[j + 3] = cols[i + j + 3] + in[i + j + 3];
 			}
-			if ( ( dxrem -= amtx ) == 0 ) {
-				dx++;
-				dxrem = srcWidth;
+			for ( j = 0; j < ADD_BLOCK; j++ ) {
+				cols[i + j] = block[j];
 			}
 		}
-		if ( ( dyrem -= amty ) == 0 ) {
-			///////////////////////////////////////////////////////////////////
-			dstRowByteIndex = 0;
-			for ( i = 0; i < dstWidth; i++ ) {
-				mult = (float)srcPixels;
-				a_int = (int)roundf( row->alpha[i] / mult );
-				if ( a_int <= 0 ) {
-					a_int = 0;
-				} else if ( a_int >= 255 ) {
-					a_int = 255;
-				} else {
-					// un-premultiply the components (by modifying mult here, we
-					// are effectively doing the divide by mult and divide by
-					// alpha in the same step)
-					mult = row->alpha[i] / 255;
-				}
-				r_int = (int)roundf( row->red[i] / mult );
-				
-				if ( r_int < 0 ) { 
-					r_int = 0; 
-				} else if ( r_int > 255 ) { 
-					r_int = 255; 
-				}
-				
-				row_data[dstRowByteIndex++] = (jbyte)r_int;
-				row_data[dstRowByteIndex++] = (jbyte)a_int;
-			}
-			///////////////////////////////////////////////////////////////////
-			do {
-				for ( i = 0; i < dstRowByteLength; i++ ) {
-					dstBuffer[ dstByteOffset++ ] = row_data[i];
-				}
-				dy++;
-			} while ( ( ( syrem -= amty ) >= amty ) && ( amty == srcHeight ) );
-		} else {
-			syrem -= amty;
+		for ( ; i < length; i += 4 ) {
+			cols[i] += in[i] * in[i + 3];
+			cols[i + 1] += in[i + 1] * in[i + 3];
+			cols[i + 2] += in[i + 2] * in[i + 3];
+			cols[i + 3] += in[i + 3];
 		}
-		if ( syrem == 0 ) {
-			syrem = dstHeight;
-			sy++;
-			srcRowByteOffset += srcWidth * srcComponents;
+		break;
+	}
+}
+
+/*
+ * Total each run of RATIO columns of CMP components and weigh it. The
+ * counts are constants, so the compiler can unroll and vectorise each
+ * expansion.
+ */
+#define SUM_BLOCKS( RATIO, CMP ) \
+	for ( i = 0; i < width; i++, cols += ( RATIO ) * ( CMP ), row += ( CMP ) ) { \
+		for ( k = 0; k < ( CMP ); k++ ) { \
+			sum = 0; \
+			for ( j = 0; j < ( RATIO ); j++ ) { \
+				sum += cols[j * ( CMP ) + k]; \
+			} \
+			row[k] = weight * sum; \
+		} \
+	}
+
+/* SUM_BLOCKS() for each component count */
+#define SUM_BLOCKS_CMP( RATIO ) \
+	switch ( cmp ) { \
+		case 1: SUM_BLOCKS( RATIO, 1 ); break; \
+		case 2: SUM_BLOCKS( RATIO, 2 ); break; \
+		case 3: SUM_BLOCKS( RATIO, 3 ); break; \
+		case 4: SUM_BLOCKS( RATIO, 4 ); break; \
+	}
+
+/*
+ * Work out the weighted total of each destination pixel from column
+ * totals, when every destination pixel covers exactly ratio columns. The
+ * common ratios have their own loops.
+ */
+static void sum_blocks( const jint *cols, jlong *row, int width, int cmp,
+                        int ratio, jlong weight ) {
+
+	jint sum;
+	int i, j, k;
+
+	switch ( ratio ) {
+		case 1:
+		for ( i = 0; i < width * cmp; i++ ) {
+			row[i] = weight * cols[i];
 		}
+		break;
+		case 2:
+		SUM_BLOCKS_CMP( 2 );
+		break;
+		case 3:
+		SUM_BLOCKS_CMP( 3 );
+		break;
+		case 4:
+		SUM_BLOCKS_CMP( 4 );
+		break;
+		case 8:
+		SUM_BLOCKS_CMP( 8 );
+		break;
+		default:
+		SUM_BLOCKS( ratio, cmp );
+		break;
 	}
-	///////////////////////////////////////////////////////////////////
-	free( row_data );
-	free( row->red );
-	free( row->alpha );
-	free( row );
 }
+
 /*
- * Initialize the destination byte buffer with image data scaled to the
- * width and height specified from the source byte buffer.
+ * Scale num_rows rows, starting at first_row, when both sizes shrink by a
+ * whole number. Every destination pixel is then an exact block of source
+ * pixels, so the source rows of each block are added straight down into
+ * column totals and the columns across in runs, with no partial pixels to
+ * weigh. The totals are weighted as area_avg_scale() weighs them, so the
+ * result is the same. Returns 0 if out of memory.
  */
-static void fillThreeCompBuffer( FilterParam params ) {
-	
-	int srcWidth, srcHeight, srcComponents, srcPixels;
+static int block_avg_scale( param_ptr source, int first_row, int num_rows,
+                             int x_ratio, int y_ratio ) {
+
+	int srcWidth, srcHeight, srcComponents;
 	int dstWidth, dstHeight;
-	
-	int row_cmp_size;
-	row_cmp_ptr row;
-	
-	int sx, sy, dx, dy;
-	int sxrem, syrem, dxrem, dyrem;
-	int amtx, amty;
-	int srcRowByteOffset, srcColByteOffset;
-	int dstByteOffset;
-	int dstRowByteIndex;
-	int dstRowByteLength;
-	int i;
-	float r, g, b;
-	float mult;
-	
-	jbyte *row_data;
-	jbyte *srcBuffer;
+	int has_alpha;
+
+	jint *cols;
+	jlong *totals;
+
+	int sy, dy, j;
+	int end_dy;
+	int dstRowLength;
+
+	const jbyte *srcRow;
 	jbyte *dstBuffer;
-	
-	int r_int, g_int, b_int;
-	
-	param_ptr source = (param_ptr)params;
-	
+
 	srcWidth = source->pub.srcWidth;
 	srcHeight = source->pub.srcHeight;
 	srcComponents = source->pub.srcComponents;
-	srcPixels = srcWidth * srcHeight;
-	srcBuffer = source->pub.src_pixel_data;
-	
+
 	dstWidth = source->pub.dstWidth;
 	dstHeight = source->pub.dstHeight;
 	dstBuffer = source->pub.dst_pixel_data;
-	
-	row = (row_cmp_ptr)malloc( sizeof( row_cmp ) );
-	
-	row_cmp_size = dstWidth * sizeof( float );
-	row->red = (float*)malloc( row_cmp_size );
-	row->green = (float*)malloc( row_cmp_size );
-	row->blue = (float*)malloc( row_cmp_size );
-	
-	dstRowByteLength = dstWidth*srcComponents;
-	row_data = (jbyte*)malloc( dstRowByteLength );
-	
-	///////////////////////////////////////////////////////////////////
-	sy = 0;
-	syrem = dstHeight;
-	dy = 0;
-	dyrem = 0;
-	
-	srcRowByteOffset = 0;
-	dstByteOffset = 0;
-	
-	while ( sy < srcHeight ) {
-		amty;
-		if ( dyrem == 0 ) {
-			for ( i = 0; i < dstWidth; i++ ) {
-				row->red[i] = row->green[i] = row->blue[i] = 0;
-			}
-			dyrem = srcHeight;
-		}
-		if ( syrem < dyrem ) {
-			amty = syrem;
-		} else {
-			amty = dyrem;
-		}
-		sx = 0;
-		dx = 0;
-		sxrem = 0;
-		dxrem = srcWidth;
-		r = 0, g = 0, b = 0;
-		while ( sx < srcWidth ) {
-			if ( sxrem == 0 ) {
-				sxrem = dstWidth;
-				srcColByteOffset = sx * srcComponents;
-				r = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset++ ];
-				g = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset++ ];
-				b = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset ];
-			}
-			int amtx;
-			if ( sxrem < dxrem ) {
-				amtx = sxrem;
-			} else {
-				amtx = dxrem;
-			}
-			mult = ((float)amtx) * amty;
-			row->red[dx] += mult * r;
-			row->green[dx] += mult * g;
-			row->blue[dx] += mult * b;
-			if ( ( sxrem -= amtx ) == 0 ) {
-				sx++;
-			}
-			if ( ( dxrem -= amtx ) == 0 ) {
-				dx++;
-				dxrem = srcWidth;
-			}
-		}
-		if ( ( dyrem -= amty ) == 0 ) {
-			///////////////////////////////////////////////////////////////////
-			dstRowByteIndex = 0;
-			for ( i = 0; i < dstWidth; i++ ) {
-				mult = (float)srcPixels;
-				r_int = (int)roundf( row->red[i] / mult );
-				g_int = (int)roundf( row->green[i] / mult );
-				b_int = (int)roundf( row->blue[i] / mult );
-				
-				if ( r_int < 0 ) { 
-					r_int = 0; 
-				} else if ( r_int > 255 ) { 
-					r_int = 255; 
-				}
-				if ( g_int < 0 ) { 
-					g_int = 0; 
-				} else if ( g_int > 255 ) { 
-					g_int = 255; 
-				}
-				if ( b_int < 0 ) { 
-					b_int = 0; 
-				} else if ( b_int > 255 ) { 
-					b_int = 255; 
-				}
-				
-				row_data[dstRowByteIndex++] = (jbyte)r_int;
-				row_data[dstRowByteIndex++] = (jbyte)g_int;
-				row_data[dstRowByteIndex++] = (jbyte)b_int;
+
+	has_alpha = ( srcComponents == 2 || srcComponents == 4 );
+	dstRowLength = dstWidth * srcComponents;
+
+	cols = (jint*)malloc( srcWidth * srcComponents * sizeof( jint ) );
+	totals = (jlong*)malloc( dstRowLength * sizeof( jlong ) );
+
+	if ( cols == NULL || totals == NULL ) {
+		free( cols );
+		free( totals );
+		return( 0 );
+	}
+
+	sy = first_row * y_ratio;
+	end_dy = first_row + num_rows;
+
+	for ( dy = first_row; dy < end_dy; dy++ ) {
+		memset( cols, 0, srcWidth * srcComponents * sizeof( jint ) );
+
+		for ( j = 0; j < y_ratio; j++, sy++ ) {
+			srcRow = SRC_ROW( &source->pub, sy );
+			if ( srcRow == NULL ) {
+				break;
 			}
-			///////////////////////////////////////////////////////////////////
-			do {
-				for ( i = 0; i < dstRowByteLength; i++ ) {
-					dstBuffer[ dstByteOffset++ ] = row_data[i];
-				}
-				dy++;
-			} while ( ( ( syrem -= amty ) >= amty ) && ( amty == srcHeight ) );
-		} else {
-			syrem -= amty;
+			add_columns( srcRow, cols, srcWidth, srcComponents );
 		}
-		if ( syrem == 0 ) {
-			syrem = dstHeight;
-			sy++;
-			srcRowByteOffset += srcWidth * srcComponents;
+		if ( j < y_ratio ) {
+			break;
 		}
+
+		/* each source pixel is dstWidth by dstHeight units */
+		sum_blocks( cols, totals, dstWidth, srcComponents, x_ratio,
+		            (jlong)dstWidth * dstHeight );
+		store_row( totals, dstBuffer + (size_t)dy * dstRowLength, dstWidth,
+		           srcComponents, has_alpha, (double)srcWidth * srcHeight );
 	}
-	///////////////////////////////////////////////////////////////////
-	free( row_data );
-	free( row->red );
-	free( row->green );
-	free( row->blue );
-	free( row );
+
+	free( cols );
+	free( totals );
+	return( 1 );
 }
+
 /*
- * Initialize the destination byte buffer with image data scaled to the
- * width and height specified from the source byte buffer.
+ * Initialize num_rows rows of the destination byte buffer, starting at
+ * first_row, with image data scaled to the width and height specified from
+ * the source byte buffer. Each destination pixel is the average of the
+ * source area it covers, weighted by how much of each source pixel falls
+ * inside it.
+ *
+ * The weights are whole numbers, so the sums are kept exactly in integers
+ * and only divided once per destination component. Each source row is
+ * weighed across once, then added into every destination row it overlaps
+ * with the height of the overlap as the weight. A band of rows starts
+ * from the source row its first row begins in, so it comes out the same
+ * however the image is split up. Source rows are fetched once each and in
+ * order, so they can be decoded as they are needed, and the scale stops
+ * early if one can't be had.
+ *
+ * Shrinking by a whole number both ways is handed to block_avg_scale().
+ * Returns 0 if out of memory.
  */
-static void fillFourCompBuffer( FilterParam params ) {
-	
-	int srcWidth, srcHeight, srcComponents, srcPixels;
+static int area_avg_scale( FilterParam params, int first_row, int num_rows ) {
+
+	int srcWidth, srcHeight, srcComponents;
 	int dstWidth, dstHeight;
-	
-	int row_cmp_size;
-	row_cmp_ptr row;
-	
-	int sx, sy, dx, dy;
-	int sxrem, syrem, dxrem, dyrem;
-	int amtx, amty;
-	int srcRowByteOffset, srcColByteOffset;
-	int dstByteOffset;
-	int dstRowByteIndex;
-	int dstRowByteLength;
+	int has_alpha;
+	int x_ratio, y_ratio;
+
+	x_span *spans;
+	jlong *sums;
+	jlong *row;
+	jlong *totals;
+
+	int sy, dy;
+	int syrem, dyrem;
+	int amty;
+	int row_sy;
+	int end_dy;
+	jlong start;
+	int dstRowLength;
 	int i;
-	float a, r, g, b;
-	float ascale, mult;
-	
-	jbyte *row_data;
-	jbyte *srcBuffer;
+
+	const jbyte *srcRow;
 	jbyte *dstBuffer;
-	
-	int a_int, r_int, g_int, b_int;
-	
+	jbyte *dstRow;
+
 	param_ptr source = (param_ptr)params;
-	
+
 	srcWidth = source->pub.srcWidth;
 	srcHeight = source->pub.srcHeight;
 	srcComponents = source->pub.srcComponents;
-	srcPixels = srcWidth * srcHeight;
-	srcBuffer = source->pub.src_pixel_data;
-	
+
 	dstWidth = source->pub.dstWidth;
 	dstHeight = source->pub.dstHeight;
 	dstBuffer = source->pub.dst_pixel_data;
-	
-	row = (row_cmp_ptr)malloc( sizeof( row_cmp ) );
-	
-	row_cmp_size = dstWidth * sizeof( float );
-	row->red = (float*)malloc( row_cmp_size );
-	row->green = (float*)malloc( row_cmp_size );
-	row->blue = (float*)malloc( row_cmp_size );
-	row->alpha = (float*)malloc( row_cmp_size );
-	
-	dstRowByteLength = dstWidth*srcComponents;
-	row_data = (jbyte*)malloc( dstRowByteLength );
-	
+
+	if ( srcComponents < 1 || srcComponents > 4 ||
+	     srcWidth < 1 || srcHeight < 1 || dstWidth < 1 || dstHeight < 1 ) {
+		return( 1 );
+	}
+
+	/* a whole number ratio is 0 if the size doesn't divide exactly */
+	x_ratio = ( srcWidth % dstWidth == 0 ) ? srcWidth / dstWidth : 0;
+	y_ratio = ( srcHeight % dstHeight == 0 ) ? srcHeight / dstHeight : 0;
+
+	if ( x_ratio > 0 && y_ratio > 0 &&
+	     (jlong)x_ratio * y_ratio <= MAX_BLOCK_PIXELS ) {
+		return( block_avg_scale( source, first_row, num_rows, x_ratio, y_ratio ) );
+	}
+
+	/* gray alpha and RGBA images have alpha as the last component */
+	has_alpha = ( srcComponents == 2 || srcComponents == 4 );
+	dstRowLength = dstWidth * srcComponents;
+
+	spans = (x_span*)malloc( dstWidth * sizeof( x_span ) );
+	sums = (jlong*)malloc( ( srcWidth + 1 ) * srcComponents * sizeof( jlong ) );
+	row = (jlong*)malloc( dstRowLength * sizeof( jlong ) );
+	totals = (jlong*)malloc( dstRowLength * sizeof( jlong ) );
+
+	if ( spans == NULL || sums == NULL || row == NULL || totals == NULL ) {
+		free( spans );
+		free( sums );
+		free( row );
+		free( totals );
+		return( 0 );
+	}
+
+	build_x_spans( srcWidth, dstWidth, srcComponents, spans );
+
 	///////////////////////////////////////////////////////////////////
-	sy = 0;
-	syrem = dstHeight;
-	dy = 0;
+	/* a source row is dstHeight units high and a destination row srcHeight */
+	start = (jlong)first_row * srcHeight;
+	sy = (int)( start / dstHeight );
+	syrem = dstHeight - (int)( start % dstHeight );
+	dy = first_row;
 	dyrem = 0;
-	
-	srcRowByteOffset = 0;
-	dstByteOffset = 0;
-	
-	while ( sy < srcHeight ) {
-		amty;
+	row_sy = -1;
+	end_dy = first_row + num_rows;
+
+	while ( dy < end_dy ) {
 		if ( dyrem == 0 ) {
-			for ( i = 0; i < dstWidth; i++ ) {
-				row->alpha[i] = row->red[i] = row->green[i] = row->blue[i] = 0;
-			}
+			memset( totals, 0, dstRowLength * sizeof( jlong ) );
 			dyrem = srcHeight;
 		}
 		if ( syrem < dyrem ) {
@@ -536,136 +519,48 @@ static void fillFourCompBuffer( FilterParam params ) {
 		} else {
 			amty = dyrem;
 		}
-		sx = 0;
-		dx = 0;
-		sxrem = 0;
-		dxrem = srcWidth;
-		a = 0, r = 0, g = 0, b = 0;
-		while ( sx < srcWidth ) {
-			if ( sxrem == 0 ) {
-				sxrem = dstWidth;
-				srcColByteOffset = sx * srcComponents;
-				r = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset++ ];
-				g = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset++ ];
-				b = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset++ ];
-				a = 0xff & srcBuffer[ srcRowByteOffset + srcColByteOffset ];
-				// premultiply the components if necessary
-				if ( a != 255.0 ) {
-					ascale = a / 255.0;
-					r *= ascale;
-					g *= ascale;
-					b *= ascale;
-				}
-			}
-			int amtx;
-			if ( sxrem < dxrem ) {
-				amtx = sxrem;
-			} else {
-				amtx = dxrem;
-			}
-			mult = ((float)amtx) * amty;
-			row->alpha[dx] += mult * a;
-			row->red[dx] += mult * r;
-			row->green[dx] += mult * g;
-			row->blue[dx] += mult * b;
-			if ( ( sxrem -= amtx ) == 0 ) {
-				sx++;
-			}
-			if ( ( dxrem -= amtx ) == 0 ) {
-				dx++;
-				dxrem = srcWidth;
+
+		/* a source row can be shared by several destination rows */
+		if ( row_sy != sy ) {
+			srcRow = SRC_ROW( &source->pub, sy );
+			if ( srcRow == NULL ) {
+				break;
 			}
+			sum_row( srcRow, sums, srcWidth, srcComponents );
+			weigh_row( spans, dstWidth, sums, row, srcComponents, dstWidth );
+			row_sy = sy;
 		}
+
+		for ( i = 0; i < dstRowLength; i++ ) {
+			totals[i] += amty * row[i];
+		}
+
 		if ( ( dyrem -= amty ) == 0 ) {
-			///////////////////////////////////////////////////////////////////
-			dstRowByteIndex = 0;
-			for ( i = 0; i < dstWidth; i++ ) {
-				mult = (float)srcPixels;
-				a_int = (int)roundf( row->alpha[i] / mult );
-				if ( a_int <= 0 ) {
-					a_int = 0;
-				} else if ( a_int >= 255 ) {
-					a_int = 255;
-				} else {
-					// un-premultiply the components (by modifying mult here, we
-					// are effectively doing the divide by mult and divide by
-					// alpha in the same step)
-					mult = row->alpha[i] / 255;
-				}
-				r_int = (int)roundf( row->red[i] / mult );
-				g_int = (int)roundf( row->green[i] / mult );
-				b_int = (int)roundf( row->blue[i] / mult );
-				
-				if ( r_int < 0 ) { 
-					r_int = 0; 
-				} else if ( r_int > 255 ) { 
-					r_int = 255; 
-				}
-				if ( g_int < 0 ) { 
-					g_int = 0; 
-				} else if ( g_int > 255 ) { 
-					g_int = 255; 
-				}
-				if ( b_int < 0 ) { 
-					b_int = 0; 
-				} else if ( b_int > 255 ) { 
-					b_int = 255; 
-				}
-				
-				row_data[dstRowByteIndex++] = (jbyte)r_int;
-				row_data[dstRowByteIndex++] = (jbyte)g_int;
-				row_data[dstRowByteIndex++] = (jbyte)b_int;
-				row_data[dstRowByteIndex++] = (jbyte)a_int;
-			}
-			///////////////////////////////////////////////////////////////////
-			do {
-				for ( i = 0; i < dstRowByteLength; i++ ) {
-					dstBuffer[ dstByteOffset++ ] = row_data[i];
-				}
+			dstRow = dstBuffer + (size_t)dy * dstRowLength;
+			store_row( totals, dstRow, dstWidth, srcComponents, has_alpha,
+			           (double)srcWidth * srcHeight );
+			dy++;
+
+			/* destination rows wholly inside this source row are the same */
+			while ( ( ( syrem -= amty ) >= amty ) && ( amty == srcHeight ) &&
+			        ( dy < end_dy ) ) {
+				memcpy( dstBuffer + (size_t)dy * dstRowLength, dstRow, dstRowLength );
 				dy++;
-			} while ( ( ( syrem -= amty ) >= amty ) && ( amty == srcHeight ) );
+			}
 		} else {
 			syrem -= amty;
 		}
 		if ( syrem == 0 ) {
 			syrem = dstHeight;
 			sy++;
-			srcRowByteOffset += srcWidth * srcComponents;
 		}
 	}
 	///////////////////////////////////////////////////////////////////
-	free( row_data );
-	free( row->red );
-	free( row->green );
-	free( row->blue );
-	free( row->alpha );
+	free( spans );
+	free( sums );
 	free( row );
-}
-
-/*
- * coordination function for initiating the scale operation
- */
-static void area_avg_scale( FilterParam params ) {
-	
-	int cmp;
-	param_ptr source;
-	
-	source = (param_ptr)params;
-	cmp = source->pub.srcComponents;
-	switch ( cmp ) {
-		case 4:
-		fillFourCompBuffer( params );
-		break;
-		case 3:
-		fillThreeCompBuffer( params );
-		break;
-		case 2:
-		fillTwoCompBuffer( params );
-		break;
-		case 1:
-		fillOneCompBuffer( params );
-		break;
-	}
+	free( totals );
+	return( 1 );
 }
 
 /*
@@ -673,25 +568,27 @@ static void area_avg_scale( FilterParam params ) {
  * of the scaling operation.
  */
 FilterParam area_avg_init( ) {
-	
+
 	param_ptr source;
-	
+
 	/* Create module interface object */
 	source = (param_ptr)malloc(sizeof(param_struct));
-	
+
 	if (source != NULL) {
 		source->pub.srcWidth = -1;
 		source->pub.srcHeight = -1;
 		source->pub.srcComponents = 3;
 		source->pub.src_pixel_data = NULL;
+		source->pub.get_src_row = NULL;
+		source->pub.src_row_data = NULL;
 		source->pub.dstWidth = -1;
 		source->pub.dstHeight = -1;
 		source->pub.dstComponents = 3;
 		source->pub.dst_pixel_data = NULL;
-		
+
 		source->pub.scale_func = area_avg_scale;
 	}
-	
+
 	/* return the reference to initialized parameter structure */
 	return( (FilterParam)source );
 }
@@ -0,0 +1,413 @@
+/*****************************************************************************
+ *                The Virtual Light Company Copyright (c) 1999 - 2000
+ *                               C Source
+ *
+ * This code is licensed under the GNU Library GPL. Please read license.txt
+ * for the full details. A copy of the LGPL may be found at
+ *
+ * http://www.gnu.org/copyleft/lgpl.html
+ *
+ * Project:    Image Content Handlers
+ * URL:        http://www.vlc.com.au/imageloader/
+ *
+ ****************************************************************************/
+
+/*
+ * Buffered data sources that the image decoders read their encoded data
+ * from. A source is either a block of memory handed to us by the caller,
+ * in which case the decoders read straight from that memory, or a stream
+ * that is read through an internal buffer. The stream is either a stdio
+ * stream, or a java InputStream that is read on demand from the decoding
+ * thread.
+ */
+
+#include "decode_image.h"
+
+/* Private version of a source that reads from a stdio stream */
+typedef struct _stdio_source_struct * stdio_source_ptr;
+
+typedef struct _stdio_source_struct {
+   struct data_source pub;          /* public fields */
+   FILE *fptr;                      /* stream to read from */
+   U_CHAR buffer[SRC_BUF_SIZE];     /* holding area for data read */
+} stdio_source_struct;
+
+
+/* Private version of a source that pulls from a java InputStream */
+typedef struct _stream_source_struct * stream_source_ptr;
+
+typedef struct _stream_source_struct {
+   struct data_source pub;          /* public fields */
+   jobject stream;                  /* global ref to the InputStream */
+   jmethodID read_method;           /* InputStream.read(byte[], int, int) */
+   jbyteArray array;                /* global ref to the java read buffer */
+   U_CHAR *buffer;                  /* holding area for data read */
+   jint buffer_size;                /* size of both buffers */
+   int grow;                        /* TRUE to grow buffers on next fill */
+} stream_source_struct;
+
+
+/*
+ * Refill the buffer of a stdio source.
+ * Returns FALSE if no more data could be read.
+ */
+static int fill_stdio_buffer(DataSource src)
+{
+   stdio_source_ptr source = (stdio_source_ptr) src;
+   size_t num_read;
+
+   num_read = JFREAD(source->fptr, source->buffer, SRC_BUF_SIZE);
+
+   source->pub.next_byte = source->buffer;
+   source->pub.bytes_left = num_read;
+
+   return (num_read > 0);
+}
+
+/*
+ * Release a stdio source. This closes the underlying stream.
+ */
+static void close_stdio_source(DataSource src)
+{
+   stdio_source_ptr source = (stdio_source_ptr) src;
+
+   if (source->fptr)
+      fclose(source->fptr);
+
+   free(source);
+}
+
+/*
+ * Private function. Replaces the buffers of a stream source with ones
+ * twice the size. Returns FALSE, leaving the old buffers in place, if
+ * the memory can't be had.
+ */
+static int grow_stream_buffer(JNIEnv *env, stream_source_ptr source)
+{
+   jint new_size = source->buffer_size * 2;
+   U_CHAR *new_buffer;
+   jbyteArray local_array;
+   jbyteArray new_array;
+
+   new_buffer = (U_CHAR *) malloc(new_size);
+   if (new_buffer == NULL)
+      return JNI_FALSE;
+
+   local_array = (*env)->NewByteArray(env, new_size);
+   if (local_array == NULL) {
+      (*env)->ExceptionClear(env);
+      free(new_buffer);
+      return JNI_FALSE;
+   }
+
+   new_array = (jbyteArray) (*env)->NewGlobalRef(env, local_array);
+   (*env)->DeleteLocalRef(env, local_array);
+
+   if (new_array == NULL) {
+      free(new_buffer);
+      return JNI_FALSE;
+   }
+
+   (*env)->DeleteGlobalRef(env, source->array);
+   free(source->buffer);
+
+   source->array = new_array;
+   source->buffer = new_buffer;
+   source->buffer_size = new_size;
+
+   return JNI_TRUE;
+}
+
+/*
+ * Refill the buffer of a stream source by calling back into the java
+ * InputStream. If the stream gave us a full buffer last time it has
+ * plenty of data to hand, so the buffer is grown to need fewer calls.
+ * Returns FALSE if no more data could be read, or the read failed.
+ */
+static int fill_stream_buffer(DataSource src)
+{
+   stream_source_ptr source = (stream_source_ptr) src;
+   JNIEnv *env = src->env;
+   jthrowable exception;
+   jint num_read;
+
+   if (source->grow) {
+      source->grow = JNI_FALSE;
+      (void) grow_stream_buffer(env, source);
+   }
+
+   num_read = (*env)->CallIntMethod(env,
+                                    source->stream,
+                                    source->read_method,
+                                    source->array,
+                                    0,
+                                    source->buffer_size);
+
+   exception = (*env)->ExceptionOccurred(env);
+   if (exception != NULL) {
+      /* the decoder sees the end of the data, and the exception is */
+      /* kept to be thrown once the decoder has stopped */
+      (*env)->ExceptionClear(env);
+      source->pub.io_error = JNI_TRUE;
+      source->pub.exception =
+         (jthrowable) (*env)->NewGlobalRef(env, exception);
+      (*env)->DeleteLocalRef(env, exception);
+      return JNI_FALSE;
+   }
+
+   if (num_read <= 0)
+      return JNI_FALSE;
+
+   (*env)->GetByteArrayRegion(env, source->array, 0, num_read,
+                              (jbyte *) source->buffer);
+
+   source->pub.next_byte = source->buffer;
+   source->pub.bytes_left = num_read;
+
+   if (num_read == source->buffer_size &&
+       source->buffer_size < MAX_STREAM_BUF_SIZE)
+      source->grow = JNI_TRUE;
+
+   return JNI_TRUE;
+}
+
+/*
+ * Release a stream source. The InputStream itself is left open, as it
+ * belongs to the caller.
+ */
+static void close_stream_source(DataSource src)
+{
+   stream_source_ptr source = (stream_source_ptr) src;
+   JNIEnv *env = src->env;
+
+   if (source->array)
+      (*env)->DeleteGlobalRef(env, source->array);
+
+   if (source->stream)
+      (*env)->DeleteGlobalRef(env, source->stream);
+
+   if (source->pub.exception)
+      (*env)->DeleteGlobalRef(env, source->pub.exception);
+
+   free(source->buffer);
+   free(source);
+}
+
+/*
+ * A memory source has all its data available from the start, so there
+ * is never anything more to fill with.
+ */
+static int fill_memory_buffer(DataSource src)
+{
+   src->bytes_left = 0;
+   return JNI_FALSE;
+}
+
+/*
+ * Release a memory source. The memory itself belongs to the caller.
+ */
+static void close_memory_source(DataSource src)
+{
+   free(src);
+}
+
+/*
+ * Create a source that reads from the given stdio stream. The stream is
+ * owned by the source from here on and closed by destroy_source().
+ * Returns NULL if out of memory.
+ */
+DataSource create_stdio_source(FILE *fptr)
+{
+   stdio_source_ptr source;
+
+   source = (stdio_source_ptr) malloc(sizeof(stdio_source_struct));
+
+   if (source != NULL) {
+      source->pub.next_byte = source->buffer;
+      source->pub.bytes_left = 0;
+      source->pub.eof = JNI_FALSE;
+      source->pub.base = NULL;
+      source->pub.size = 0;
+      source->pub.fill_buffer = fill_stdio_buffer;
+      source->pub.close = close_stdio_source;
+      source->pub.env = NULL;
+      source->pub.io_error = JNI_FALSE;
+      source->pub.exception = NULL;
+
+      source->fptr = fptr;
+   }
+
+   return (DataSource) source;
+}
+
+/*
+ * Create a source that reads the given block of memory in place. The
+ * memory must stay valid until the source has been destroyed.
+ * Returns NULL if out of memory.
+ */
+DataSource create_memory_source(const U_CHAR *data, size_t size)
+{
+   DataSource source;
+
+   source = (DataSource) malloc(sizeof(struct data_source));
+
+   if (source != NULL) {
+      source->next_byte = data;
+      source->bytes_left = size;
+      source->eof = JNI_FALSE;
+      source->base = data;
+      source->size = size;
+      source->fill_buffer = fill_memory_buffer;
+      source->close = close_memory_source;
+      source->env = NULL;
+      source->io_error = JNI_FALSE;
+      source->exception = NULL;
+   }
+
+   return source;
+}
+
+/*
+ * Create a source that reads from the given java InputStream. The data
+ * is pulled from the stream on the calling thread as the decoder needs
+ * it, so the env of each native call must be stored in the source before
+ * the decoder is run. Returns NULL if out of memory, possibly with an
+ * exception pending.
+ */
+DataSource create_stream_source(JNIEnv *env, jobject stream)
+{
+   stream_source_ptr source;
+   jclass cls;
+   jbyteArray local_array;
+
+   source = (stream_source_ptr) malloc(sizeof(stream_source_struct));
+   if (source == NULL)
+      return NULL;
+
+   source->pub.next_byte = NULL;
+   source->pub.bytes_left = 0;
+   source->pub.eof = JNI_FALSE;
+   source->pub.base = NULL;
+   source->pub.size = 0;
+   source->pub.fill_buffer = fill_stream_buffer;
+   source->pub.close = close_stream_source;
+   source->pub.env = env;
+   source->pub.io_error = JNI_FALSE;
+   source->pub.exception = NULL;
+
+   source->stream = NULL;
+   source->array = NULL;
+   source->buffer_size = SRC_BUF_SIZE;
+   source->grow = JNI_FALSE;
+   source->buffer = (U_CHAR *) malloc(SRC_BUF_SIZE);
+
+   cls = (*env)->GetObjectClass(env, stream);
+   source->read_method = (*env)->GetMethodID(env, cls, "read", "([BII)I");
+   (*env)->DeleteLocalRef(env, cls);
+
+   local_array = (*env)->NewByteArray(env, SRC_BUF_SIZE);
+   if (local_array != NULL) {
+      source->array = (jbyteArray) (*env)->NewGlobalRef(env, local_array);
+      (*env)->DeleteLocalRef(env, local_array);
+   }
+
+   source->stream = (*env)->NewGlobalRef(env, stream);
+
+   if (source->buffer == NULL || source->read_method == NULL ||
+       source->array == NULL || source->stream == NULL) {
+      close_stream_source((DataSource) source);
+      return NULL;
+   }
+
+   return (DataSource) source;
+}
+
+/*
+ * Release a source and anything the backend holds on to.
+ */
+void destroy_source(DataSource src)
+{
+   if (src != NULL)
+      src->close(src);
+}
+
+/*
+ * Discard whatever is left in the buffer and ask the backend for more.
+ * Returns FALSE, and flags the source as at EOF, when there is no more.
+ */
+int src_fill(DataSource src)
+{
+   if (src->eof || !src->fill_buffer(src)) {
+      src->next_byte = NULL;
+      src->bytes_left = 0;
+      src->eof = JNI_TRUE;
+      return JNI_FALSE;
+   }
+
+   return JNI_TRUE;
+}
+
+/*
+ * Slow path of SRC_GETC. Called when the buffer is empty.
+ * Returns EOF if there is no more data.
+ */
+int src_fill_getc(DataSource src)
+{
+   if (!src_fill(src))
+      return EOF;
+
+   src->bytes_left--;
+   return UCH(*src->next_byte++);
+}
+
+/*
+ * Copy up to len bytes out of the source.
+ * Returns the number of bytes copied, which is only less than len at EOF.
+ */
+size_t src_read(DataSource src, void *buf, size_t len)
+{
+   U_CHAR *out_ptr = (U_CHAR *) buf;
+   size_t total = 0;
+   size_t count;
+
+   while (total < len) {
+      if (src->bytes_left == 0 && !src_fill(src))
+         break;
+
+      count = len - total;
+      if (count > src->bytes_left)
+         count = src->bytes_left;
+
+      memcpy(out_ptr + total, src->next_byte, count);
+      src->next_byte += count;
+      src->bytes_left -= count;
+      total += count;
+   }
+
+   return total;
+}
+
+/*
+ * Skip over len bytes of the source.
+ * Returns the number of bytes skipped, which is only less than len at EOF.
+ */
+size_t src_skip(DataSource src, size_t len)
+{
+   size_t total = 0;
+   size_t count;
+
+   while (total < len) {
+      if (src->bytes_left == 0 && !src_fill(src))
+         break;
+
+      count = len - total;
+      if (count > src->bytes_left)
+         count = src->bytes_left;
+
+      src->next_byte += count;
+      src->bytes_left -= count;
+      total += count;
+   }
+
+   return total;
+}
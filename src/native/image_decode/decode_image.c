@@ -23,16 +23,20 @@
 
 #include "decode_image.h"
 
-/* Has this library been initialised yet or not? */
-static int init = JNI_FALSE;
+/* State kept for one image decode in between function calls.  The */
+/* java side holds on to it as an opaque handle. */
+typedef struct _decode_context * DecodeContext;
 
-/* This is necessary for keeping track of the current state in between */
-/* function calls */
-static Parameters *param_list;
+typedef struct _decode_context {
+   Parameters params;                      /* decoder for the image type */
+   int fd[2];                              /* pipe, or temp file, used to */
+                                           /* transfer the data to be */
+                                           /* decoded from the java side */
+} decode_context;
 
-/* This a list of pipes that are used for transfering the data to be */
-/* decoded, from the java side to the decoding modules */
-static int **fd_list;
+/* Convert between a context and the handle the java side holds */
+#define TO_CONTEXT(handle) ((DecodeContext) (size_t) (handle))
+#define TO_HANDLE(ctx)     ((jlong) (size_t) (ctx))
 
 /*
  * Private function.  This provides a convenience function for throwing
@@ -103,93 +107,271 @@ Java_vlc_net_content_image_ImageDecoder_getFileFormats
 }
 
 /*
- * Desc:      Performs initialisation for the library.  This function is
- *            only to be called once.
+ * Private function.  Finishes with the decoder's source of encoded data
+ * and releases it, along with any java object it was reading from.  Safe
+ * to call more than once.
+ */
+static void release_source(JNIEnv *env, Parameters params)
+{
+   /* the decoder may still be reading from the source */
+   if (params->src)
+   {
+      params->src->env = env;
+      params->finish_input(params);
+   }
+
+   /* closing the source also closes the read end of any pipe */
+   destroy_source(params->src);
+   params->src = NULL;
+
+   if (params->src_elements)
+      (*env)->ReleaseByteArrayElements(env, params->src_ref,
+                                       params->src_elements, JNI_ABORT);
+   params->src_elements = NULL;
+
+   if (params->src_ref)
+      (*env)->DeleteGlobalRef(env, params->src_ref);
+   params->src_ref = NULL;
+}
+
+/*
+ * Private function.  Returns TRUE if the decode has failed.  A java stream
+ * that throws while being read only looks like the end of the data to the
+ * decoder, which may carry on with what it has, so that is counted as a
+ * failure here too.
+ */
+static int decode_failed(Parameters params)
+{
+   if (!params->error && params->src != NULL && params->src->io_error)
+   {
+      params->error = JNI_TRUE;
+      strcpy(params->error_msg, ERR_INPUT_READ);
+   }
+
+   return params->error;
+}
+
+/*
+ * Private function.  Throws the error of a failed decode.  If reading a
+ * java stream threw, its own exception is passed on as the cause of the
+ * failure rather than an InternalError.
+ */
+static void throw_decode_error(JNIEnv *env, Parameters params)
+{
+   DataSource src = params->src;
+
+   if (src != NULL && src->exception != NULL)
+   {
+      (*env)->Throw(env, src->exception);
+      (*env)->DeleteGlobalRef(env, src->exception);
+      src->exception = NULL;
+   }
+   else
+      throw_exception(env, "java/lang/InternalError", params->error_msg);
+}
+
+/*
+ * Private function.  Forgets the error of an earlier decode, so that the
+ * failure of one page of a multi-page image isn't reported again for the
+ * pages decoded after it.
+ */
+static void clear_decode_error(JNIEnv *env, Parameters params)
+{
+   DataSource src = params->src;
+
+   params->error = JNI_FALSE;
+   params->error_msg[0] = '\0';
+
+   if (src != NULL)
+   {
+      src->io_error = JNI_FALSE;
+
+      if (src->exception != NULL)
+         (*env)->DeleteGlobalRef(env, src->exception);
+      src->exception = NULL;
+   }
+}
+
+/*
+ * Private function.  Returns the decoder held by the given context, or
+ * NULL if none was set up or setting it up failed.  A source reading
+ * from a java stream calls back into java with the env of the native
+ * call it was made from, so that is stored in the source here as well.
+ */
+static Parameters get_params(JNIEnv *env, jlong context)
+{
+   Parameters params = TO_CONTEXT(context)->params;
+
+   if (params == NULL)
+      return NULL;
+
+   if (params->src)
+      params->src->env = env;
+
+   return params;
+}
+
+/*
+ * Private function.  As get_params(), but for the calls that can't go
+ * on without a decoder.  Throws an InternalError if there is none.
+ */
+static Parameters need_params(JNIEnv *env, jlong context)
+{
+   Parameters params = get_params(env, context);
+
+   if (params == NULL)
+      throw_exception(env, "java/lang/InternalError",
+                      "No image decoder has been initialised");
+
+   return params;
+}
+
+/*
+ * Desc:      Creates the native state needed to decode one image.  There
+ *            is no limit on the number of contexts in use at once.  The
+ *            context must be released with destroyContext() when the
+ *            caller is finished with it.
+ * Input:
+ *            None
+ * Output:
+ *            None
+ * Return:
+ *            Handle to the new context
+ * Exception:
+ *            java.lang.OutOfMemoryError if the context can't be allocated
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    createContext
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL
+Java_vlc_net_content_image_ImageDecoder_createContext
+(JNIEnv *env, jclass cls)
+{
+   DecodeContext ctx;
+
+   ctx = (DecodeContext) malloc(sizeof(decode_context));
+   if (ctx == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return 0;
+   }
+
+   ctx->params = NULL;
+   ctx->fd[0] = -1;
+   ctx->fd[1] = -1;
+
+   return TO_HANDLE(ctx);
+}
+
+/*
+ * Desc:      Releases a context created by createContext(), along with
+ *            anything still held by the decoder.  The handle must not be
+ *            used again after this call.
  * Input:
- *            num_threads: maximum number of threads that will access this
- *                         library at any point in time.
+ *            context:     handle returned by createContext()
  * Output:
  *            None
  * Return:
  *            None
  * Exception:
- *            java.lang.InternalError if this function is invoked more than
- *            once, or if the 'num_threads' parameter is illegal
+ *            None
  * Class:     vlc_net_content_image_ImageDecoder
- * Method:    initialize
- * Signature: (I)V
+ * Method:    destroyContext
+ * Signature: (J)V
  */
 JNIEXPORT void JNICALL
-Java_vlc_net_content_image_ImageDecoder_initialize
-(JNIEnv *env, jclass obj, jint num_threads)
+Java_vlc_net_content_image_ImageDecoder_destroyContext
+(JNIEnv *env, jclass cls, jlong context)
+{
+   DecodeContext ctx = TO_CONTEXT(context);
+
+   if (ctx == NULL)
+      return;
+
+   if (ctx->params)
+   {
+      release_source(env, ctx->params);
+      free(ctx->params);
+   }
+
+   /* close the sending end of the pipe if it was never finished with */
+   if (ctx->fd[1] != -1)
+      close(ctx->fd[1]);
+
+   free(ctx);
+}
+
+/*
+ * Private function.  Creates the decoder for the given image type and
+ * stores it in the given context.  Returns NULL, with an exception
+ * pending, if the type is unknown or memory runs out.
+ */
+static Parameters create_decoder(JNIEnv *env, DecodeContext ctx,
+                                 jstring image_type)
 {
+   int i;
+   const char *str;
    char buf[100];
-   int row, i;
-   int fail;
+   Parameters params = NULL;
 
-   /* ensure we are only called once */
-   if (init)
+   /* If this context has been used already, throw the old decoder */
+   /* away and start again. */
+   if (ctx->params)
    {
-      throw_exception(env, "java/lang/InternalError",
-                           "Initialize called more than once");
+      release_source(env, ctx->params);
+      free(ctx->params);
+      ctx->params = NULL;
    }
 
-   init = JNI_TRUE;
+   /* obtain a C representation of the java string */
+   str = (*env)->GetStringUTFChars(env, image_type, 0);
+
+   /* search for the given image type and if found, perform initialisation */
+   for(i = 0; i < NUM_KNOWN_TYPES; i++)
+   {
+      if (STRSAME(str, available_types[i].type_string))
+         break;
+   }
 
-   /* ensure that the number of threads is valid */
-   if (num_threads <= 0)
+   if (i == NUM_KNOWN_TYPES)
    {
-      sprintf(buf, "Illegal number of threads: %d", num_threads);
+      /* setup error message string */
+      sprintf(buf, "Unknown file type: '%.60s'", str);
+      (*env)->ReleaseStringUTFChars(env, image_type, str);
       throw_exception(env, "java/lang/InternalError", buf);
+      return NULL;
    }
 
-   /* Allocate memory for structures that exist for the entire life of the */
-   /* library.  This memory is never freed */
+   /* release the java string now we are finished with it */
+   (*env)->ReleaseStringUTFChars(env, image_type, str);
 
-   /* allocate memory for num_threads lots of params */
-   param_list = (Parameters *) calloc(num_threads, sizeof(Parameters));
-   if (!param_list)
+   params = available_types[i].init_func();
+   if (params == NULL)
    {
       /* No memory?, hopefully we'll never see this */
       throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return NULL;
    }
 
-   /* allocate memory for num_threads lots of pipe structures */
-   fd_list = (int **) malloc(num_threads * sizeof(int *));
+   /* no data source until the caller sets one up */
+   params->src = NULL;
+   params->src_ref = NULL;
+   params->src_elements = NULL;
 
-   /* Allocate the individual rows */
-   if (fd_list)
-   {
-      fail = JNI_FALSE;
-      row = 0;
-      while((!fail && (row < num_threads)))
-      {
-         fd_list[row] = (int *) malloc(2 * sizeof(int));
+   /* full size until the caller asks for less */
+   params->target_width = 0;
+   params->target_height = 0;
 
-         /* check to make sure memory allocation suceeded */
-         if (fd_list[row] == NULL)
-         {
-            for(i=0; i<row; i++)
-               free(fd_list[i]);
-            free(fd_list);
+   /* the first page until the caller asks for another */
+   params->page = 0;
 
-            fail = JNI_TRUE;
-         }
-         else
-            row++;
-      }
-   }
-   else
-      fail = JNI_TRUE;
+   ctx->params = params;
 
-   if (fail)
-      fd_list = NULL;
+   /* no pipe is in use until the caller creates one */
+   ctx->fd[0] = -1;
+   ctx->fd[1] = -1;
 
-   if (!fd_list)
-   {
-      /* No memory?, hopefully we'll never see this */
-      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
-   }
+   return params;
 }
 
 /*
@@ -199,7 +381,7 @@ Java_vlc_net_content_image_ImageDecoder_initialize
  *            use temporary files when decoding the image.  Using
  *            temporary files means writing to disk which is slow.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
  *            image_type:  string of the image subtype e.g. "png", "jpeg"
  *            use_temp_file:
  *                         do we create a temporary file to store image data,
@@ -214,66 +396,22 @@ Java_vlc_net_content_image_ImageDecoder_initialize
  * Class:     vlc_net_content_image_ImageDecoder
  * Desc:
  * Method:    initDecoder
- * Signature: (ILjava/lang/String;Z)V
+ * Signature: (JLjava/lang/String;Z)V
  */
 JNIEXPORT void JNICALL
 Java_vlc_net_content_image_ImageDecoder_initDecoder
-(JNIEnv *env, jobject obj, jint id, jstring image_type, jboolean use_temp_file)
+(JNIEnv *env, jobject obj, jlong context, jstring image_type, jboolean use_temp_file)
 {
-   int i = 0;
-   int init_successful = JNI_FALSE;
-   const char *str;
-   char buf[100];
    char tmpname[L_tmpnam];
    Parameters params;
+   FILE *fptr = NULL;
    int* fd;
 
-   fd = fd_list[id];
-
-   /* obtain a C representation of the java string */
-   str = (*env)->GetStringUTFChars(env, image_type, 0);
-
-   /* search for the given image type and if found, perform initialisation */
-   do
-   {
-      if (STRSAME(str, available_types[i].type_string))
-      {
-         /* If there is something at this ID spot already, throw it away
-          * and start again. */
-         if(param_list[id])
-            free(param_list[id]);
-
-         param_list[id] = available_types[i].init_func();
-         params = param_list[id];
-         if (params != NULL)
-         {
-            init_successful = JNI_TRUE;
-         }
-         else
-         {
-            /* No memory?, hopefully we'll never see this */
-            throw_exception(env, "java/lang/OutOfMemoryError", NULL);
-         }
-      }
-      else
-      {
-         i++;
-      }
-   } while(!init_successful && (i<NUM_KNOWN_TYPES));
-
-   /* ensure that the fptr is NULL */
-   params->fptr = NULL;
-
-   /* setup error message string */
-   if (!init_successful)
-      sprintf(buf, "Unknown file type: '%s'", str);
-
-   /* release the java string now we are finished with it */
-   (*env)->ReleaseStringUTFChars(env, image_type, str);
+   params = create_decoder(env, TO_CONTEXT(context), image_type);
+   if (params == NULL)
+      return;
 
-   /* throw exception */
-   if (!init_successful)
-      throw_exception(env, "java/lang/InternalError", buf);
+   fd = TO_CONTEXT(context)->fd;
 
    /* If using green threads under a *nix system, a blocking thread */
    /* will block the entire process.  For this reason we can not */
@@ -294,7 +432,7 @@ Java_vlc_net_content_image_ImageDecoder_initDecoder
       }
 
       /* now open the temporary file for writing */
-      params->fptr = fopen(tmpname, "rb");
+      fptr = fopen(tmpname, "rb");
 
       /* now unlink the file.  this will remove the file from */
       /* the directory, but will not reclaim disk space until */
@@ -309,15 +447,165 @@ Java_vlc_net_content_image_ImageDecoder_initDecoder
          /* throw exception */
          throw_exception(env, "java/lang/InternalError",
                          "Could not create pipe");
+         return;
       }
 
       /* wrap a file pointer around the pipe descriptor */
-      params->fptr = fdopen(fd[0], "rb");
+      fptr = fdopen(fd[0], "rb");
    }
 
    /* ensure it worked */
-   if (params->fptr == NULL)
+   if (fptr == NULL)
+   {
       throw_exception(env, "java/lang/InternalError", "fdopen error");
+      return;
+   }
+
+   /* the decoders read through a buffered source */
+   params->src = create_stdio_source(fptr);
+   if (params->src == NULL)
+   {
+      fclose(fptr);
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+   }
+}
+
+/*
+ * Desc:      Prepares the decoder library to decode an image that is
+ *            already held in its entirety in a direct ByteBuffer.  The
+ *            decoders read straight out of the buffer memory, so there
+ *            is no pipe and no data needs to be sent.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            image_type:  string of the image subtype e.g. "png", "jpeg"
+ *            data:        direct buffer containing the encoded image
+ *            offset:      offset of the first byte of the image in data
+ *            length:      number of bytes of encoded image
+ * Output:
+ *            None
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.InternalError if the image_type is unknown, the
+ *            buffer is not direct, or if a native error occurs.
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    initBufferDecoder
+ * Signature: (JLjava/lang/String;Ljava/nio/ByteBuffer;II)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_initBufferDecoder
+(JNIEnv *env, jobject obj, jlong context, jstring image_type, jobject data,
+ jint offset, jint length)
+{
+   Parameters params;
+   U_CHAR *ptr;
+
+   params = create_decoder(env, TO_CONTEXT(context), image_type);
+   if (params == NULL)
+      return;
+
+   ptr = (U_CHAR *) (*env)->GetDirectBufferAddress(env, data);
+   if (ptr == NULL)
+   {
+      throw_exception(env, "java/lang/InternalError",
+                      "Image data is not in a direct buffer");
+      return;
+   }
+
+   /* hang on to the buffer so it can't be collected underneath us */
+   params->src_ref = (*env)->NewGlobalRef(env, data);
+   params->src = create_memory_source(ptr + offset, (size_t) length);
+
+   if (params->src_ref == NULL || params->src == NULL)
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+}
+
+/*
+ * Desc:      Prepares the decoder library to decode an image that is
+ *            already held in its entirety in a byte array.  The array is
+ *            pinned once here, and released by finishDecoding().
+ * Input:
+ *            context:     handle returned by createContext()
+ *            image_type:  string of the image subtype e.g. "png", "jpeg"
+ *            data:        array containing the encoded image
+ *            offset:      offset of the first byte of the image in data
+ *            length:      number of bytes of encoded image
+ * Output:
+ *            None
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.InternalError if the image_type is unknown, or if
+ *            a native error occurs.
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    initArrayDecoder
+ * Signature: (JLjava/lang/String;[BII)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_initArrayDecoder
+(JNIEnv *env, jobject obj, jlong context, jstring image_type, jbyteArray data,
+ jint offset, jint length)
+{
+   Parameters params;
+
+   params = create_decoder(env, TO_CONTEXT(context), image_type);
+   if (params == NULL)
+      return;
+
+   params->src_ref = (*env)->NewGlobalRef(env, data);
+   if (params->src_ref == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return;
+   }
+
+   params->src_elements = (*env)->GetByteArrayElements(env, data, 0);
+   if (params->src_elements == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return;
+   }
+
+   params->src = create_memory_source((U_CHAR *) params->src_elements + offset,
+                                      (size_t) length);
+   if (params->src == NULL)
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+}
+
+/*
+ * Desc:      Prepares the decoder library to decode an image read from a
+ *            java InputStream.  Rather than having another thread push
+ *            the data down a pipe, the decoder calls the stream's
+ *            read() method itself from the decoding thread whenever it
+ *            needs more data.  The stream is not closed by the library.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            image_type:  string of the image subtype e.g. "png", "jpeg"
+ *            stream:      InputStream to read the encoded image from
+ * Output:
+ *            None
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.InternalError if the image_type is unknown, or if
+ *            a native error occurs.
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    initStreamDecoder
+ * Signature: (JLjava/lang/String;Ljava/io/InputStream;)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_initStreamDecoder
+(JNIEnv *env, jobject obj, jlong context, jstring image_type, jobject stream)
+{
+   Parameters params;
+
+   params = create_decoder(env, TO_CONTEXT(context), image_type);
+   if (params == NULL)
+      return;
+
+   params->src = create_stream_source(env, stream);
+   if (params->src == NULL)
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
 }
 
 /*
@@ -326,7 +614,7 @@ Java_vlc_net_content_image_ImageDecoder_initDecoder
  *            as a stream of data.  This function provides the library with
  *            that stream of data.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
  *            data:        byte array containing raw data
  *            size:        number of elements in the array.  A value of -1
  *                         signals that there is no more data to be read.
@@ -338,17 +626,17 @@ Java_vlc_net_content_image_ImageDecoder_initDecoder
  *            None
  * Class:     vlc_net_content_image_ImageDecoder
  * Method:    sendData
- * Signature: (I[BI)V
+ * Signature: (J[BI)V
  */
 JNIEXPORT void JNICALL
 Java_vlc_net_content_image_ImageDecoder_sendData
-(JNIEnv *env, jobject obj, jint id, jbyteArray data, jint size)
+(JNIEnv *env, jobject obj, jlong context, jbyteArray data, jint size)
 {
    jbyte *ptr;
    int* fd;
    int err;
 
-   fd = fd_list[id];
+   fd = TO_CONTEXT(context)->fd;
 
    if (size != -1)
    {
@@ -361,6 +649,7 @@ Java_vlc_net_content_image_ImageDecoder_sendData
          /* error occured, so close the pipe */
          if (errno != EBADF)
             close(fd[1]);
+         fd[1] = -1;
       }
 
       (*env)->ReleaseByteArrayElements(env, data, ptr, 0);
@@ -369,119 +658,314 @@ Java_vlc_net_content_image_ImageDecoder_sendData
    {
       /* at end of data, so close pipe */
       close(fd[1]);
+      fd[1] = -1;
    }
 }
 
 /*
- * Desc:      Starts the decoding process.  This will result in the header
- *            of the image being read.  It is guaranteed that after this
- *            function returns, the image width and height will be available.
+ * Desc:      Tells the decoder the smallest image size the caller needs.
+ *            Decoders that can produce a reduced image more cheaply than
+ *            the full one, such as JPEG with DCT scaling, may then return
+ *            any size down to, but not below, the target.  Others ignore
+ *            it.  The actual size is given by getImageWidth() and
+ *            getImageHeight() as usual.  Must be called before
+ *            startDecoding().
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
+ *            width:       smallest width needed, 0 for no limit
+ *            height:      smallest height needed, 0 for no limit
  * Output:
  *            None
  * Return:
  *            None
  * Exception:
- *            java.lang.InternalError on error with the image decoding,
- *            or if the library has not yet been initialised.
+ *            java.lang.InternalError if no decoder has been initialised
  * Class:     vlc_net_content_image_ImageDecoder
- * Method:    startDecoding
- * Signature: (I)V
+ * Method:    setTargetSize
+ * Signature: (JII)V
  */
 JNIEXPORT void JNICALL
-Java_vlc_net_content_image_ImageDecoder_startDecoding
-(JNIEnv *env, jobject obj, jint id)
+Java_vlc_net_content_image_ImageDecoder_setTargetSize
+(JNIEnv *env, jobject obj, jlong context, jint width, jint height)
 {
    Parameters params;
 
-   if (!init)
-   {
-      throw_exception(env, "java/lang/InternalError",
-                           "Library has not yet been initialised");
-   }
-
-   params = param_list[id];
-   params->start_input(params);
+   params = need_params(env, context);
+   if (params == NULL)
+      return;
 
-   if (params->error)
-      throw_exception(env, "java/lang/InternalError", params->error_msg);
+   params->target_width = (width > 0) ? width : 0;
+   params->target_height = (height > 0) ? height : 0;
 }
 
 /*
- * Desc:      Returns the image width.  This will return an undefined value
- *            before startDecoding() sucessfully completes.
+ * Desc:      Returns the number of pages in the image.  Formats that
+ *            can hold more than one page read in all of the encoded
+ *            data to count them, and keep it until finishDecoding() so
+ *            any page can then be decoded without reading it again.
+ *            Every other format has the one page.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
  * Output:
  *            None
  * Return:
- *            The width of the image
+ *            The number of pages, at least 1
  * Exception:
- *            None
+ *            java.lang.InternalError on error reading the image
+ *            java.lang.InternalError if no decoder has been initialised
  * Class:     vlc_net_content_image_ImageDecoder
- * Method:    getImageWidth
- * Signature: (I)I
+ * Method:    getPageCount
+ * Signature: (J)I
  */
 JNIEXPORT jint JNICALL
-Java_vlc_net_content_image_ImageDecoder_getImageWidth
-(JNIEnv *env, jobject obj, jint id)
+Java_vlc_net_content_image_ImageDecoder_getPageCount
+(JNIEnv *env, jobject obj, jlong context)
 {
    Parameters params;
+   int count;
 
-   params = param_list[id];
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
 
-   return (jint) params->width;
+   if (params->count_pages == NULL)
+      return 1;
+
+   count = params->count_pages(params);
+
+   if (decode_failed(params))
+   {
+      throw_decode_error(env, params);
+      return 0;
+   }
+
+   return count;
 }
 
 /*
- * Desc:      Returns the image height.  This will return an undefined value
- *            before startDecoding() sucessfully completes.
+ * Desc:      Selects the page that the next startDecoding() or
+ *            probeImage() works on.  For formats that can hold more than
+ *            one page, startDecoding() may be called again once a page
+ *            has been read to go on and decode another one.  Any error
+ *            left from decoding an earlier page is cleared.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
+ *            page:        index of the page, from 0
  * Output:
  *            None
  * Return:
- *            The height of the image
- * Exception:
  *            None
+ * Exception:
+ *            java.lang.IndexOutOfBoundsException if there is no such page
+ *            java.lang.InternalError on error reading the image
+ *            java.lang.InternalError if no decoder has been initialised
  * Class:     vlc_net_content_image_ImageDecoder
- * Method:    getImageHeight
- * Signature: (I)I
+ * Method:    setPage
+ * Signature: (JI)V
  */
-JNIEXPORT jint JNICALL
-Java_vlc_net_content_image_ImageDecoder_getImageHeight
-(JNIEnv *env, jobject obj, jint id)
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_setPage
+(JNIEnv *env, jobject obj, jlong context, jint page)
 {
    Parameters params;
+   int count = 1;
 
-   params = param_list[id];
+   params = need_params(env, context);
+   if (params == NULL)
+      return;
 
-   return (jint) params->height;
+   /* a new page starts without the errors of the last one */
+   clear_decode_error(env, params);
+
+   if (params->count_pages != NULL && page > 0)
+   {
+      count = params->count_pages(params);
+
+      if (decode_failed(params))
+      {
+         throw_decode_error(env, params);
+         return;
+      }
+   }
+
+   if (page < 0 || page >= count)
+   {
+      throw_exception(env, "java/lang/IndexOutOfBoundsException",
+                      "No such page in the image");
+      return;
+   }
+
+   params->page = page;
 }
 
 /*
- * Desc:      Returns the number of color components of the image. This will return an
- *            undefined value before startDecoding() sucessfully completes.
- * Input:
- *            id:          thread id (offset into arrays at top of this file)
- * Output:
+ * Desc:      Starts the decoding process.  This will result in the header
+ *            of the image being read.  It is guaranteed that after this
+ *            function returns, the image width and height will be available.
+ * Input:
+ *            context:     handle returned by createContext()
+ * Output:
+ *            None
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.InternalError on error with the image decoding,
+ *            or if no decoder has been initialised.
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    startDecoding
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_startDecoding
+(JNIEnv *env, jobject obj, jlong context)
+{
+   Parameters params;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return;
+
+   /* a multi-page decoder may be started again for another page */
+   params->row_num = 0;
+   params->start_input(params);
+
+   if (decode_failed(params))
+      throw_decode_error(env, params);
+}
+
+/*
+ * Desc:      Reads just the header of the image, without decoding any
+ *            pixels or allocating space for them.  Only as much of the
+ *            encoded data as the header takes up is read, so the image
+ *            can not be decoded with this context until it has been
+ *            initialised again.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            info:        array of at least 5 elements
+ * Output:
+ *            info[0]:     image width
+ *            info[1]:     image height
+ *            info[2]:     number of colour components a decode returns
+ *            info[3]:     bits per sample, or per index if colour mapped
+ *            info[4]:     1 if the image is interlaced or progressive,
+ *                         0 otherwise
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.InternalError on error reading the header
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    probeImage
+ * Signature: (J[I)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_probeImage
+(JNIEnv *env, jobject obj, jlong context, jintArray info)
+{
+   Parameters params;
+   jint values[5];
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return;
+
+   params->read_header(params);
+
+   if (decode_failed(params))
+   {
+      throw_decode_error(env, params);
+      return;
+   }
+
+   values[0] = params->width;
+   values[1] = params->height;
+   values[2] = params->numComponents;
+   values[3] = params->bitDepth;
+   values[4] = params->interlaced ? 1 : 0;
+
+   (*env)->SetIntArrayRegion(env, info, 0, 5, values);
+}
+
+/*
+ * Desc:      Returns the image width.  This will return an undefined value
+ *            before startDecoding() sucessfully completes.
+ * Input:
+ *            context:     handle returned by createContext()
+ * Output:
  *            None
  * Return:
  *            The width of the image
  * Exception:
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    getImageWidth
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL
+Java_vlc_net_content_image_ImageDecoder_getImageWidth
+(JNIEnv *env, jobject obj, jlong context)
+{
+   Parameters params;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
+
+   return (jint) params->width;
+}
+
+/*
+ * Desc:      Returns the image height.  This will return an undefined value
+ *            before startDecoding() sucessfully completes.
+ * Input:
+ *            context:     handle returned by createContext()
+ * Output:
+ *            None
+ * Return:
+ *            The height of the image
+ * Exception:
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    getImageHeight
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL
+Java_vlc_net_content_image_ImageDecoder_getImageHeight
+(JNIEnv *env, jobject obj, jlong context)
+{
+   Parameters params;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
+
+   return (jint) params->height;
+}
+
+/*
+ * Desc:      Returns the number of color components of the image. This will return an
+ *            undefined value before startDecoding() sucessfully completes.
+ * Input:
+ *            context:     handle returned by createContext()
+ * Output:
  *            None
+ * Return:
+ *            The width of the image
+ * Exception:
+ *            java.lang.InternalError if no decoder has been initialised
  * Class:     vlc_net_content_image_ImageDecoder
  * Method:    getImageWidth
- * Signature: (I)I
+ * Signature: (J)I
  */
 JNIEXPORT jint JNICALL
 Java_vlc_net_content_image_ImageDecoder_getNumColorComponents
-(JNIEnv *env, jobject obj, jint id)
+(JNIEnv *env, jobject obj, jlong context)
 {
    Parameters params;
 
-   params = param_list[id];
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
 
    return (jint) params->numComponents;
 }
@@ -490,7 +974,7 @@ Java_vlc_net_content_image_ImageDecoder_getNumColorComponents
  * Desc:      Returns the next row of the image.  This function will keep
  *            track of which is the current row to return.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
  * Output:
  *            pixel_row:   array which will contain a rows worth of pixel
  *                         data.
@@ -498,18 +982,21 @@ Java_vlc_net_content_image_ImageDecoder_getNumColorComponents
  *            None
  * Exception:
  *            java.lang.InternalError on error with the image decoding
+ *            java.lang.InternalError if no decoder has been initialised
  * Class:     vlc_net_content_image_ImageDecoder
  * Method:    getNextImageRow
- * Signature: (I[I)V
+ * Signature: (J[I)V
  */
 JNIEXPORT void JNICALL
 Java_vlc_net_content_image_ImageDecoder_getNextImageRow
-(JNIEnv *env, jobject obj, jint id, jintArray pixel_row)
+(JNIEnv *env, jobject obj, jlong context, jintArray pixel_row)
 {
    jint *ptr;
    Parameters params;
 
-   params = param_list[id];
+   params = need_params(env, context);
+   if (params == NULL)
+      return;
 
    ptr = (*env)->GetIntArrayElements(env, pixel_row, 0);
 
@@ -522,8 +1009,569 @@ Java_vlc_net_content_image_ImageDecoder_getNextImageRow
 
    params->buffer = NULL;
 
-   if (params->error)
-      throw_exception(env, "java/lang/InternalError", params->error_msg);
+   if (decode_failed(params))
+      throw_decode_error(env, params);
+}
+
+/*
+ * Private function.  Checks that num_rows rows of row_len elements,
+ * starting at offset and separated by stride elements, fit inside an
+ * array of the given length.  The stride may be negative, to fill the
+ * array from the bottom up.  Throws an exception and returns FALSE if
+ * they don't.
+ */
+static int check_row_region(JNIEnv *env, jsize length, jint offset,
+                            jint stride, jint num_rows, jint row_len)
+{
+   jlong first;
+   jlong last;
+
+   if (num_rows <= 0)
+      return JNI_TRUE;
+
+   /* offset of the lowest and highest row in the array */
+   first = (jlong) offset;
+   last = (jlong) offset + (jlong) (num_rows - 1) * (jlong) stride;
+
+   if (last < first)
+   {
+      jlong tmp = first;
+      first = last;
+      last = tmp;
+   }
+
+   if (first < 0 || last + row_len > (jlong) length ||
+       (num_rows > 1 && stride > -row_len && stride < row_len))
+   {
+      throw_exception(env, "java/lang/ArrayIndexOutOfBoundsException",
+                      "Rows do not fit in the given array");
+      return JNI_FALSE;
+   }
+
+   return JNI_TRUE;
+}
+
+/*
+ * Private function.  Returns how many of the requested rows are still
+ * left to decode in the image.
+ */
+static jint rows_left(Parameters params, jint num_rows)
+{
+   jint remaining = params->height - params->row_num;
+
+   return (num_rows < remaining) ? num_rows : remaining;
+}
+
+/*
+ * Private function.  Decodes num_rows rows straight into dest, each
+ * stride pixels after the last.  Stops early on error.
+ */
+static void decode_int_rows(Parameters params, jint *dest, jint stride,
+                            jint num_rows)
+{
+   jint i;
+
+   for(i = 0; i < num_rows && !decode_failed(params); i++)
+   {
+      params->buffer = dest;
+      params->get_pixel_row(params);
+      params->row_num++;
+
+      dest += stride;
+   }
+
+   params->buffer = NULL;
+}
+
+/*
+ * Private function.  Splits a row of ARGB pixels into packed bytes, one
+ * per color component.  The components are written in the order
+ * R,G,B,A for color images, and gray then alpha for gray images.
+ */
+static void pack_row(const jint *src, U_CHAR *dest, int width,
+                     int num_components)
+{
+   int x;
+   jint pixel;
+
+   switch(num_components)
+   {
+      case 4:
+         for(x = 0; x < width; x++)
+         {
+            pixel = src[x];
+            *dest++ = (U_CHAR) (pixel >> 16);
+            *dest++ = (U_CHAR) (pixel >> 8);
+            *dest++ = (U_CHAR) pixel;
+            *dest++ = (U_CHAR) (pixel >> 24);
+         }
+         break;
+
+      case 3:
+         for(x = 0; x < width; x++)
+         {
+            pixel = src[x];
+            *dest++ = (U_CHAR) (pixel >> 16);
+            *dest++ = (U_CHAR) (pixel >> 8);
+            *dest++ = (U_CHAR) pixel;
+         }
+         break;
+
+      case 2:
+         for(x = 0; x < width; x++)
+         {
+            pixel = src[x];
+            *dest++ = (U_CHAR) pixel;
+            *dest++ = (U_CHAR) (pixel >> 8);
+         }
+         break;
+
+      case 1:
+         for(x = 0; x < width; x++)
+            *dest++ = (U_CHAR) src[x];
+         break;
+   }
+}
+
+/*
+ * Private function.  Decodes num_rows rows as packed bytes into dest,
+ * each stride bytes after the last.  Stops early on error.  Decoders
+ * that can produce packed bytes themselves write straight into dest,
+ * all the rows at once if they can, otherwise each row is decoded as
+ * ARGB and then packed.
+ */
+static void decode_byte_rows(Parameters params, U_CHAR *dest, jint stride,
+                             jint num_rows)
+{
+   jint i;
+   jint *row;
+
+   if (params->get_byte_rows != NULL)
+   {
+      params->get_byte_rows(params, dest, stride, num_rows);
+      params->row_num += num_rows;
+
+      return;
+   }
+
+   if (params->get_byte_row != NULL)
+   {
+      for(i = 0; i < num_rows && !decode_failed(params); i++)
+      {
+         params->get_byte_row(params, dest);
+         params->row_num++;
+
+         dest += stride;
+      }
+
+      return;
+   }
+
+   row = (jint *) malloc(params->width * sizeof(jint));
+   if (row == NULL)
+   {
+      params->error = JNI_TRUE;
+      strcpy(params->error_msg, ERR_OUT_OF_MEMORY);
+      return;
+   }
+
+   for(i = 0; i < num_rows && !decode_failed(params); i++)
+   {
+      params->buffer = row;
+      params->get_pixel_row(params);
+      params->row_num++;
+
+      pack_row(row, dest, params->width, params->numComponents);
+      dest += stride;
+   }
+
+   params->buffer = NULL;
+   free(row);
+}
+
+/*
+ * Desc:      Decodes the next rows of the image straight into the given
+ *            array, one pixel per element in the same form as
+ *            getNextImageRow().  The rows are placed stride elements apart
+ *            starting at offset, so a whole image can be decoded in one
+ *            call.  A negative stride fills the array bottom up.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            offset:      index of the first pixel of the first row
+ *            stride:      number of elements between the start of rows
+ *            num_rows:    number of rows wanted
+ * Output:
+ *            pixels:      array to receive the pixel data.
+ * Return:
+ *            The number of rows decoded.  This is less than num_rows if
+ *            the end of the image is reached.
+ * Exception:
+ *            java.lang.InternalError on error with the image decoding
+ *            java.lang.ArrayIndexOutOfBoundsException if the rows do not
+ *            fit in the array
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    getImageRows
+ * Signature: (J[IIII)I
+ */
+JNIEXPORT jint JNICALL
+Java_vlc_net_content_image_ImageDecoder_getImageRows
+(JNIEnv *env, jobject obj, jlong context, jintArray pixels, jint offset,
+ jint stride, jint num_rows)
+{
+   jint *ptr;
+   Parameters params;
+   int critical;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
+
+   num_rows = rows_left(params, num_rows);
+   if (num_rows <= 0)
+      return 0;
+
+   if (!check_row_region(env, (*env)->GetArrayLength(env, pixels), offset,
+                         stride, num_rows, params->width))
+      return 0;
+
+   /* While a critical section is held the garbage collector may be */
+   /* stalled, which would deadlock against the thread filling a pipe, */
+   /* and no calls may be made back into java to read a stream.  So */
+   /* only decode in place when the whole image is in memory. */
+   critical = (params->src->base != NULL);
+
+   if (critical)
+      ptr = (jint *) (*env)->GetPrimitiveArrayCritical(env, pixels, 0);
+   else
+      ptr = (*env)->GetIntArrayElements(env, pixels, 0);
+
+   if (ptr == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return 0;
+   }
+
+   decode_int_rows(params, ptr + offset, stride, num_rows);
+
+   if (critical)
+      (*env)->ReleasePrimitiveArrayCritical(env, pixels, ptr, 0);
+   else
+      (*env)->ReleaseIntArrayElements(env, pixels, ptr, 0);
+
+   if (decode_failed(params))
+      throw_decode_error(env, params);
+
+   return num_rows;
+}
+
+/*
+ * Desc:      Decodes the next rows of the image straight into the given
+ *            array as packed bytes, one byte per color component.  Color
+ *            images are written R,G,B(,A) and gray images gray(,alpha).
+ *            The rows are placed stride bytes apart starting at offset.
+ *            A negative stride fills the array bottom up.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            offset:      index of the first byte of the first row
+ *            stride:      number of bytes between the start of rows
+ *            num_rows:    number of rows wanted
+ * Output:
+ *            pixels:      array to receive the pixel data.
+ * Return:
+ *            The number of rows decoded.  This is less than num_rows if
+ *            the end of the image is reached.
+ * Exception:
+ *            java.lang.InternalError on error with the image decoding
+ *            java.lang.ArrayIndexOutOfBoundsException if the rows do not
+ *            fit in the array
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    getImageRowBytes
+ * Signature: (J[BIII)I
+ */
+JNIEXPORT jint JNICALL
+Java_vlc_net_content_image_ImageDecoder_getImageRowBytes
+(JNIEnv *env, jobject obj, jlong context, jbyteArray pixels, jint offset,
+ jint stride, jint num_rows)
+{
+   jbyte *ptr;
+   Parameters params;
+   int critical;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
+
+   num_rows = rows_left(params, num_rows);
+   if (num_rows <= 0)
+      return 0;
+
+   if (!check_row_region(env, (*env)->GetArrayLength(env, pixels), offset,
+                         stride, num_rows,
+                         params->width * params->numComponents))
+      return 0;
+
+   /* see getImageRows() for why this isn't always critical */
+   critical = (params->src->base != NULL);
+
+   if (critical)
+      ptr = (jbyte *) (*env)->GetPrimitiveArrayCritical(env, pixels, 0);
+   else
+      ptr = (*env)->GetByteArrayElements(env, pixels, 0);
+
+   if (ptr == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return 0;
+   }
+
+   decode_byte_rows(params, (U_CHAR *) ptr + offset, stride, num_rows);
+
+   if (critical)
+      (*env)->ReleasePrimitiveArrayCritical(env, pixels, ptr, 0);
+   else
+      (*env)->ReleaseByteArrayElements(env, pixels, ptr, 0);
+
+   if (decode_failed(params))
+      throw_decode_error(env, params);
+
+   return num_rows;
+}
+
+/*
+ * Desc:      Decodes the next rows of the image straight into the given
+ *            direct buffer as packed bytes, in the same form as
+ *            getImageRowBytes().  The buffer position and limit are
+ *            ignored; offset is from the start of the buffer.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            offset:      index of the first byte of the first row
+ *            stride:      number of bytes between the start of rows
+ *            num_rows:    number of rows wanted
+ * Output:
+ *            pixels:      direct buffer to receive the pixel data.
+ * Return:
+ *            The number of rows decoded.  This is less than num_rows if
+ *            the end of the image is reached.
+ * Exception:
+ *            java.lang.InternalError on error with the image decoding, or
+ *            if the buffer is not direct
+ *            java.lang.ArrayIndexOutOfBoundsException if the rows do not
+ *            fit in the buffer
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    getImageRowBuffer
+ * Signature: (JLjava/nio/ByteBuffer;III)I
+ */
+JNIEXPORT jint JNICALL
+Java_vlc_net_content_image_ImageDecoder_getImageRowBuffer
+(JNIEnv *env, jobject obj, jlong context, jobject pixels, jint offset,
+ jint stride, jint num_rows)
+{
+   U_CHAR *ptr;
+   jlong capacity;
+   Parameters params;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return 0;
+
+   num_rows = rows_left(params, num_rows);
+   if (num_rows <= 0)
+      return 0;
+
+   ptr = (U_CHAR *) (*env)->GetDirectBufferAddress(env, pixels);
+   capacity = (*env)->GetDirectBufferCapacity(env, pixels);
+
+   if (ptr == NULL || capacity < 0)
+   {
+      throw_exception(env, "java/lang/InternalError",
+                      "Pixel buffer is not a direct buffer");
+      return 0;
+   }
+
+   if (capacity > 0x7FFFFFFF)
+      capacity = 0x7FFFFFFF;
+
+   if (!check_row_region(env, (jsize) capacity, offset, stride, num_rows,
+                         params->width * params->numComponents))
+      return 0;
+
+   decode_byte_rows(params, ptr + offset, stride, num_rows);
+
+   if (decode_failed(params))
+      throw_decode_error(env, params);
+
+   return num_rows;
+}
+
+/* Decoded rows being fed to a scale filter */
+typedef struct _scale_source {
+   Parameters params;                      /* the decoder */
+   U_CHAR *row;                            /* the last row decoded */
+} scale_source;
+
+/*
+ * Private function.  Hands the scale filter source row y, decoding up to
+ * it first.  The filter asks for rows in order, so only the last one is
+ * kept.  Returns NULL on error.
+ */
+static const jbyte *next_scale_row(void *data, int y)
+{
+   scale_source *source = (scale_source *) data;
+   Parameters params = source->params;
+
+   while (params->row_num <= y)
+   {
+      decode_byte_rows(params, source->row, 0, 1);
+
+      if (decode_failed(params))
+         return NULL;
+   }
+
+   return (const jbyte *) source->row;
+}
+
+/*
+ * Desc:      Decodes the whole image and scales it to the given size as it
+ *            goes, into the given direct buffer as packed bytes in the
+ *            same form as getImageRowBuffer().  The decoded rows are fed
+ *            straight into the scale filter, so the full size image is
+ *            never held in memory.  Must be called before any rows have
+ *            been read.
+ * Input:
+ *            context:     handle returned by createContext()
+ *            filter_type: scale filter type, one of those returned by
+ *                         ImageScaleFilterDriver.getScaleFilterTypes()
+ *            width:       width to scale the image to
+ *            height:      height to scale the image to
+ *            flip:        TRUE to store the last row first
+ * Output:
+ *            pixels:      direct buffer to receive the scaled pixels,
+ *                         from the start of the buffer
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.InternalError on error with the image decoding, if
+ *            the buffer is not direct, the filter type is unknown or rows
+ *            have already been read
+ *            java.lang.IllegalArgumentException if the size is not positive
+ *            java.lang.ArrayIndexOutOfBoundsException if the scaled image
+ *            does not fit in the buffer
+ *            java.lang.OutOfMemoryError if there is not enough memory
+ *            java.lang.InternalError if no decoder has been initialised
+ * Class:     vlc_net_content_image_ImageDecoder
+ * Method:    getScaledImageBuffer
+ * Signature: (JLjava/lang/String;Ljava/nio/ByteBuffer;IIZ)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_net_content_image_ImageDecoder_getScaledImageBuffer
+(JNIEnv *env, jobject obj, jlong context, jstring filter_type,
+ jobject pixels, jint width, jint height, jboolean flip)
+{
+   U_CHAR *ptr;
+   U_CHAR *tmp;
+   jlong capacity;
+   jint row_size;
+   jint i;
+   const char *type;
+   int done;
+   scale_source source;
+   Parameters params;
+
+   params = need_params(env, context);
+   if (params == NULL)
+      return;
+
+   if (params->row_num != 0)
+   {
+      throw_exception(env, "java/lang/InternalError",
+                      "Rows have already been read from the image");
+      return;
+   }
+
+   if (width <= 0 || height <= 0)
+   {
+      throw_exception(env, "java/lang/IllegalArgumentException",
+                      "Scaled size must be positive");
+      return;
+   }
+
+   ptr = (U_CHAR *) (*env)->GetDirectBufferAddress(env, pixels);
+   capacity = (*env)->GetDirectBufferCapacity(env, pixels);
+
+   if (ptr == NULL || capacity < 0)
+   {
+      throw_exception(env, "java/lang/InternalError",
+                      "Pixel buffer is not a direct buffer");
+      return;
+   }
+
+   if ((jlong) width * height * params->numComponents > capacity)
+   {
+      throw_exception(env, "java/lang/ArrayIndexOutOfBoundsException",
+                      "Rows do not fit in the given buffer");
+      return;
+   }
+
+   source.params = params;
+   source.row = (U_CHAR *) malloc(params->width * params->numComponents);
+   if (source.row == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return;
+   }
+
+   type = (*env)->GetStringUTFChars(env, filter_type, 0);
+
+   done = scale_rows(type, params->width, params->height,
+                     params->numComponents, next_scale_row, &source,
+                     width, height, (jbyte *) ptr);
+
+   (*env)->ReleaseStringUTFChars(env, filter_type, type);
+
+   free(source.row);
+
+   if (done < 0)
+   {
+      throw_exception(env, "java/lang/InternalError", "Unknown filter type");
+      return;
+   }
+
+   if (done == 0)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return;
+   }
+
+   if (decode_failed(params))
+   {
+      throw_decode_error(env, params);
+      return;
+   }
+
+   if (!flip)
+      return;
+
+   /* swap the rows end for end, through one spare row */
+   row_size = width * params->numComponents;
+   tmp = (U_CHAR *) malloc(row_size);
+   if (tmp == NULL)
+   {
+      throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+      return;
+   }
+
+   for(i = 0; i < height / 2; i++)
+   {
+      memcpy(tmp, ptr + (size_t) i * row_size, row_size);
+      memcpy(ptr + (size_t) i * row_size,
+             ptr + (size_t) (height - 1 - i) * row_size, row_size);
+      memcpy(ptr + (size_t) (height - 1 - i) * row_size, tmp, row_size);
+   }
+
+   free(tmp);
 }
 
 /*
@@ -531,7 +1579,7 @@ Java_vlc_net_content_image_ImageDecoder_getNextImageRow
  *            releasing resources.  This MUST always be called after an
  *            image has been decoded.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
  * Output:
  *            None
  * Return:
@@ -540,23 +1588,16 @@ Java_vlc_net_content_image_ImageDecoder_getNextImageRow
  *            None
  * Class:     vlc_net_content_image_ImageDecoder
  * Method:    finishDecoding
- * Signature: (I)V
+ * Signature: (J)V
  */
 JNIEXPORT void JNICALL
 Java_vlc_net_content_image_ImageDecoder_finishDecoding
-(JNIEnv *env, jobject obj, jint id)
+(JNIEnv *env, jobject obj, jlong context)
 {
    Parameters params;
-   int* fd;
-
-   fd = fd_list[id];
-   close(fd[0]);
 
-   params = param_list[id];
+   params = get_params(env, context);
 
-   if (params) {
-      if (params->fptr)
-         fclose(params->fptr);
-      params->finish_input(params);
-   }
+   if (params)
+      release_source(env, params);
 }
@@ -86,12 +86,13 @@ static KnownImageType available_types[] = {
 
 #include <jni.h>
 #include "vlc_net_content_image_ImageDecoder.h"
+#include "threads.h"
 
 /* Convenience macros */
 #define STRSAME(x,y)     (strcmp((x),(y)) == 0)
 #define JFREAD(file,buf,sizeofbuf)  \
   ((size_t) fread((void *) (buf), (size_t) 1, (size_t) (sizeofbuf), (file)))
-#define ReadOK(file,buffer,len)(JFREAD(file,buffer,len) == ((size_t) (len)))
+#define ReadOK(src,buffer,len)(src_read(src,buffer,len) == ((size_t) (len)))
 
 #define ERROR_LEN 200
 
@@ -99,27 +100,83 @@ static KnownImageType available_types[] = {
 typedef unsigned char U_CHAR;
 #define UCH(x)((int) (x))
 
+/* Size of the buffer used when reading data from a stream */
+#define SRC_BUF_SIZE 8192
+
+/* Largest buffer a java stream source will grow to */
+#define MAX_STREAM_BUF_SIZE 262144
+
+/* Buffered source of the encoded image data.  The decoders only ever */
+/* read their input through one of these.  The layout follows the     */
+/* libjpeg source manager so the unread bytes can be handed straight  */
+/* to a third party library.                                          */
+typedef struct data_source* DataSource;
+
+struct data_source {
+   const U_CHAR *next_byte;                /* next unread byte in buffer */
+   size_t bytes_left;                      /* unread bytes in buffer */
+   int eof;                                /* TRUE once the data runs out */
+   const U_CHAR *base;                     /* entire data if held in */
+                                           /* memory, NULL otherwise */
+   size_t size;                            /* number of bytes at base */
+   int (*fill_buffer)(DataSource);         /* refill, FALSE at EOF */
+   void (*close)(DataSource);              /* release the source */
+   JNIEnv *env;                            /* env of the current native */
+                                           /* call, for sources that call */
+                                           /* back into java */
+   int io_error;                           /* TRUE if reading failed */
+   jthrowable exception;                   /* global ref to what a java */
+                                           /* stream threw, to be thrown */
+                                           /* once the decoder stops */
+};
+
+/* Fetch the next byte from a source, or EOF */
+#define SRC_GETC(src) ((src)->bytes_left > 0 ? \
+   ((src)->bytes_left--, UCH(*(src)->next_byte++)) : src_fill_getc(src))
+
 
 /* This structure is used to pass data between the general image decoding */
 /* routines, and the specifc image decoding routines */
 struct param {
-   FILE *fptr;                             /* file ptr to encoded data */
+   DataSource src;                         /* source of encoded data */
+   jobject src_ref;                        /* java object holding the */
+                                           /* encoded data, or NULL */
+   jbyte *src_elements;                    /* pinned elements of src_ref */
    int width;                              /* width of the image */
    int height;                             /* height of the image */
    int numComponents;                      /* num color components 1 - 4 */
+   int bitDepth;                           /* bits per sample, or per */
+                                           /* index if colour mapped */
+   int interlaced;                         /* TRUE if interlaced or */
+                                           /* progressive */
+   int target_width;                       /* smallest size wanted, the */
+   int target_height;                      /* decoder may reduce the */
+                                           /* image down to, 0 for full */
    jint *buffer;                           /* one rows worth of pixels */
    int row_num;                            /* current row number */
+   int page;                               /* page to decode, from 0 */
    int error;                              /* TRUE on error, FALSE otherwise */
    char error_msg[ERROR_LEN];              /* error message set on error */
+   void (*read_header)(Parameters);        /* read the header only */
    void (*start_input)(Parameters);        /* start function */
    void (*get_pixel_row)(Parameters);      /* get pixel function */
+   void (*get_byte_row)(Parameters, U_CHAR *);
+                                           /* get packed bytes function, */
+                                           /* NULL if not supported */
+   void (*get_byte_rows)(Parameters, U_CHAR *, jint, jint);
+                                           /* get several rows of packed */
+                                           /* bytes stride apart in one */
+                                           /* go, NULL if not supported */
    void (*finish_input)(Parameters);       /* end function */
+   int (*count_pages)(Parameters);         /* count the pages, NULL if */
+                                           /* the format has just one */
 };
 
 /* Error Strings */
 
 #define ERR_OUT_OF_MEMORY "Insufficient memory"
 #define ERR_INPUT_EOF "Premature end of input file"
+#define ERR_INPUT_READ "Error reading the input stream"
 
 /* from common.c */
 extern U_CHAR **alloc2DByteArray(int rows, int cols);
@@ -127,6 +184,24 @@ extern void free2DByteArray(U_CHAR **arr);
 extern jint **alloc2DJIntArray(int rows, int cols);
 extern void free2DJIntArray(jint **arr);
 
+/* from data_source.c */
+extern DataSource create_stdio_source(FILE *fptr);
+extern DataSource create_memory_source(const U_CHAR *data, size_t size);
+extern DataSource create_stream_source(JNIEnv *env, jobject stream);
+extern void destroy_source(DataSource src);
+extern int src_fill(DataSource src);
+extern int src_fill_getc(DataSource src);
+extern size_t src_read(DataSource src, void *buf, size_t len);
+extern size_t src_skip(DataSource src, size_t len);
+
+/* from image_scale_filter.c, 1 when done, 0 if out of memory or -1 */
+/* if the filter type is unknown */
+extern int scale_rows(const char *filter_type, int srcWidth,
+                      int srcHeight, int srcCmp,
+                      const jbyte *(*get_row)(void *, int),
+                      void *data, int dstWidth, int dstHeight,
+                      jbyte *dst);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,12 +1,28 @@
 
 #include "image_scale_filter.h"
 
-/* Flag indicating whether this library been initialized */
-static int init = JNI_FALSE;
+/* State kept for one scale operation in between function calls. The */
+/* java side holds on to it as an opaque handle. */
+typedef struct _scale_context * ScaleContext;
 
-/* This is necessary for keeping track of the current state in between */
-/* function calls */
-static FilterParam *param_list;
+typedef struct _scale_context {
+	FilterParam params;                     /* the filter to scale with */
+	int num_threads;                        /* most threads to scale with, 0 for one per processor */
+} scale_context;
+
+/* One scale operation split into bands of destination rows */
+typedef struct _scale_job {
+	FilterParam params;                     /* the filter, shared by every band */
+	int num_bands;                          /* number of bands the rows are split into */
+	int *done;                              /* for each band, 0 if out of memory */
+} scale_job;
+
+/* Fewest source and destination pixels worth starting a thread for */
+#define MIN_BAND_PIXELS 262144
+
+/* Convert between a context and the handle the java side holds */
+#define TO_CONTEXT(handle) ((ScaleContext) (size_t) (handle))
+#define TO_HANDLE(ctx)     ((jlong) (size_t) (ctx))
 
 /*
  * Private function.  This provides a convenience function for throwing
@@ -35,6 +51,80 @@ static void throw_exception(JNIEnv *env, char *exception, char *message)
 	(*env)->ThrowNew(env, newExcCls, message);
 }
 
+/*
+ * Private function. Work out the first destination row of a band, sharing
+ * the rows out as evenly as possible. The band after the last starts at
+ * the destination height.
+ */
+static int band_start(const scale_job *job, int part)
+{
+	return (int) ((jlong) job->params->dstHeight * part / job->num_bands);
+}
+
+/*
+ * Private function. Scale the destination rows of one band, run by
+ * run_parallel() for each part of a scale_job.
+ */
+static void scale_band(void *data, int part)
+{
+	scale_job *job = (scale_job *) data;
+	int first_row = band_start(job, part);
+	
+	job->done[part] = job->params->scale_func(job->params, first_row,
+	band_start(job, part + 1) - first_row);
+}
+
+/*
+ * Scale an image whose source rows are fetched one at a time, in order,
+ * by get_row, rather than held in memory. This lets a decoder feed its
+ * rows straight into the filter, so only the few rows the filter needs
+ * at once are ever held. Scaled rows are written one after the other to
+ * dst. The scale is done on the calling thread, since the rows must come
+ * in order. get_row returns NULL to stop the scale early.
+ *
+ * Returns 1 when done, 0 if out of memory, or -1 if the filter type is
+ * unknown.
+ */
+int scale_rows(const char *filter_type, int srcWidth, int srcHeight,
+	int srcCmp, const jbyte *(*get_row)(void *, int), void *data,
+	int dstWidth, int dstHeight, jbyte *dst)
+{
+	FilterParam params;
+	int done;
+	int i;
+	
+	for (i = 0; i < NUM_SCALE_FILTERS; i++) {
+		if (strcmp(filter_type, available_scale_filter[i].type_string) == 0) {
+			break;
+		}
+	}
+	if (i == NUM_SCALE_FILTERS) {
+		return( -1 );
+	}
+	
+	params = available_scale_filter[i].init_func( );
+	if (params == NULL) {
+		return( 0 );
+	}
+	
+	params->srcWidth = srcWidth;
+	params->srcHeight = srcHeight;
+	params->srcComponents = srcCmp;
+	params->get_src_row = get_row;
+	params->src_row_data = data;
+	
+	params->dstWidth = dstWidth;
+	params->dstHeight = dstHeight;
+	params->dstComponents = srcCmp;
+	params->dst_pixel_data = dst;
+	
+	done = params->scale_func(params, 0, dstHeight);
+	
+	free(params);
+	
+	return( done );
+}
+
 /*
  * Desc:      Returns an array of strings containing the supported filter types
  * Input:
@@ -73,52 +163,64 @@ Java_vlc_image_ImageScaleFilterDriver_getScaleFilterTypes
 }
 
 /*
- * Desc:      Performs initialisation for the library.  This function is
- *            only to be called once.
+ * Desc:      Creates the native state needed for one scale operation.
+ *            There is no limit on the number of contexts in use at once.
+ *            The context must be released with destroyContext() when the
+ *            caller is finished with it.
  * Input:
- *            num_threads: maximum number of threads that will access this
- *                         library at any point in time.
+ *            None
  * Output:
  *            None
  * Return:
- *            None
+ *            Handle to the new context
  * Exception:
- *            java.lang.InternalError if this function is invoked more than
- *            once, or if the 'num_threads' parameter is illegal
+ *            java.lang.OutOfMemoryError if the context can't be allocated
  *
  * Class:     vlc_image_ImageScaleFilterDriver
- * Method:    initialize
- * Signature: (I)V
+ * Method:    createContext
+ * Signature: ()J
  */
-JNIEXPORT void JNICALL 
-Java_vlc_image_ImageScaleFilterDriver_initialize
-(JNIEnv *env, jclass obj, jint num_threads) {
-	char buf[100];
-	int row, i;
-	int fail;
+JNIEXPORT jlong JNICALL 
+Java_vlc_image_ImageScaleFilterDriver_createContext
+(JNIEnv *env, jclass cls) {
+	ScaleContext ctx;
 	
-	/* ensure we are only called once */
-	if (init) {
-		throw_exception(env, "java/lang/InternalError",
-		"Initialize called more than once");
+	ctx = (ScaleContext) malloc(sizeof(scale_context));
+	if (ctx == NULL) {
+		throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+		return( 0 );
 	}
 	
-	init = JNI_TRUE;
+	ctx->params = NULL;
+	ctx->num_threads = 0;
 	
-	/* ensure that the number of threads is valid */
-	if (num_threads <= 0) {
-		sprintf(buf, "Illegal number of threads: %d", num_threads);
-		throw_exception(env, "java/lang/InternalError", buf);
-	}
-	
-	/* Allocate memory for structures that exist for the entire life of the */
-	/* library.  This memory is never freed */
+	return( TO_HANDLE(ctx) );
+}
+
+/*
+ * Desc:      Releases a context created by createContext(). The handle
+ *            must not be used again after this call.
+ * Input:
+ *            context:      handle returned by createContext()
+ * Output:
+ *            None
+ * Return:
+ *            None
+ * Exception:
+ *            None
+ *
+ * Class:     vlc_image_ImageScaleFilterDriver
+ * Method:    destroyContext
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL 
+Java_vlc_image_ImageScaleFilterDriver_destroyContext
+(JNIEnv *env, jclass cls, jlong context) {
+	ScaleContext ctx = TO_CONTEXT(context);
 	
-	/* allocate memory for num_threads lots of params */
-	param_list = (FilterParam *) calloc(num_threads, sizeof(FilterParam));
-	if (!param_list) {
-		/* No memory?, hopefully we'll never see this */
-		throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+	if (ctx != NULL) {
+		free(ctx->params);
+		free(ctx);
 	}
 }
 
@@ -126,7 +228,7 @@ Java_vlc_image_ImageScaleFilterDriver_initialize
  * Desc:      Initialize the scale filter library to process an image. This 
  *            function sets the type of scale filter that the library is to use.
  * Input:
- *            id:           thread id (offset into arrays at top of this file)
+ *            context:      handle returned by createContext()
  *            filter_type:  string of the filter type
  * Output:
  *            None
@@ -138,17 +240,18 @@ Java_vlc_image_ImageScaleFilterDriver_initialize
  *
  * Class:     vlc_image_ImageScaleFilterDriver
  * Method:    initScaleFilter
- * Signature: (ILjava/lang/String;)V
+ * Signature: (JLjava/lang/String;)V
  */
 JNIEXPORT void JNICALL
 Java_vlc_image_ImageScaleFilterDriver_initScaleFilter
-(JNIEnv *env, jobject obj, jint id, jstring filter_type) {
+(JNIEnv *env, jobject obj, jlong context, jstring filter_type) {
 	int i = 0;
 	int init_successful = JNI_FALSE;
 	const char *str;
 	char buf[100];
 	char tmpname[L_tmpnam];
 	FilterParam params;
+	ScaleContext ctx = TO_CONTEXT(context);
 	
 	/* obtain a C representation of the java string */
 	str = (*env)->GetStringUTFChars(env, filter_type, 0);
@@ -156,14 +259,14 @@ Java_vlc_image_ImageScaleFilterDriver_initScaleFilter
 	/* search for the given image type and if found, perform initialisation */
 	do {
 		if ( strcmp(str, available_scale_filter[i].type_string) == 0 ) {
-			/* If there is something at this ID spot already, throw it away
-			* and start again. */
-			if(param_list[id]) {
-				free(param_list[id]);
+			/* If this context has been used already, throw the old
+			* filter away and start again. */
+			if(ctx->params) {
+				free(ctx->params);
 			}
 			
-			param_list[id] = available_scale_filter[i].init_func( );
-			params = param_list[id];
+			ctx->params = available_scale_filter[i].init_func( );
+			params = ctx->params;
 			if (params != NULL) {
 				init_successful = JNI_TRUE;
 			} else {
@@ -189,10 +292,40 @@ Java_vlc_image_ImageScaleFilterDriver_initScaleFilter
 	}
 }
 
+/*
+ * Desc:      Set the most threads a scale with this context is split
+ *            between. Images too small to be worth splitting use fewer.
+ *            There is no upper limit, though a part only gets its own
+ *            thread while a processor is free for it.
+ * Input:
+ *            context:      handle returned by createContext()
+ *            num_threads:  most threads to use, 0 for one per processor
+ * Output:
+ *            None
+ * Return:
+ *            None
+ * Exception:
+ *            None
+ *
+ * Class:     vlc_image_ImageScaleFilterDriver
+ * Method:    setThreadCount
+ * Signature: (JI)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_image_ImageScaleFilterDriver_setThreadCount
+(JNIEnv *env, jobject obj, jlong context, jint num_threads) {
+	ScaleContext ctx = TO_CONTEXT(context);
+	
+	if (num_threads < 0) {
+		num_threads = 0;
+	}
+	ctx->num_threads = num_threads;
+}
+
 /*
  * Desc:      Initialize the destination byte buffer with the scaled image data.
  * Input:
- *            id:          thread id (offset into arrays at top of this file)
+ *            context:     handle returned by createContext()
  *            srcWidth:    the source image width
  *            srcheight:   the source image height
  *            srcCmp:      the number of components in the source image
@@ -202,25 +335,33 @@ Java_vlc_image_ImageScaleFilterDriver_initScaleFilter
  *            dstBuffer:   the buffer to initialize with the destination image data
  * Output:
  *            dstBuffer:   initialized with the scaled image data
+ *                         The destination rows are split into bands, each
+ *                         scaled on its own thread. The result is the same
+ *                         however many bands there are.
  * Return:
  *            None
  * Exception:
- *            None
+ *            java.lang.OutOfMemoryError if the filter runs out of memory
  *
  * Class:     vlc_image_ImageScaleFilterDriver
  * Method:    scaleImage
- * Signature: (IIIILjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;)V
+ * Signature: (JIIILjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;)V
  */
 JNIEXPORT void JNICALL 
 Java_vlc_image_ImageScaleFilterDriver_scaleImage
-(JNIEnv *env, jobject obj, jint id, jint srcWidth, jint srcHeight, jint srcCmp, jobject srcBuffer, 
+(JNIEnv *env, jobject obj, jlong context, jint srcWidth, jint srcHeight, jint srcCmp, jobject srcBuffer, 
 	jint dstWidth, jint dstHeight, jobject dstBuffer) {
 		
+	ScaleContext ctx = TO_CONTEXT(context);
 	FilterParam params;
+	scale_job job;
+	jlong pixels;
 	jbyte *srcPtr;
 	jbyte *dstPtr;
+	int done;
+	int i;
 	
-	params = param_list[id];
+	params = ctx->params;
 	
 	params->srcWidth = srcWidth;
 	params->srcHeight = srcHeight;
@@ -236,9 +377,103 @@ Java_vlc_image_ImageScaleFilterDriver_scaleImage
 	dstPtr = (*env)->GetDirectBufferAddress(env, dstBuffer);
 	params->dst_pixel_data = dstPtr;
 	
-	params->scale_func(params);
-		
+	/* only split the image when each band has enough pixels to be */
+	/* worth starting a thread for */
+	job.params = params;
+	job.num_bands = (ctx->num_threads > 0) ? ctx->num_threads : num_processors();
+	if (job.num_bands > dstHeight) {
+		job.num_bands = dstHeight;
+	}
+	pixels = (jlong) srcWidth * srcHeight + (jlong) dstWidth * dstHeight;
+	if (job.num_bands > pixels / MIN_BAND_PIXELS) {
+		job.num_bands = (int) (pixels / MIN_BAND_PIXELS);
+	}
+	
+	/* without room to track the bands, scale in one piece */
+	job.done = NULL;
+	if (job.num_bands > 1) {
+		job.done = (int *) malloc(job.num_bands * sizeof(int));
+	}
+	
+	if (job.done != NULL) {
+		run_parallel(scale_band, &job, job.num_bands);
+		done = 1;
+		for (i = 0; i < job.num_bands; i++) {
+			done = done && job.done[i];
+		}
+		free(job.done);
+	} else {
+		done = params->scale_func(params, 0, dstHeight);
+	}
+	
 	params->src_pixel_data = NULL;
 	params->dst_pixel_data = NULL;
+	
+	if (!done) {
+		throw_exception(env, "java/lang/OutOfMemoryError", NULL);
+	}
 }
 
+
+/*
+ * Desc:      Fill in the smaller levels of a mipmap chain. The levels are
+ *            held one after the other in the buffer, each half the size of
+ *            the one before, rounded down but never below 1, down to a
+ *            single pixel. Each level is the area average of the one before.
+ * Input:
+ *            buffer:      the levels, the first of which holds the image
+ *            width:       the image width
+ *            height:      the image height
+ *            cmp:         the number of components in the image
+ * Output:
+ *            buffer:      every level after the first filled in
+ * Return:
+ *            None
+ * Exception:
+ *            java.lang.IllegalArgumentException if the buffer is not
+ *            direct, or is too small to hold every level.
+ *
+ * Class:     vlc_image_ImageScaleFilterDriver
+ * Method:    generateMipmaps
+ * Signature: (Ljava/nio/ByteBuffer;III)V
+ */
+JNIEXPORT void JNICALL
+Java_vlc_image_ImageScaleFilterDriver_generateMipmaps
+(JNIEnv *env, jobject obj, jobject buffer, jint width, jint height, jint cmp) {
+	
+	jbyte *levels;
+	jlong size;
+	int w, h;
+	
+	if (width < 1 || height < 1 || cmp < 1 || cmp > 4) {
+		throw_exception(env, "java/lang/IllegalArgumentException",
+			"Invalid image size");
+		return;
+	}
+	
+	size = 0;
+	w = width;
+	h = height;
+	for (;;) {
+		size += (jlong) w * h * cmp;
+		if (w == 1 && h == 1) {
+			break;
+		}
+		w = (w > 1) ? w / 2 : 1;
+		h = (h > 1) ? h / 2 : 1;
+	}
+	
+	levels = (*env)->GetDirectBufferAddress(env, buffer);
+	if (levels == NULL) {
+		throw_exception(env, "java/lang/IllegalArgumentException",
+			"Mipmap buffer must be direct");
+		return;
+	}
+	if ((*env)->GetDirectBufferCapacity(env, buffer) < size) {
+		throw_exception(env, "java/lang/IllegalArgumentException",
+			"Mipmap buffer too small for every level");
+		return;
+	}
+	
+	build_mipmaps(levels, width, height, cmp);
+}
@@ -15,17 +15,29 @@ extern "C" {
 	
 	/* External reference to filter initialization function */
 	extern FilterParam area_avg_init( );
+	extern FilterParam bilinear_init( );
+	extern FilterParam bicubic_init( );
+	extern FilterParam mitchell_init( );
+	extern FilterParam lanczos3_init( );
 	
 	/* Number of known image scale filters */
-	#define NUM_SCALE_FILTERS 1
+	#define NUM_SCALE_FILTERS 5
 	
 	/* References to known filters */
 	static FilterType available_scale_filter[] = {
 		{area_avg_init, "AreaAverage"},     /* {initialization function, filter type identifier} */
+		{bilinear_init, "Bilinear"},
+		{bicubic_init, "Bicubic"},
+		{mitchell_init, "Mitchell"},
+		{lanczos3_init, "Lanczos3"},
 	};
 	
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
 	#include <jni.h>
 	#include "vlc_image_ImageScaleFilterDriver.h"
+	#include "threads.h"
 	
 	/* Structure containing pointers to image data structures and pointer to scale function */
 	struct param {
@@ -33,13 +45,28 @@ extern "C" {
 		int srcHeight;                          /* height of the image */
 		int srcComponents;                      /* num components 1 - 4 */
 		jbyte *src_pixel_data;                  /* pixels */
+		const jbyte *(*get_src_row)(void *, int); /* fetch a source row, NULL if */
+		                                        /* they are all in src_pixel_data */
+		void *src_row_data;                     /* passed to get_src_row */
 		int dstWidth;                           /* width of the image */
 		int dstHeight;                          /* height of the image */
 		int dstComponents;                      /* num components 1 - 4 */
 		jbyte *dst_pixel_data;                  /* pixels */
-		void (*scale_func)(FilterParam);       	/* function to perform the scale operation */
+		int (*scale_func)(FilterParam, int, int); /* scale a band of rows: first row, count, */
+		                                        /* returns 0 if out of memory */
 	};
 	
+	/* Fetch source row y. With get_src_row set, rows must be fetched in */
+	/* order, though a row may be fetched again or rows skipped, and NULL */
+	/* means the rows can't be had and the scale should stop. */
+	#define SRC_ROW(p, y) ( ( (p)->get_src_row != NULL ) ? \
+		(p)->get_src_row( (p)->src_row_data, (y) ) : \
+		(p)->src_pixel_data + (size_t)(y) * (p)->srcWidth * (p)->srcComponents )
+	
+	/* from mipmap.c, fill in every level after the first of a mipmap */
+	/* chain held one level after another */
+	extern void build_mipmaps( jbyte *levels, int width, int height, int cmp );
+	
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,238 @@
+#include "image_scale_filter.h"
+
+/*
+ * Mipmap chains. Each level is half the size of the one before, rounded
+ * down but never below 1, down to a single pixel. Every level is made
+ * from the one before, with each destination pixel the average of the
+ * source area it covers. Halving an even size gives each destination
+ * pixel two whole source pixels. Halving an odd size gives it parts of
+ * three, so nothing in the source is dropped or counted twice.
+ *
+ * Gray alpha and RGBA images are averaged with their colour premultiplied
+ * by the alpha, as the scale filters do, so clear pixels don't bleed
+ * their colour into the smaller levels.
+ */
+
+/* Number of destination pixels halved together */
+#define HALF_BLOCK 16
+
+/*
+ * The source rows or columns one destination row or column is made from,
+ * and their weights. The weights add up to total.
+ */
+typedef struct _mip_taps {
+	int first;                              /* first source row or column */
+	int count;                              /* number of them used, 1 - 3 */
+	int weight[3];                          /* weight of each */
+	int total;                              /* sum of the weights */
+} mip_taps;
+
+/*
+ * Work out the taps of destination index i when halving srcSize.
+ */
+static void mip_taps_for( int srcSize, int i, mip_taps *taps ) {
+
+	int n;
+
+	if ( srcSize == 1 ) {
+		taps->first = 0;
+		taps->count = 1;
+		taps->weight[0] = 1;
+		taps->total = 1;
+	} else if ( ( srcSize & 1 ) == 0 ) {
+		taps->first = i * 2;
+		taps->count = 2;
+		taps->weight[0] = 1;
+		taps->weight[1] = 1;
+		taps->total = 2;
+	} else {
+		/* 2n + 1 source pixels spread over n, each n / ( 2n + 1 ) wide */
+		n = srcSize / 2;
+		taps->first = i * 2;
+		taps->count = 3;
+		taps->weight[0] = n - i;
+		taps->weight[1] = n;
+		taps->weight[2] = i + 1;
+		taps->total = 2 * n + 1;
+	}
+}
+
+/*
+ * Halve two rows of a gray or RGB image, both sizes even. The rows are
+ * added down a block at a time and then across in pairs, with the block
+ * and component count fixed so the compiler can vectorise both adds. Any
+ * pixels left over after the last whole block are done one at a time.
+ */
+static void halve_rows( const unsigned char *r0, const unsigned char *r1,
+                        unsigned char *out, int width, int cmp ) {
+
+	unsigned short sums[HALF_BLOCK * 2 * 3];
+	int i, j, k;
+
+	for ( i = 0; i + HALF_BLOCK <= width; i += HALF_BLOCK ) {
+		for ( j = 0; j < HALF_BLOCK * 2 * cmp; j++ ) {
+			sums[j] = (unsigned short)( r0[j] + r1[j] );
+		}
+		switch ( cmp ) {
+			case 1:
+			for ( j = 0; j < HALF_BLOCK; j++ ) {
+				out[j] = (unsigned char)( ( sums[2 * j] + sums[2 * j + 1] + 2 ) >> 2 );
+			}
+			break;
+			case 3:
+			for ( j = 0; j < HALF_BLOCK; j++ ) {
+				for ( k = 0; k < 3; k++ ) {
+					out[3 * j + k] = (unsigned char)( ( sums[6 * j + k] +
+					                                    sums[6 * j + 3 + k] + 2 ) >> 2 );
+				}
+			}
+			break;
+		}
+		r0 += HALF_BLOCK * 2 * cmp;
+		r1 += HALF_BLOCK * 2 * cmp;
+		out += HALF_BLOCK * cmp;
+	}
+
+	for ( ; i < width; i++, r0 += 2 * cmp, r1 += 2 * cmp, out += cmp ) {
+		for ( k = 0; k < cmp; k++ ) {
+			out[k] = (unsigned char)( ( r0[k] + r0[k + cmp] +
+			                            r1[k] + r1[k + cmp] + 2 ) >> 2 );
+		}
+	}
+}
+
+/*
+ * Halve two rows of an image with alpha, both sizes even. The colour is
+ * averaged premultiplied and divided back out by the total alpha.
+ */
+static void halve_alpha_rows( const unsigned char *r0, const unsigned char *r1,
+                              unsigned char *out, int width, int cmp ) {
+
+	int i, k, a0, a1, a2, a3, total;
+
+	for ( i = 0; i < width; i++, r0 += 2 * cmp, r1 += 2 * cmp, out += cmp ) {
+		a0 = r0[cmp - 1];
+		a1 = r0[2 * cmp - 1];
+		a2 = r1[cmp - 1];
+		a3 = r1[2 * cmp - 1];
+		total = a0 + a1 + a2 + a3;
+
+		for ( k = 0; k < cmp - 1; k++ ) {
+			if ( total == 0 ) {
+				out[k] = 0;
+			} else {
+				out[k] = (unsigned char)( ( r0[k] * a0 + r0[k + cmp] * a1 +
+				                            r1[k] * a2 + r1[k + cmp] * a3 +
+				                            total / 2 ) / total );
+			}
+		}
+		out[cmp - 1] = (unsigned char)( ( total + 2 ) >> 2 );
+	}
+}
+
+/*
+ * Make one destination row from up to three source rows, with any sizes.
+ */
+static void weigh_rows( const unsigned char *src, int srcWidth,
+                        const mip_taps *row_taps, unsigned char *out,
+                        int width, int cmp, int has_alpha ) {
+
+	const unsigned char *in;
+	mip_taps col_taps;
+	jlong sums[4];
+	jlong alpha, total, w;
+	int x, i, j, k;
+	int rowLength = srcWidth * cmp;
+
+	for ( x = 0; x < width; x++, out += cmp ) {
+		mip_taps_for( srcWidth, x, &col_taps );
+		total = (jlong)row_taps->total * col_taps.total;
+
+		for ( k = 0; k < cmp; k++ ) {
+			sums[k] = 0;
+		}
+		for ( j = 0; j < row_taps->count; j++ ) {
+			in = src + (size_t)( row_taps->first + j ) * rowLength +
+			     col_taps.first * cmp;
+			for ( i = 0; i < col_taps.count; i++, in += cmp ) {
+				w = (jlong)row_taps->weight[j] * col_taps.weight[i];
+				if ( has_alpha ) {
+					for ( k = 0; k < cmp - 1; k++ ) {
+						sums[k] += w * in[k] * in[cmp - 1];
+					}
+					sums[cmp - 1] += w * in[cmp - 1];
+				} else {
+					for ( k = 0; k < cmp; k++ ) {
+						sums[k] += w * in[k];
+					}
+				}
+			}
+		}
+
+		if ( has_alpha ) {
+			alpha = sums[cmp - 1];
+			for ( k = 0; k < cmp - 1; k++ ) {
+				out[k] = (unsigned char)( ( alpha == 0 ) ? 0 :
+				                          ( sums[k] + alpha / 2 ) / alpha );
+			}
+			out[cmp - 1] = (unsigned char)( ( alpha + total / 2 ) / total );
+		} else {
+			for ( k = 0; k < cmp; k++ ) {
+				out[k] = (unsigned char)( ( sums[k] + total / 2 ) / total );
+			}
+		}
+	}
+}
+
+/*
+ * Fill in the levels of a mipmap chain held one after the other in
+ * levels, the first of which already holds the full size image.
+ */
+void build_mipmaps( jbyte *levels, int width, int height, int cmp ) {
+
+	unsigned char *src = (unsigned char *)levels;
+	unsigned char *dst;
+	int dstWidth, dstHeight;
+	int has_alpha;
+	int y;
+	mip_taps row_taps;
+
+	if ( cmp < 1 || cmp > 4 ) {
+		return;
+	}
+
+	/* gray alpha and RGBA images have alpha as the last component */
+	has_alpha = ( cmp == 2 || cmp == 4 );
+
+	while ( width > 1 || height > 1 ) {
+		dstWidth = ( width > 1 ) ? width / 2 : 1;
+		dstHeight = ( height > 1 ) ? height / 2 : 1;
+		dst = src + (size_t)width * height * cmp;
+
+		for ( y = 0; y < dstHeight; y++ ) {
+			mip_taps_for( height, y, &row_taps );
+
+			if ( row_taps.count == 2 && ( width & 1 ) == 0 ) {
+				if ( has_alpha ) {
+					halve_alpha_rows( src + (size_t)2 * y * width * cmp,
+					                  src + (size_t)( 2 * y + 1 ) * width * cmp,
+					                  dst + (size_t)y * dstWidth * cmp,
+					                  dstWidth, cmp );
+				} else {
+					halve_rows( src + (size_t)2 * y * width * cmp,
+					            src + (size_t)( 2 * y + 1 ) * width * cmp,
+					            dst + (size_t)y * dstWidth * cmp,
+					            dstWidth, cmp );
+				}
+			} else {
+				weigh_rows( src, width, &row_taps,
+				            dst + (size_t)y * dstWidth * cmp,
+				            dstWidth, cmp, has_alpha );
+			}
+		}
+
+		src = dst;
+		width = dstWidth;
+		height = dstHeight;
+	}
+}
@@ -50,15 +50,23 @@ typedef struct _bmp_source_struct * bmp_source_ptr;
 typedef struct _bmp_source_struct {
     struct param pub;                 /* public fields */
 
-    U_CHAR **colormap;                /* BMP colormap (converted to my format) */
-
-    U_CHAR **whole_image;            /* Needed to reverse row order */
+    jint colormap[256];               /* BMP colormap as ARGB pixels */
+    U_CHAR unpack[256][8];            /* indexes packed into each byte value */
+
+    const U_CHAR *image_data;        /* bitmap rows, bottom row first */
+    U_CHAR *image_copy;              /* bitmap read in from a stream or */
+                                     /* decoded from RLE, or NULL */
+    U_CHAR *indexes;                 /* one row of unpacked colormap */
+                                     /* indexes, NULL if not packed */
     int source_row;                    /* Current source row number */
     int row_width;                     /* Physical width of scanlines in file */
 
     int bits_per_pixel;              /* remembers 1-, 2-, 4-, 8- or 24-bit format */
     int compression;                  /* remembers 0, 1, 2 compression */
     int image_size;                    /* bytes of image data in the file */
+    int map_length;                    /* number of colormap entries */
+    int map_entry_size;               /* bytes per colormap entry, 0 if none */
+    int pad_bytes;                     /* bytes from header to bitmap data */
 } bmp_source_struct;
 
 
@@ -67,10 +75,10 @@ typedef struct _bmp_source_struct {
  */
 static int read_byte (bmp_source_ptr source)
 {
-    register FILE *infile = source->pub.fptr;
+    register DataSource infile = source->pub.src;
     register int c;
 
-    if ((c = getc(infile)) == EOF)
+    if ((c = SRC_GETC(infile)) == EOF)
         ERREXIT_RET(ERR_INPUT_EOF);
     return c;
 }
@@ -80,13 +88,13 @@ static int read_byte (bmp_source_ptr source)
  */
 static int read_short (bmp_source_ptr source)
 {
-    register FILE *infile = source->pub.fptr;
+    register DataSource infile = source->pub.src;
     register unsigned int lower;
     register int upper;
 
-    if ((lower = getc(infile)) == EOF)
+    if ((lower = SRC_GETC(infile)) == EOF)
         ERREXIT_RET(ERR_INPUT_EOF);
-    if ((upper = getc(infile)) == EOF)
+    if ((upper = SRC_GETC(infile)) == EOF)
         ERREXIT_RET(ERR_INPUT_EOF);
 
     return (upper << 8) + lower;
@@ -94,39 +102,85 @@ static int read_short (bmp_source_ptr source)
 
 
 /*
- * Read the colormap from a BMP file
+ * Read the colormap from a BMP file, converting each entry to the ARGB
+ * pixel it expands to. Entries are BGR (OS/2 files) or BGR0 (MS Windows
+ * files). Indexes past the end of the map give black.
  */
 static void read_colormap (bmp_source_ptr source, int cmaplen, int mapentrysize)
 {
+    U_CHAR map[256 * 4];
+    U_CHAR *inptr = map;
+    jint a, r, g, b;
     int i;
 
-    switch (mapentrysize) {
-        case 3:
-            /* BGR format (occurs in OS/2 files) */
-            for (i = 0; i < cmaplen; i++) {
-                source->colormap[2][i] = (U_CHAR) read_byte(source);
-                source->colormap[1][i] = (U_CHAR) read_byte(source);
-                source->colormap[0][i] = (U_CHAR) read_byte(source);
-            }
-            break;
-        case 4:
-            /* BGR0 format (occurs in MS Windows files) */
-            for (i = 0; i < cmaplen; i++) {
-                source->colormap[2][i] = (U_CHAR) read_byte(source);
-                source->colormap[1][i] = (U_CHAR) read_byte(source);
-                source->colormap[0][i] = (U_CHAR) read_byte(source);
-                (void) read_byte(source);
+    if (mapentrysize != 3 && mapentrysize != 4)
+        ERREXIT(ERR_BMP_BADCMAP);
+
+    if (! ReadOK(source->pub.src, map, cmaplen * mapentrysize))
+        ERREXIT(ERR_INPUT_EOF);
+
+    a = (jint)(255);
+
+    for (i = 0; i < 256; i++) {
+        if (i < cmaplen) {
+            b = (jint) inptr[0];
+            g = (jint) inptr[1];
+            r = (jint) inptr[2];
+            inptr += mapentrysize;
+        }
+        else
+            r = g = b = 0;
+
+        /* Required to return data in ARGB format */
+        source->colormap[i] = (a << 24) + (r << 16) + (g << 8) + b;
+    }
+}
+
+/*
+ * Build the table that unpacks each possible byte of 1, 2 or 4 bit
+ * pixels into the colormap indexes it holds, leftmost pixel first.
+ */
+static void build_unpack_table (bmp_source_ptr source, int bits_per_pixel)
+{
+    int pixels_per_byte = 8 / bits_per_pixel;
+    int bit_mask = (1 << bits_per_pixel) - 1;
+    int c, i, bit_shift;
+
+    for (c = 0; c < 256; c++) {
+        bit_shift = 8 - bits_per_pixel;
+        for (i = 0; i < 8; i++) {
+            if (i < pixels_per_byte) {
+                source->unpack[c][i] = (U_CHAR) ((c >> bit_shift) & bit_mask);
+                bit_shift -= bits_per_pixel;
             }
-            break;
-        default:
-            ERREXIT(ERR_BMP_BADCMAP);
-            break;
+            else
+                source->unpack[c][i] = 0;
+        }
     }
 }
 
 /*
- * This method loads the image into whole_image.
- * The data in the file is RLE encoded, so this routine decodes it.
+ * Fill count pixels from the pair of RLE4 indexes, alternating between
+ * them starting with the first.
+ */
+static void fill_pairs (U_CHAR *out_ptr, const U_CHAR *pair, int count)
+{
+    register int i;
+
+    for (i = 0; i + 1 < count; i += 2)
+        memcpy(out_ptr + i, pair, 2);
+
+    if (i < count)
+        out_ptr[i] = pair[0];
+}
+
+/*
+ * This method decodes an RLE image into image_copy, one colormap index
+ * per byte, rows in file order.  Runs are read straight out of the data
+ * source's buffer.  An encoded run is filled in one go, and an absolute
+ * run copied across, with the RLE4 nibbles split through the unpack
+ * table.  Pixels the image skips over with a delta or early end of line
+ * are left at index 0, and anything outside the image is dropped.
  * The algorithm for decoding RLE was achieved by a combination of examining
  * other (buggy) RLE code, reading the (sometimes incorrect) tech info from
  * Micro$oft's site, and reverse engineering the image format from sample
@@ -135,191 +189,171 @@ static void read_colormap (bmp_source_ptr source, int cmaplen, int mapentrysize)
 static void extract_rle_data (Parameters params)
 {
     bmp_source_ptr source = (bmp_source_ptr) params;
+    register DataSource infile = source->pub.src;
     register U_CHAR *out_ptr;
-    register FILE *infile = source->pub.fptr;
-
+    U_CHAR packed[256];
+    int width = source->pub.width;
+    int height = source->pub.height;
+    int rle4 = (source->compression == 2);
     int row, col;
-    int imageSize, i, j;
-    int xoff, yoff;
-    int currByte, byte1, byte2;
-    int pixelSize;
-
-    imageSize = source->image_size;
-
-    if (source->compression == 1)
-        pixelSize = 8;
-    else
-        pixelSize = 4;
+    int byte1, byte2;
+    int num_bytes, count, i;
 
     col = 0;
     row = 0;
+    out_ptr = source->image_copy;
 
-    /* load first row */
-    out_ptr = source->whole_image[row];
-
-    /* You already know how many bytes are in the image, so only go through */
-    /* that many. */
-
-    i=0;
-    while (i < imageSize) {
+    while (row < height) {
         /* RLE encoding is defined by two bytes */
-        if ((byte1 = getc(infile)) == EOF)
+        if ((byte1 = SRC_GETC(infile)) == EOF)
             ERREXIT(ERR_INPUT_EOF);
-        if ((byte2 = getc(infile)) == EOF)
+        if ((byte2 = SRC_GETC(infile)) == EOF)
             ERREXIT(ERR_INPUT_EOF);
 
-        i += 2;
-
-        /* If byte 1 == 0, this is an escape code */
-        if (byte1 == 0) {
+        /* If the first byte is not 0, it is the number of samples that */
+        /* are encoded by byte 2 */
+        if (byte1 != 0) {
+            count = (byte1 < width - col) ? byte1 : width - col;
 
-            /* If escaped, byte 2 == 0 means you are at end of line */
-            if (byte2 == 0) {
-                col = 0;
-                row++;
+            if (rle4)
+                fill_pairs(out_ptr + col, source->unpack[byte2], count);
+            else
+                memset(out_ptr + col, byte2, count);
 
-                out_ptr = source->whole_image[row];
-            }
-            /* If escaped, byte 2 == 1 means end of bitmap */
-            else if (byte2 == 1) {
+            col += count;
+        }
+        /* If escaped, byte 2 == 0 means you are at end of line */
+        else if (byte2 == 0) {
+            col = 0;
+            row++;
+            out_ptr += width;
+        }
+        /* If escaped, byte 2 == 1 means end of bitmap */
+        else if (byte2 == 1) {
+            return;
+        }
+        /* if escaped, byte 2 == 2 adjusts the current x and y by */
+        /* an offset stored in the next two bytes */
+        else if (byte2 == 2) {
+            col += read_byte(source);
+            i = read_byte(source);
+            if (source->pub.error)
                 return;
-            }
-            /* if escaped, byte 2 == 2 adjusts the current x and y by */
-            /* an offset stored in the next two bytes */
-            else if (byte2 == 2) {
-                xoff = read_byte(source);
-                i++;
-                yoff = read_byte(source);
-                i++;
-                col += xoff;
-                row += yoff;
-
-                out_ptr = &(source->whole_image[row][col]);
-            }
-            /* If escaped, any other value for byte 2 is the number of */
-            /* samples that you should read as pixel values (these pixels */
-            /* are not run-length encoded) */
-            else {
-
-                for (j=0; j < byte2; j++) {
-
-                    // Read in the next byte
-                    if ((currByte = getc(infile)) == EOF)
-                        ERREXIT(ERR_INPUT_EOF);
-                    i++;
-
-                    /* necessary to prevent buffer overrun */
-                    /* incase image file is corrupt */
-                    if (col >= source->pub.width) {
-                        continue;
-                    }
-
-                    if (pixelSize == 4) {
-                        *out_ptr++ = (U_CHAR) ((currByte >> 4) & 0xf);
-                        col++;
-                        j++;
-
-                        if (j < byte2) {
-                            *out_ptr++ = (U_CHAR) (currByte & 0xf);
-                            col++;
-                        }
-                    }
-                    else {
-                        *out_ptr++ = (U_CHAR) currByte;
-                        col++;
-                    }
-                }
-                /* The pixels must be word-aligned, so if you read */
-                /* an uneven number of bytes, read and ignore a byte */
-                /* to get aligned again. */
-
-                /* determine if we need to read another byte */
-                if (pixelSize == 4)
-                    byte2 >>= 1;
-
-                if ( (byte2 & 1) == 1) {
-                    if (getc(infile) == EOF)
-                        ERREXIT(ERR_INPUT_EOF);
-                    i++;
-                }
-            }
 
+            if (col > width)
+                col = width;
+
+            row += i;
+            out_ptr += (size_t) i * width;
         }
-        /* If the first byte was not 0, it is the number of samples that */
-        /* are encoded by byte 2 */
+        /* If escaped, any other value for byte 2 is the number of */
+        /* samples that you should read as pixel values (these pixels */
+        /* are not run-length encoded). They are padded to a whole */
+        /* number of words. */
         else {
-            for (j=0; j < byte1; j++) {
-
-                /* necessary to prevent buffer overrun */
-                /* incase image file is corrupt */
-                if (col >= source->pub.width) {
-                    continue;
-                }
-
-                if (pixelSize == 4) {
-                    /* If j is odd, use the upper 4 bits */
-                    if ((j & 1) == 0) {
-                        *out_ptr++ = (U_CHAR) ((byte2 >> 4) & 0xf);
-                    } else {
-                        *out_ptr++ = (U_CHAR) (byte2 & 0xf);
-                    }
-                } else {
-                    *out_ptr++ = (U_CHAR) byte2;
-                }
-                col++;
+            num_bytes = rle4 ? (byte2 + 1) / 2 : byte2;
+
+            if (! ReadOK(infile, packed, (num_bytes + 1) & ~1))
+                ERREXIT(ERR_INPUT_EOF);
+
+            count = (byte2 < width - col) ? byte2 : width - col;
+
+            if (rle4) {
+                for (i = 0; i + 1 < count; i += 2)
+                    memcpy(out_ptr + col + i, source->unpack[packed[i / 2]], 2);
+
+                if (i < count)
+                    out_ptr[col + i] = source->unpack[packed[i / 2]][0];
             }
+            else
+                memcpy(out_ptr + col, packed, count);
+
+            col += count;
         }
     }
 }
 
+/*
+ * Return the next row of the image as stored in the file. The rows are
+ * stored bottom up, so they are taken from the end of the bitmap first.
+ */
+static const U_CHAR *next_file_row (bmp_source_ptr source)
+{
+    source->source_row--;
+
+    return source->image_data + (size_t) source->source_row * source->row_width;
+}
+
+/*
+ * Return the colormap indexes of the next row, one per byte. Pixels of
+ * less than 8 bits are unpacked a whole byte at a time through the unpack
+ * table, which always gives 8 indexes but only moves on by as many as the
+ * byte holds. 8-bit and RLE rows already have an index per byte.
+ */
+static const U_CHAR *next_index_row (bmp_source_ptr source)
+{
+    register const U_CHAR *inptr;
+    register U_CHAR *outptr;
+    register int pixels_per_byte;
+    int num_bytes;
+
+    inptr = next_file_row(source);
+
+    if (source->indexes == NULL)
+        return inptr;
+
+    pixels_per_byte = 8 / source->bits_per_pixel;
+    num_bytes = (source->pub.width + pixels_per_byte - 1) / pixels_per_byte;
+    outptr = source->indexes;
+
+    while (--num_bytes >= 0) {
+        memcpy(outptr, source->unpack[*inptr++], 8);
+        outptr += pixels_per_byte;
+    }
+
+    return source->indexes;
+}
+
 /*
  * Read one row of pixels.
- * The image has been read into the whole_image array, but is otherwise
- * unprocessed.  We must read it out in top-to-bottom row order, and if
- * it is an 8-bit image, we must expand colormapped pixels to 24bit format.
+ * We must read the rows out in top-to-bottom order, expanding colormapped
+ * pixels to 24bit format.
  */
 static void get_nbit_row (Parameters params)
 {
-    /* This version is for reading 8-bit colormap indexes */
+    /* This version is for reading 1, 2, 4 and 8-bit colormap indexes */
     bmp_source_ptr source = (bmp_source_ptr) params;
-    register U_CHAR **colormap = source->colormap;
-    register int t;
-    register U_CHAR *inptr;
+    register const jint *colormap = source->colormap;
+    register const U_CHAR *inptr;
     register jint *data;
     register int col;
-    jint a, r, g, b;
-
-    /* Fetch next row from virtual array */
-    source->source_row--;
 
-    /* Expand the colormap indexes to real data */
-    inptr = source->whole_image[source->source_row];
+    inptr = next_index_row(source);
     data = source->pub.buffer;
 
-    for (col = 0; col < source->pub.width; col++) {
-        /* extract components from byte array and store them *
-        /* in the int array which is accessible by caller */
-        a = (jint)(255);
-
-        t = (int)(inptr[col] & 0xff);
-
-        r = (jint)((int)(colormap[0][t]) & 0xff);
-        g = (jint)((int)(colormap[1][t]) & 0xff);
-        b = (jint)((int)(colormap[2][t]) & 0xff);
+    /* the colormap already holds the ARGB value of each index */
+    for (col = 0; col < source->pub.width; col++)
+        data[col] = colormap[inptr[col]];
+}
 
 /*
-For 16 bits per pixel
-        a = (unsigned int)(1);
-        r = ((unsigned int)((colormap[0][t]) >> 3) & 0x1f);
-        g = ((unsigned int)((colormap[1][t]) >> 3) & 0x1f);
-        b = ((unsigned int)((colormap[2][t]) >> 3) & 0x1f);
-*/
+ * Read one row of packed RGB bytes from colormap indexes.
+ */
+static void get_nbit_byte_row (Parameters params, U_CHAR *dest)
+{
+    bmp_source_ptr source = (bmp_source_ptr) params;
+    register const jint *colormap = source->colormap;
+    register const U_CHAR *inptr;
+    register jint pixel;
+    register int col;
 
-        /* Required to return data in ARGB format */
-        data[col] = (a << 24) + (r << 16) + (g << 8) + b;
-/*
-        data[col] = (jshort)((a << 15) + (r << 10) + (g << 5) + b);
-*/
+    inptr = next_index_row(source);
+
+    for (col = 0; col < source->pub.width; col++) {
+        pixel = colormap[inptr[col]];
+        *dest++ = (U_CHAR) (pixel >> 16);
+        *dest++ = (U_CHAR) (pixel >> 8);
+        *dest++ = (U_CHAR) pixel;
     }
 }
 
@@ -330,138 +364,55 @@ For 16 bits per pixel
 static void get_24bit_row (Parameters params)
 {
     bmp_source_ptr source = (bmp_source_ptr) params;
-    register U_CHAR *inptr;
+    register const U_CHAR *inptr;
     register jint *data;
     register int col;
     jint a, r, g, b;
 
-    /* Fetch next row from virtual array */
-    source->source_row--;
-
     /* Transfer data.  Note source values are in BGR order
      * (even though Microsoft's own documents say the opposite).
      */
-    inptr = source->whole_image[source->source_row];
+    inptr = next_file_row(source);
     data = source->pub.buffer;
 
-    for (col = 0; col < source->pub.width; col++) {
+    a = (jint)(255);
 
-        /* extract components from byte array and store them *
-        /* in the short array which is accessible by caller */
-        a = (jint)(255);
-
-        b = (jint)((int)(*inptr++) & 0xff);
-        g = (jint)((int)(*inptr++) & 0xff);
-        r = (jint)((int)(*inptr++) & 0xff);
-
-/*
-        a = (unsigned int)(1);
-        b = ((unsigned int)(*inptr++ >> 3) & 0x1f);
-        g = ((unsigned int)(*inptr++ >> 3) & 0x1f);
-        r = ((unsigned int)(*inptr++ >> 3) & 0x1f);
-*/
+    for (col = 0; col < source->pub.width; col++) {
+        b = (jint) *inptr++;
+        g = (jint) *inptr++;
+        r = (jint) *inptr++;
 
         /* Required to return data in ARGB format */
         data[col] = (a << 24) + (r << 16) + (g << 8) + b;
-/*
-        data[col] = (jshort)((a << 15) + (r << 10) + (g << 5) + b);
-*/
     }
 }
 
-
 /*
- * This method loads the image into whole_image during the first call on
- * get_pixel_rows.  The get_pixel_rows pointer is then adjusted to call
- * get_8bit_row or get_24bit_row on subsequent calls.
+ * Read one row of packed RGB bytes from 24-bit pixels, which only needs
+ * the BGR order of the file swapping round.
  */
-static void preload_image (Parameters params)
+static void get_24bit_byte_row (Parameters params, U_CHAR *dest)
 {
     bmp_source_ptr source = (bmp_source_ptr) params;
-    register FILE *infile = source->pub.fptr;
-    register int c;
-    register U_CHAR *out_ptr;
-    int row, col;
-    int pixels_per_byte, bit_mask, bit_shift, bits_per_pixel;
-    int num_cols, i;
-
-    bits_per_pixel = source->bits_per_pixel;    /* local copy for faster access */
-
-    /* get data into whole_image buffer */
-    switch(source->compression) {
-        case 0:
-            num_cols = source->row_width;
-
-            /* this is for the case where there are multiple pixels stored per byte */
-            if (bits_per_pixel < 8) {
-                bit_mask = (1 << bits_per_pixel) - 1;
-
-                pixels_per_byte = 8 / bits_per_pixel;
-                num_cols = source->pub.width / pixels_per_byte;
-
-                /* make sure we round up */
-                if ((source->pub.width % pixels_per_byte) != 0)
-                    num_cols++;
-
-                while ((num_cols & 3) != 0) num_cols++;
-            }
+    register const U_CHAR *inptr;
+    register int col;
 
-            /* Read the data into a virtual array in input-file row order. */
-            for(row = 0; row < source->pub.height; row++) {
-
-                out_ptr = source->whole_image[row];
-
-                for(col = num_cols; col > 0; col--) {
-                    /* inline copy of read_byte() for speed */
-                    if ((c = getc(infile)) == EOF)
-                        ERREXIT(ERR_INPUT_EOF);
-
-                     /* extract, so that one byte has only one pixel */
-                     if (bits_per_pixel < 8) {
-                         bit_shift = 8 - bits_per_pixel;
-                         for(i=0;i<pixels_per_byte;i++) {
-                             *out_ptr++ = (U_CHAR) ( (c >> bit_shift) & bit_mask );
-                             bit_shift -= bits_per_pixel;
-                         }
-                     }
-                     else
-                         *out_ptr++ = (U_CHAR) c;
-                }
-            }
-            break;
-        case 1:
-        case 2:
-            extract_rle_data(params);
-            break;
-        default:
-            break;
-    }
+    inptr = next_file_row(source);
 
-    /* Set up to read from the virtual array in top-to-bottom order */
-    switch (bits_per_pixel) {
-        case 1:
-        case 2:
-        case 4:
-        case 8:
-            source->pub.get_pixel_row = get_nbit_row;
-            break;
-        case 24:
-            source->pub.get_pixel_row = get_24bit_row;
-            break;
-        default:
-            ERREXIT(ERR_BMP_BADDEPTH);
+    for (col = 0; col < source->pub.width; col++) {
+        *dest++ = inptr[2];
+        *dest++ = inptr[1];
+        *dest++ = inptr[0];
+        inptr += 3;
     }
-    source->source_row = source->pub.height;
-
-    /* And read the first row */
-    (*source->pub.get_pixel_row) (params);
 }
 
 
 /*
- * Read the file header; return image size and component count.
+ * Read the file and info headers only; return image size and component
+ * count. The colormap and image data are left unread.
  */
-static void start_input_bmp (Parameters params)
+static void read_header_bmp (Parameters params)
 {
     bmp_source_ptr source = (bmp_source_ptr) params;
     U_CHAR bmpfileheader[14];
@@ -477,16 +428,14 @@ static void start_input_bmp (Parameters params)
     int biWidth = 0;                    /* initialize to avoid compiler warning */
     int biHeight = 0;
     unsigned int biPlanes;
-    int biCompression;
-    int biSizeImage;
+    int biCompression = 0;
+    int biSizeImage = 0;
     int biXPelsPerMeter,biYPelsPerMeter;
     int biClrUsed = 0;
     int mapentrysize = 0;             /* 0 indicates no colormap */
-    int bPad;
-    int row_width;
 
     /* Read and verify the bitmap file header */
-    if (! ReadOK(source->pub.fptr, bmpfileheader, 14))
+    if (! ReadOK(source->pub.src, bmpfileheader, 14))
         ERREXIT(ERR_INPUT_EOF);
     if (GET_2B(bmpfileheader,0) != 0x4D42) /* 'BM' */
         ERREXIT(ERR_BMP_NOT);
@@ -496,7 +445,7 @@ static void start_input_bmp (Parameters params)
     /* The infoheader might be 12 bytes (OS/2 1.x), 40 bytes (Windows),
      * or 64 bytes (OS/2 2.x).  Check the first 4 bytes to find out which.
      */
-    if (! ReadOK(source->pub.fptr, bmpinfoheader, 4))
+    if (! ReadOK(source->pub.src, bmpinfoheader, 4))
         ERREXIT(ERR_INPUT_EOF);
 
     headerSize = (int) GET_4B(bmpinfoheader,0);
@@ -504,7 +453,7 @@ static void start_input_bmp (Parameters params)
     if (headerSize < 12 || headerSize > 64)
         ERREXIT(ERR_BMP_BADHEADER);
 
-    if (! ReadOK(source->pub.fptr, bmpinfoheader+4, headerSize-4))
+    if (! ReadOK(source->pub.src, bmpinfoheader+4, headerSize-4))
         ERREXIT(ERR_INPUT_EOF);
 
     switch ((int) headerSize) {
@@ -569,60 +518,151 @@ static void start_input_bmp (Parameters params)
             break;
     }
 
-    /* Compute distance to bitmap data --- will adjust for colormap below */
-    bPad = bfOffBits - (headerSize + 14);
-
-    /* Read the colormap, if any */
     if (mapentrysize > 0) {
         if (biClrUsed <= 0)
             biClrUsed = 1 << source->bits_per_pixel;    /* assume it's 256 */
         else if (biClrUsed > 256)
             ERREXIT(ERR_BMP_BADCMAP);
+    }
 
-        /* Allocate space to store the colormap */
-        if ( !(source->colormap = alloc2DByteArray(3, (int) biClrUsed)))
-            ERREXIT(ERR_OUT_OF_MEMORY);
+    /* Compute distance to bitmap data --- start_input adjusts for colormap */
+    source->pad_bytes = bfOffBits - (headerSize + 14);
+    source->map_length = biClrUsed;
+    source->map_entry_size = mapentrysize;
 
-        /* and read it from the file */
-        read_colormap(source, (int) biClrUsed, mapentrysize);
+    source->compression = biCompression;
+    source->image_size = biSizeImage;
+
+    /* set image width and height */
+    source->pub.width = (int) biWidth;
+    source->pub.height = (int) biHeight;
+    source->pub.bitDepth = (source->bits_per_pixel == 24) ?
+                               8 : source->bits_per_pixel;
+}
+
+
+/*
+ * Read the file header; return image size and component count.
+ * Uncompressed images are read straight from memory when the source is
+ * held there, or else in one block, and each row is found by its offset.
+ * RLE images are decoded up front to one index per pixel, as the bottom
+ * row comes first.
+ */
+static void start_input_bmp (Parameters params)
+{
+    bmp_source_ptr source = (bmp_source_ptr) params;
+    DataSource src = source->pub.src;
+    int bPad;
+    int row_width;
+    size_t image_bytes;
+
+    read_header_bmp(params);
+    if (source->pub.error)
+        return;
+
+    if (source->pub.width <= 0 || source->pub.height <= 0)
+        ERREXIT(ERR_BMP_BADHEADER);
+
+    /* Distance to bitmap data --- will adjust for colormap below */
+    bPad = source->pad_bytes;
+
+    /* Read the colormap, if any */
+    if (source->map_entry_size > 0) {
+        read_colormap(source, source->map_length, source->map_entry_size);
+        if (source->pub.error)
+            return;
 
         /* account for size of colormap */
-        bPad -= biClrUsed * mapentrysize;
+        bPad -= source->map_length * source->map_entry_size;
     }
 
     /* Skip any remaining pad bytes */
     if (bPad < 0){                 /* incorrect bfOffBits value? */
         ERREXIT(ERR_BMP_BADHEADER);
     }
-    while (--bPad >= 0) {
-        (void) read_byte(source);
+    if (src_skip(src, bPad) != (size_t) bPad)
+        ERREXIT(ERR_INPUT_EOF);
+
+    if (source->compression == 1 || source->compression == 2) {
+        if (source->bits_per_pixel > 8)
+            ERREXIT(ERR_BMP_BADDEPTH);
+
+        /* RLE rows are unpacked to one index per byte */
+        image_bytes = (size_t) source->pub.width * source->pub.height;
+
+        if (image_bytes / source->pub.width != (size_t) source->pub.height)
+            ERREXIT(ERR_OUT_OF_MEMORY);
+
+        if ( !(source->image_copy = (U_CHAR *) calloc(image_bytes, 1)))
+            ERREXIT(ERR_OUT_OF_MEMORY);
+
+        if (source->compression == 2)
+            build_unpack_table(source, 4);
+
+        extract_rle_data(params);
+        if (source->pub.error)
+            return;
+
+        source->image_data = source->image_copy;
+        source->row_width = source->pub.width;
+        source->source_row = source->pub.height;
+
+        source->pub.get_pixel_row = get_nbit_row;
+        source->pub.get_byte_row = get_nbit_byte_row;
+        return;
     }
 
     /* Compute row width in file, including padding to 4-byte boundary */
-    if (source->bits_per_pixel == 24)
-        row_width = (int) (biWidth * 3);
-    else if (source->bits_per_pixel == 8)
-        row_width = (int) biWidth;
-    else
-        row_width = (int) biWidth + 3 * 8;     /* extra for safety */
+    row_width = (int) ((((size_t) source->pub.width *
+                         source->bits_per_pixel + 31) / 32) * 4);
+    image_bytes = (size_t) row_width * source->pub.height;
 
-    while ((row_width & 3) != 0)
-        row_width++;
+    if (image_bytes / row_width != (size_t) source->pub.height)
+        ERREXIT(ERR_OUT_OF_MEMORY);
 
     source->row_width = row_width;
+    source->source_row = source->pub.height;
 
-    /* Allocate space for inversion array, prepare for preload pass */
-    if ( !(source->whole_image = alloc2DByteArray(biHeight, row_width)))
-        ERREXIT(ERR_OUT_OF_MEMORY);
+    if (src->base != NULL) {
+        /* the bitmap is in memory already, so read it in place */
+        if (src->bytes_left < image_bytes)
+            ERREXIT(ERR_INPUT_EOF);
 
-    source->pub.get_pixel_row = preload_image;
+        source->image_data = src->next_byte;
+    }
+    else {
+        /* the bottom row comes first, so all of it has to be read */
+        if ( !(source->image_copy = (U_CHAR *) malloc(image_bytes)))
+            ERREXIT(ERR_OUT_OF_MEMORY);
 
-    source->compression = biCompression;
-    source->image_size = biSizeImage;
+        if (! ReadOK(src, source->image_copy, image_bytes))
+            ERREXIT(ERR_INPUT_EOF);
 
-    /* set image width and height */
-    source->pub.width = (int) biWidth;
-    source->pub.height = (int) biHeight;
+        source->image_data = source->image_copy;
+    }
+
+    switch (source->bits_per_pixel) {
+        case 1:
+        case 2:
+        case 4:
+            build_unpack_table(source, source->bits_per_pixel);
+
+            /* the last byte of a row is unpacked in full */
+            if ( !(source->indexes = (U_CHAR *) malloc(source->pub.width + 8)))
+                ERREXIT(ERR_OUT_OF_MEMORY);
+
+            /* fall through */
+        case 8:
+            source->pub.get_pixel_row = get_nbit_row;
+            source->pub.get_byte_row = get_nbit_byte_row;
+            break;
+        case 24:
+            source->pub.get_pixel_row = get_24bit_row;
+            source->pub.get_byte_row = get_24bit_byte_row;
+            break;
+        default:
+            ERREXIT(ERR_BMP_BADDEPTH);
+    }
 }
 
 
@@ -634,8 +674,12 @@ static void finish_input_bmp (Parameters params)
     bmp_source_ptr source = (bmp_source_ptr) params;
 
     /* free allocated memory */
-    free2DByteArray(source->colormap);
-    free2DByteArray(source->whole_image);
+    free(source->image_copy);
+    free(source->indexes);
+
+    source->image_data = NULL;
+    source->image_copy = NULL;
+    source->indexes = NULL;
 }
 
 
@@ -653,10 +697,12 @@ Parameters bmp_init ()
 
     if (source != NULL) {
         /* Initialise structure */
-        source->pub.fptr = NULL;
+        source->pub.src = NULL;
         source->pub.width = -1;
         source->pub.height = -1;
         source->pub.numComponents = 3;
+        source->pub.bitDepth = 8;
+        source->pub.interlaced = JNI_FALSE;
         source->pub.buffer = NULL;
         source->pub.row_num = 0;
         source->pub.error = JNI_FALSE;
@@ -664,13 +710,21 @@ Parameters bmp_init ()
 
         source->row_width = 0;
         source->source_row = 0;
-        source->colormap = NULL;
-        source->whole_image = NULL;
+        source->image_data = NULL;
+        source->image_copy = NULL;
+        source->indexes = NULL;
         source->image_size = 0;
+        source->map_length = 0;
+        source->map_entry_size = 0;
+        source->pad_bytes = 0;
 
         /* Fill in method ptrs, except get_pixel_row which start_input sets */
+        source->pub.read_header = read_header_bmp;
         source->pub.start_input = start_input_bmp;
         source->pub.finish_input = finish_input_bmp;
+        source->pub.get_byte_row = NULL;
+        source->pub.get_byte_rows = NULL;
+        source->pub.count_pages = NULL;
     }
 
     /* return the reference to initialised parameter structure */
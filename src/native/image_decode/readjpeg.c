@@ -27,6 +27,14 @@ struct my_error_mgr {
 /* Private version of error handler */
 typedef struct my_error_mgr * my_error_ptr;
 
+/* Source manager that feeds libjpeg from our own data source */
+typedef struct {
+    struct jpeg_source_mgr pub;     /* "public" fields */
+    DataSource src;                  /* where the encoded data comes from */
+} my_source_mgr;
+
+typedef my_source_mgr * my_src_ptr;
+
 /* Private version of data source object */
 typedef struct _jpeg_source_struct * jpeg_source_ptr;
 
@@ -36,8 +44,13 @@ typedef struct _jpeg_source_struct {
     struct jpeg_decompress_struct cinfo;
     JSAMPARRAY buffer;              /* Output row buffer */
     my_error_ptr err;                /* Our error handler */
+    my_source_mgr src_mgr;          /* Our source manager */
+    int decompressing;              /* TRUE once the decompressor started */
 } jpeg_source_struct;
 
+/* Fake EOI marker handed out if the data ends early */
+static const JOCTET fake_eoi[2] = { (JOCTET) 0xFF, (JOCTET) JPEG_EOI };
+
 
 
 /*
@@ -62,6 +75,65 @@ static void my_error_exit(j_common_ptr cinfo)
 }
 
 
+/*
+ * Source manager methods. The bytes in the data source buffer are handed
+ * to libjpeg without copying. For a memory source that is the whole
+ * image in one go.
+ */
+static void init_source(j_decompress_ptr cinfo)
+{
+    /* nothing to do, the data source is already set up */
+}
+
+static boolean fill_input_buffer(j_decompress_ptr cinfo)
+{
+    my_src_ptr mgr = (my_src_ptr) cinfo->src;
+    DataSource src = mgr->src;
+
+    if (src->bytes_left == 0 && !src_fill(src))
+    {
+        /* Premature end of data. Insert a fake EOI marker, the same as */
+        /* the stdio source manager does, so we get what we can. */
+        mgr->pub.next_input_byte = fake_eoi;
+        mgr->pub.bytes_in_buffer = 2;
+        return TRUE;
+    }
+
+    /* libjpeg now owns everything left in the buffer */
+    mgr->pub.next_input_byte = src->next_byte;
+    mgr->pub.bytes_in_buffer = src->bytes_left;
+    src->next_byte += src->bytes_left;
+    src->bytes_left = 0;
+
+    return TRUE;
+}
+
+static void skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    my_src_ptr mgr = (my_src_ptr) cinfo->src;
+
+    if (num_bytes <= 0)
+        return;
+
+    if ((size_t) num_bytes <= mgr->pub.bytes_in_buffer)
+    {
+        mgr->pub.next_input_byte += (size_t) num_bytes;
+        mgr->pub.bytes_in_buffer -= (size_t) num_bytes;
+    }
+    else
+    {
+        /* skip the rest directly in the data source */
+        num_bytes -= (long) mgr->pub.bytes_in_buffer;
+        mgr->pub.bytes_in_buffer = 0;
+        (void) src_skip(mgr->src, (size_t) num_bytes);
+    }
+}
+
+static void term_source(j_decompress_ptr cinfo)
+{
+    /* nothing to do, the data source is released by the caller */
+}
+
 /*
  * Read one row of pixels.
  * The row of pixel data is copied into params->buffer
@@ -122,72 +194,163 @@ static void get_row_jpeg(Parameters params)
 }
 
 /*
- * Read the file header; return image size
+ * Read one row of pixels as packed bytes.
+ * libjpeg already produces the samples in R,G,B or gray order, so the
+ * scan line is decoded straight into dest.
  */
-static void start_input_jpeg(Parameters params)
+static void get_byte_row_jpeg(Parameters params, U_CHAR *dest)
 {
     jpeg_source_ptr source = (jpeg_source_ptr) params;
-    int row_stride;                     /* physical row width in output buffer */
+    JSAMPROW row = (JSAMPROW) dest;
 
-    /* allocate memory for our error handler */
-    source->err = (struct my_error_mgr *)malloc(sizeof(struct my_error_mgr));
+   (void) jpeg_read_scanlines(&(source->cinfo), &row, 1);
+}
+
+/*
+ * Pick the largest DCT scaling libjpeg supports that still gives an
+ * image at least as big as the caller's target. Decoding at 1/2, 1/4
+ * or 1/8 size skips most of the IDCT work.
+ */
+static void set_scale(jpeg_source_ptr source)
+{
+    JDIMENSION w = source->cinfo.image_width;
+    JDIMENSION h = source->cinfo.image_height;
+    int tw = source->pub.target_width;
+    int th = source->pub.target_height;
+    unsigned int denom;
+
+    if(tw <= 0 && th <= 0)
+        return;
 
-    if(source->err)
+    /* libjpeg rounds the scaled size up */
+    for(denom = 8; denom > 1; denom /= 2)
     {
-        /* allocate and initialize JPEG decompression object */
-
-        /* We set up the normal JPEG error routines, then override error_exit. */
-        source->cinfo.err = jpeg_std_error(&source->err->pub);
-        source->err->pub.error_exit = my_error_exit;
-        source->err->param = params;
-
-        /* Now we can initialize the JPEG decompression object. */
-        jpeg_create_decompress(&(source->cinfo));
-        if(source->pub.error)
-            goto end;
-
-        /* specify data source */
-        jpeg_stdio_src(&(source->cinfo), source->pub.fptr);
-        if(source->pub.error)
-            goto end;
-
-        /* read file parameters with jpeg_read_header() */
-       (void) jpeg_read_header(&(source->cinfo), TRUE);
-        if(source->pub.error)
-            goto end;
-
-        /* set parameters for decompression */
-        /* - no parameters to set */
-
-        /* Start decompressor */
-       (void) jpeg_start_decompress(&(source->cinfo));
-        if(source->pub.error)
-            goto end;
-
-        /* JSAMPLEs per row in output buffer */
-        row_stride = source->cinfo.output_width * source->cinfo.output_components;
-        /* Make a one-row-high sample array that will go away when */
-        /* done with image */
-        source->buffer = (*(source->cinfo.mem->alloc_sarray))
-         ((j_common_ptr) &(source->cinfo), JPOOL_IMAGE, row_stride, 1);
-        if(source->pub.error)
-            goto end;
-
-        /* set image width and height */
-        source->pub.width = (int) source->cinfo.output_width;
-        source->pub.height = (int) source->cinfo.output_height;
-		source->pub.numComponents = source->cinfo.output_components;
+        if((JDIMENSION) tw <= (w + denom - 1) / denom &&
+           (JDIMENSION) th <= (h + denom - 1) / denom)
+            break;
     }
-    else
+
+    source->cinfo.scale_num = 1;
+    source->cinfo.scale_denom = denom;
+}
+
+/*
+ * Set up the decompression object and read the JPEG header, up to the
+ * start of the first scan. Returns FALSE on error.
+ */
+static int open_jpeg(jpeg_source_ptr source)
+{
+    /* allocate memory for our error handler */
+    source->err = (struct my_error_mgr *)malloc(sizeof(struct my_error_mgr));
+
+    if(!source->err)
     {
         /* Our malloc failed, hopefully we never get to here */
         strncpy(source->pub.error_msg, ERR_OUT_OF_MEMORY, ERROR_LEN);
         source->pub.error_msg[ERROR_LEN-1] = '\0';
         source->pub.error = JNI_TRUE;
+        return JNI_FALSE;
     }
-end:
-    /* the label here is for exiting on errors */
-    ;
+
+    /* allocate and initialize JPEG decompression object */
+
+    /* We set up the normal JPEG error routines, then override error_exit. */
+    source->cinfo.err = jpeg_std_error(&source->err->pub);
+    source->err->pub.error_exit = my_error_exit;
+    source->err->param = (Parameters) source;
+
+    /* Now we can initialize the JPEG decompression object. */
+    jpeg_create_decompress(&(source->cinfo));
+    if(source->pub.error)
+        return JNI_FALSE;
+
+    /* specify data source */
+    source->src_mgr.pub.init_source = init_source;
+    source->src_mgr.pub.fill_input_buffer = fill_input_buffer;
+    source->src_mgr.pub.skip_input_data = skip_input_data;
+    source->src_mgr.pub.resync_to_restart = jpeg_resync_to_restart;
+    source->src_mgr.pub.term_source = term_source;
+    source->src_mgr.pub.next_input_byte = NULL;
+    source->src_mgr.pub.bytes_in_buffer = 0;
+    source->src_mgr.src = source->pub.src;
+    source->cinfo.src = &(source->src_mgr.pub);
+
+    /* read file parameters with jpeg_read_header() */
+   (void) jpeg_read_header(&(source->cinfo), TRUE);
+    if(source->pub.error)
+        return JNI_FALSE;
+
+    source->pub.bitDepth = source->cinfo.data_precision;
+    source->pub.interlaced = source->cinfo.progressive_mode;
+
+    /* set parameters for decompression */
+    set_scale(source);
+
+    return JNI_TRUE;
+}
+
+/*
+ * Read the file header only; return image size without decoding
+ */
+static void read_header_jpeg(Parameters params)
+{
+    jpeg_source_ptr source = (jpeg_source_ptr) params;
+
+    if(!open_jpeg(source))
+        return;
+
+    /* work out the output size without starting the decompressor */
+    jpeg_calc_output_dimensions(&(source->cinfo));
+    if(source->pub.error)
+        return;
+
+    source->pub.width = (int) source->cinfo.output_width;
+    source->pub.height = (int) source->cinfo.output_height;
+    source->pub.numComponents = source->cinfo.output_components;
+}
+
+/*
+ * Read the file header; return image size
+ */
+static void start_input_jpeg(Parameters params)
+{
+    jpeg_source_ptr source = (jpeg_source_ptr) params;
+    int row_stride;                     /* physical row width in output buffer */
+
+    if(!open_jpeg(source))
+        return;
+
+    /* Start decompressor */
+   (void) jpeg_start_decompress(&(source->cinfo));
+    if(source->pub.error)
+        return;
+
+    source->decompressing = JNI_TRUE;
+
+    /* Only gray and RGB are returned, for CMYK and YCCK the samples */
+    /* libjpeg produces aren't RGBA, whichever row call is used */
+    if(source->cinfo.output_components != 1 &&
+       source->cinfo.output_components != 3)
+    {
+        strncpy(source->pub.error_msg, ERR_COLOR_SPACE, ERROR_LEN);
+        source->pub.error_msg[ERROR_LEN-1] = '\0';
+        source->pub.error = JNI_TRUE;
+        return;
+    }
+
+    /* JSAMPLEs per row in output buffer */
+    row_stride = source->cinfo.output_width * source->cinfo.output_components;
+    /* Make a one-row-high sample array that will go away when */
+    /* done with image */
+    source->buffer = (*(source->cinfo.mem->alloc_sarray))
+     ((j_common_ptr) &(source->cinfo), JPOOL_IMAGE, row_stride, 1);
+    if(source->pub.error)
+        return;
+
+    /* set image width and height */
+    source->pub.width = (int) source->cinfo.output_width;
+    source->pub.height = (int) source->cinfo.output_height;
+    source->pub.numComponents = source->cinfo.output_components;
 }
 
 
@@ -198,8 +361,13 @@ static void finish_input_jpeg(Parameters params)
 {
     jpeg_source_ptr source = (jpeg_source_ptr) params;
 
-    /* Finish decompression */
-   (void) jpeg_finish_decompress(&(source->cinfo));
+    /* nothing was set up if the error handler couldn't be allocated */
+    if(!source->err)
+        return;
+
+    /* Finish decompression, unless only the header was read */
+    if(source->decompressing)
+       (void) jpeg_finish_decompress(&(source->cinfo));
 
     /* Release JPEG decompression object */
     /* This is an important step since it will release a good deal of memory. */
@@ -207,6 +375,7 @@ static void finish_input_jpeg(Parameters params)
 
     /* Free memory allocated to the error handler */
     free(source->err);
+    source->err = NULL;
 }
 
 
@@ -225,21 +394,29 @@ Parameters jpeg_init()
     if(source != NULL)
     {
         /* Initialise structure */
-        source->pub.fptr = NULL;
+        source->pub.src = NULL;
         source->pub.width = -1;
         source->pub.height = -1;
         source->pub.numComponents = 3;
+        source->pub.bitDepth = 8;
+        source->pub.interlaced = JNI_FALSE;
         source->pub.buffer = NULL;
         source->pub.row_num = 0;
         source->pub.error = JNI_FALSE;
         source->pub.error_msg[0] = '\0';
 
         source->image_buffer = NULL;
+        source->err = NULL;
+        source->decompressing = JNI_FALSE;
 
         /* Fill in method ptrs */
+        source->pub.read_header = read_header_jpeg;
         source->pub.start_input = start_input_jpeg;
         source->pub.get_pixel_row = get_row_jpeg;
         source->pub.finish_input = finish_input_jpeg;
+        source->pub.get_byte_row = get_byte_row_jpeg;
+        source->pub.get_byte_rows = NULL;
+        source->pub.count_pages = NULL;
     }
 
     /* return the reference to initialised parameter structure */
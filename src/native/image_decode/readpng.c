@@ -23,10 +23,63 @@ typedef struct _png_source_struct * png_source_ptr;
 typedef struct _png_source_struct {
     struct param pub;                /* public fields */
     int current_row;                 /* current row that we should be returning */
-    png_bytep *row_pointers;      /* entire image held in memory */
+    png_structp png_ptr;             /* libpng read state */
+    png_infop info_ptr;              /* libpng image information */
+    png_uint_32 row_bytes;           /* bytes in one decoded row */
+    png_bytep row;                   /* reusable row, if not interlaced */
+    png_bytep *row_pointers;         /* rows of an interlaced image, held */
+                                     /* in the same block as the pixels */
 } png_source_struct;
 
 
+/*
+ * Read function handed to libpng. Pulls the requested number of bytes
+ * out of our data source.
+ */
+static void read_data (png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    DataSource src = (DataSource) png_get_io_ptr(png_ptr);
+
+    if (src_read(src, data, length) != length)
+        png_error(png_ptr, "Read Error");
+}
+
+/*
+ * Decode the next row of the image and return it, or NULL on error.
+ * Rows of a non-interlaced image are decoded as they are asked for into
+ * dest, or the reusable row buffer if dest is NULL. An interlaced image
+ * has been decoded in full already, so its row is just handed back.
+ */
+static png_bytep next_row (png_source_ptr source, png_bytep dest)
+{
+    png_bytep row;
+
+    if (source->pub.error)
+        return NULL;
+
+    if (source->row_pointers != NULL) {
+        row = source->row_pointers[source->current_row];
+    }
+    else {
+        row = (dest != NULL) ? dest : source->row;
+
+        /* libpng jumps back here on errors in the compressed data */
+        if (setjmp(source->png_ptr->jmpbuf)) {
+            strncpy(source->pub.error_msg, "Error reading input stream", ERROR_LEN);
+            source->pub.error_msg[ERROR_LEN-1] = '\0';
+            source->pub.error = JNI_TRUE;
+            return NULL;
+        }
+
+        png_read_row(source->png_ptr, row, NULL);
+    }
+
+    /* increment our row count */
+    source->current_row++;
+
+    return row;
+}
+
 /*
  * Read one row of pixels.
  * The row of pixel data is copied into params->buffer
@@ -40,9 +93,11 @@ static void get_row_gray (Parameters params)
 
     png_source_ptr source = (png_source_ptr) params;
 
-    data = source->pub.buffer;
-    active_row = source->row_pointers[source->current_row];
+    active_row = next_row(source, NULL);
+    if (active_row == NULL)
+        return;
 
+    data = source->pub.buffer;
     ptr = active_row;
 
     /* put each pixel into the buffer to send back to java */
@@ -61,12 +116,6 @@ This is for 16 bit pixels
 */
     }
 
-    /* free each row as we go */
-    free(active_row);
-    source->row_pointers[source->current_row] = NULL;
-
-    /* increment our row count */
-    source->current_row++;
 }
 
 static void get_row_gray_a (Parameters params)
@@ -79,9 +128,11 @@ static void get_row_gray_a (Parameters params)
 
     png_source_ptr source = (png_source_ptr) params;
 
-    data = source->pub.buffer;
-    active_row = source->row_pointers[source->current_row];
+    active_row = next_row(source, NULL);
+    if (active_row == NULL)
+        return;
 
+    data = source->pub.buffer;
     ptr = active_row;
 
     /* put each pixel into the buffer to send back to java */
@@ -108,12 +159,6 @@ This is for 16 bit pixels
 */
     }
 
-    /* free each row as we go */
-    free(active_row);
-    source->row_pointers[source->current_row] = NULL;
-
-    /* increment our row count */
-    source->current_row++;
 }
 
 static void get_row_rgb (Parameters params)
@@ -126,9 +171,11 @@ static void get_row_rgb (Parameters params)
 
     png_source_ptr source = (png_source_ptr) params;
 
-    data = source->pub.buffer;
-    active_row = source->row_pointers[source->current_row];
+    active_row = next_row(source, NULL);
+    if (active_row == NULL)
+        return;
 
+    data = source->pub.buffer;
     ptr = active_row;
 
     /* put each pixel into the buffer to send back to java */
@@ -156,12 +203,6 @@ This is for 16 bit pixels
 */
     }
 
-    /* free each row as we go */
-    free(active_row);
-    source->row_pointers[source->current_row] = NULL;
-
-    /* increment our row count */
-    source->current_row++;
 }
 
 static void get_row_rgba (Parameters params)
@@ -174,9 +215,11 @@ static void get_row_rgba (Parameters params)
 
     png_source_ptr source = (png_source_ptr) params;
 
-    data = source->pub.buffer;
-    active_row = source->row_pointers[source->current_row];
+    active_row = next_row(source, NULL);
+    if (active_row == NULL)
+        return;
 
+    data = source->pub.buffer;
     ptr = active_row;
 
     /* put each pixel into the buffer to send back to java */
@@ -205,12 +248,30 @@ This is for 16 bit pixels
 */
     }
 
-    /* free each row as we go */
-    free(active_row);
-    source->row_pointers[source->current_row] = NULL;
+}
 
-    /* increment our row count */
-    source->current_row++;
+/*
+ * Read one row of pixels as packed bytes.
+ * libpng has already expanded the row to the component layout we
+ * return, so a streamed row is decoded straight into dest.
+ */
+static void get_byte_row_png (Parameters params, U_CHAR *dest)
+{
+    png_bytep active_row;
+
+    png_source_ptr source = (png_source_ptr) params;
+
+    if (source->row_pointers == NULL &&
+        source->row_bytes == (png_uint_32) (source->pub.width *
+                                            source->pub.numComponents)) {
+        (void) next_row(source, (png_bytep) dest);
+    }
+    else {
+        active_row = next_row(source, NULL);
+        if (active_row != NULL)
+            memcpy(dest, active_row,
+                   source->pub.width * source->pub.numComponents);
+    }
 }
 
 #define ERREXIT(str) \
@@ -218,6 +279,84 @@ This is for 16 bit pixels
                   source->pub.error_msg[ERROR_LEN-1] = '\0'; \
                   source->pub.error = JNI_TRUE; \
                   return;
+
+/*
+ * Work out how many components we return for the given colour type.
+ * Images with a tRNS chunk are expanded to carry an alpha channel.
+ */
+static int png_components (int color_type, int has_transparency)
+{
+    switch (color_type) {
+        case PNG_COLOR_TYPE_GRAY:
+            return has_transparency ? 2 : 1;
+
+        case PNG_COLOR_TYPE_GRAY_ALPHA:
+            return 2;
+
+        case PNG_COLOR_TYPE_RGB:
+            return has_transparency ? 4 : 3;
+
+        case PNG_COLOR_TYPE_RGB_ALPHA:
+        case PNG_COLOR_TYPE_PALETTE:
+        default:
+            return 4;
+    }
+}
+
+/*
+ * Read the file header only; return image size without decoding.
+ * Only the chunks before the first IDAT are read.
+ */
+static void read_header_png (Parameters params)
+{
+    png_source_ptr source = (png_source_ptr) params;
+    png_structp png_ptr;
+    png_infop info_ptr;
+    png_uint_32 width, height;
+    int bit_depth, color_type, interlace_type;
+    int has_transparency;
+
+    /* Allocate read structure */
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL,
+                                                (png_error_ptr)NULL, (png_error_ptr)NULL);
+
+    /* couldn't allocate and initialize */
+    if (png_ptr == NULL) {
+        ERREXIT("Out of memory");
+    }
+
+    /* Allocate/initialize the memory for image information. */
+    info_ptr = png_create_info_struct(png_ptr);
+    if (info_ptr == NULL) {
+        png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+        ERREXIT("Out of memory");
+    }
+
+    if (setjmp(png_ptr->jmpbuf)) {
+        /* Free all of the memory associated with the png_ptr and info_ptr */
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        ERREXIT("Error reading input stream");
+    }
+
+    /* Set up the input control to read from our data source */
+    png_set_read_fn(png_ptr, (png_voidp) source->pub.src, read_data);
+
+    png_read_info(png_ptr, info_ptr);
+
+    png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type,
+                     &interlace_type, NULL, NULL);
+
+    has_transparency = png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) != 0;
+
+    source->pub.width = (int) width;
+    source->pub.height = (int) height;
+    source->pub.numComponents = png_components(color_type, has_transparency);
+    source->pub.bitDepth = bit_depth;
+    source->pub.interlaced = (interlace_type != PNG_INTERLACE_NONE);
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+}
+
 /*
  * Read the file header; return image size
  */
@@ -228,8 +367,8 @@ static void start_input_png (Parameters params)
     png_infop info_ptr;
     png_uint_32 width, height;
     int bit_depth, color_type, interlace_type;
-    png_uint_32 row, i;
-    int fail;
+    png_uint_32 row;
+    png_bytep pixels;
 
     /* Allocate read structure */
     png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL,
@@ -251,14 +390,16 @@ static void start_input_png (Parameters params)
      * the normal method of doing things with libpng).  REQUIRED unless you
      * set up your own error handlers in the png_create_read_struct() earlier.
      */
+    /* From here on finish_input_png frees the read and info structs */
+    source->png_ptr = png_ptr;
+    source->info_ptr = info_ptr;
+
     if (setjmp(png_ptr->jmpbuf)) {
-        /* Free all of the memory associated with the png_ptr and info_ptr */
-        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
         ERREXIT("Error reading input stream");
     }
 
-    /* Set up the input control if you are using standard C streams */
-    png_init_io(png_ptr, source->pub.fptr);
+    /* Set up the input control to read from our data source */
+    png_set_read_fn(png_ptr, (png_voidp) source->pub.src, read_data);
 
     /* The call to png_read_info() gives us all of the information from the
      * PNG file before the first IDAT (image data chunk).  REQUIRED
@@ -288,48 +429,36 @@ static void start_input_png (Parameters params)
     if (bit_depth == 16)
         png_set_strip_16(png_ptr);
 
-    switch (color_type) {
-        case PNG_COLOR_TYPE_GRAY:
-            if (has_transparency) {
-				source->pub.numComponents = 2;
-				source->pub.get_pixel_row = get_row_gray_a;
-			} else {
-				source->pub.numComponents = 1;
-				source->pub.get_pixel_row = get_row_gray;
-			}
+    source->pub.numComponents = png_components(color_type, has_transparency);
 
-            if(bit_depth < 8)
-                png_set_expand(png_ptr);
-
-			// Alan: Causes the decode to crash?
-            //png_set_filler(png_ptr, 255, PNG_FILLER_AFTER);
+    switch (source->pub.numComponents) {
+        case 1:
+            source->pub.get_pixel_row = get_row_gray;
             break;
 
-        case PNG_COLOR_TYPE_GRAY_ALPHA:
-            source->pub.numComponents = 2;
+        case 2:
             source->pub.get_pixel_row = get_row_gray_a;
             break;
 
-        case PNG_COLOR_TYPE_RGB:
-			if (has_transparency) {
-	            source->pub.numComponents = 4;
-	            source->pub.get_pixel_row = get_row_rgba;
-	        } else {
-	            source->pub.numComponents = 3;
-	            source->pub.get_pixel_row = get_row_rgb;
-			}
-
+        case 3:
+            source->pub.get_pixel_row = get_row_rgb;
             break;
 
-        case PNG_COLOR_TYPE_RGB_ALPHA:
-            source->pub.numComponents = 4;
+        default:
             source->pub.get_pixel_row = get_row_rgba;
             break;
+    }
 
-        case PNG_COLOR_TYPE_PALETTE:
-            source->pub.numComponents = 4;
-            source->pub.get_pixel_row = get_row_rgba;
+    switch (color_type) {
+        case PNG_COLOR_TYPE_GRAY:
+            if(bit_depth < 8)
+                png_set_expand(png_ptr);
 
+			// Alan: Causes the decode to crash?
+            //png_set_filler(png_ptr, 255, PNG_FILLER_AFTER);
+            break;
+
+        case PNG_COLOR_TYPE_PALETTE:
             /* Expand paletted colors into true RGB triplets */
             if (bit_depth <= 8)
                 png_set_expand(png_ptr);
@@ -341,56 +470,49 @@ static void start_input_png (Parameters params)
 	// Alan: Wasn't here,is it needed?
 	png_read_update_info(png_ptr, info_ptr);
 
-    /* Allocate the memory to hold the image using the fields of info_ptr. */
-
-    fail = JNI_FALSE;     /* JNI defines TRUE/FALSE so we may as well use if */
-
-    /* Allocate space for row pointers */
-    source->row_pointers = (png_bytep *) malloc (height * sizeof(png_bytep));
+    source->row_bytes = png_get_rowbytes(png_ptr, info_ptr);
 
-    /* Allocate the individual rows */
-    if (source->row_pointers) {
-        row = 0;
-        while((!fail && (row < height))) {
-            /* allocate one byte for each of the 4 components for this row */
-            source->row_pointers[row] =
-                (png_bytep) malloc(width * source->pub.numComponents);
-
-            /* check to make sure memory allocation suceeded */
-            if (source->row_pointers[row] == NULL) {
-                for(i=0; i<row; i++)
-                    free(source->row_pointers[i]);
-                free(source->row_pointers);
-
-                fail = JNI_TRUE;
-            }
-            else
-                row++;
+    if (interlace_type == PNG_INTERLACE_NONE) {
+        /* Rows are decoded one at a time as they are asked for */
+        source->row = (png_bytep) malloc(source->row_bytes);
+        if (source->row == NULL) {
+            ERREXIT("Out of memory");
         }
     }
-    else
-        fail = JNI_TRUE;
-
-    if (fail) {
-        /* Free all of the memory associated with the png_ptr and info_ptr */
-        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
-        ERREXIT("Out of memory");
-    }
+    else {
+        /* libpng needs the whole image to put the passes back together. */
+        /* Hold it in one block, with the row pointers at the front. */
+        /* A block too big to count in a size_t can't be had either. */
+        if (height == 0 ||
+            (size_t) source->row_bytes + sizeof(png_bytep) >
+            ((size_t) -1) / height) {
+            ERREXIT("Out of memory");
+        }
+        source->row_pointers = (png_bytep *) malloc((size_t) height *
+            (sizeof(png_bytep) + (size_t) source->row_bytes));
+        if (source->row_pointers == NULL) {
+            ERREXIT("Out of memory");
+        }
 
-    /* Read the entire image in one go */
-    png_read_image(png_ptr, source->row_pointers);
+        pixels = (png_bytep) (source->row_pointers + height);
+        for (row = 0; row < height; row++)
+            source->row_pointers[row] =
+                pixels + (size_t) row * source->row_bytes;
 
-    /* read rest of file, and get additional chunks in info_ptr - REQUIRED */
-    png_read_end(png_ptr, info_ptr);
+        /* Read the entire image in one go */
+        png_read_image(png_ptr, source->row_pointers);
 
-    /* clean up after the read, and free any memory allocated - REQUIRED */
-    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+        /* read rest of file, and get additional chunks in info_ptr */
+        png_read_end(png_ptr, info_ptr);
+    }
 
     source->current_row = 0;
 
     /* set image width and height */
     source->pub.width = (int) width;
     source->pub.height = (int) height;
+    source->pub.bitDepth = bit_depth;
+    source->pub.interlaced = (interlace_type != PNG_INTERLACE_NONE);
 }
 
 
@@ -400,18 +522,20 @@ static void start_input_png (Parameters params)
 static void finish_input_png (Parameters params)
 {
     png_source_ptr source = (png_source_ptr) params;
-    int i;
 
-    /* free allocated memory */
+    /* clean up after the read, and free any memory allocated */
+    if (source->png_ptr != NULL)
+        png_destroy_read_struct(&source->png_ptr, &source->info_ptr,
+                                (png_infopp)NULL);
+    source->png_ptr = NULL;
+    source->info_ptr = NULL;
 
-    /* Each row should be freed as it is read, so this is here to */
-    /* free memory if an error occurs and each row is not read */
-    for(i=0; i<source->pub.height; i++) {
-        if (source->row_pointers[i] != NULL)
-            free(source->row_pointers[i]);
-    }
+    free(source->row);
+    source->row = NULL;
 
+    /* the pixels of an interlaced image share this block */
     free(source->row_pointers);
+    source->row_pointers = NULL;
 }
 
 
@@ -429,21 +553,31 @@ Parameters png_init ()
 
     if (source != NULL) {
         /* Initialise structure */
-        source->pub.fptr = NULL;
+        source->pub.src = NULL;
         source->pub.width = -1;
         source->pub.height = -1;
         source->pub.numComponents = 3;
+        source->pub.bitDepth = 8;
+        source->pub.interlaced = JNI_FALSE;
         source->pub.buffer = NULL;
         source->pub.row_num = 0;
         source->pub.error = JNI_FALSE;
         source->pub.error_msg[0] = '\0';
 
         source->current_row = 0;
+        source->png_ptr = NULL;
+        source->info_ptr = NULL;
+        source->row_bytes = 0;
+        source->row = NULL;
         source->row_pointers = NULL;
 
         /* Fill in method ptrs */
+        source->pub.read_header = read_header_png;
         source->pub.start_input = start_input_png;
         source->pub.finish_input = finish_input_png;
+        source->pub.get_byte_row = get_byte_row_png;
+        source->pub.get_byte_rows = NULL;
+        source->pub.count_pages = NULL;
     }
 
     /* return the reference to initialised parameter structure */
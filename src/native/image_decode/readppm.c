@@ -29,6 +29,21 @@
 /* Error strings */
 #define ERR_PPM_NONNUMERIC "Nonnumeric data in PPM file"
 #define ERR_PPM_NOT "Not a PPM file"
+#define ERR_PPM_RANGE "Sample value larger than maxval in PPM file"
+
+/* Classes of character in text-format files */
+#define CLASS_OTHER 0
+#define CLASS_DIGIT 1
+#define CLASS_SPACE 2
+#define CLASS_COMMENT 3
+
+/* Where the text-format parser is between characters */
+#define TEXT_SPACE 0
+#define TEXT_NUMBER 1
+#define TEXT_COMMENT 2
+
+/* Number of full range word samples scaled together */
+#define RAW_BLOCK 16
 
 #define ERREXIT(str) { \
                   strncpy(source->pub.error_msg, str, ERROR_LEN); \
@@ -42,6 +57,12 @@
                   source->pub.error = JNI_TRUE; \
                   return 1; }
 
+#define ERREXIT_NULL(str) { \
+                  strncpy(source->pub.error_msg, str, ERROR_LEN); \
+                  source->pub.error_msg[ERROR_LEN-1] = '\0'; \
+                  source->pub.error = JNI_TRUE; \
+                  return NULL; }
+
 /*
  * On most systems, reading individual bytes with getc() is drastically less
  * efficient than buffering a row at a time with fread().  On PCs, we must
@@ -60,7 +81,12 @@ typedef struct {
 
     U_CHAR *iobuffer;                /* non-FAR pointer to I/O buffer */
     size_t buffer_width;            /* width of I/O buffer */
+    U_CHAR *samples;                 /* row of raw samples rescaled */
+                                     /* to 8 bits, or NULL */
     U_CHAR *rescale;                 /* => maxval-remapping array, or NULL */
+    int format;                      /* format discriminator after the 'P' */
+    int maxval;                      /* largest sample value */
+    U_CHAR char_class[256];          /* CLASS_* of each text character */
 } ppm_source_struct;
 
 typedef ppm_source_struct * ppm_source_ptr;
@@ -71,13 +97,13 @@ typedef ppm_source_struct * ppm_source_ptr;
  */
 static int pbm_getc (ppm_source_ptr source)
 {
-    register FILE *infile = source->pub.fptr;
+    register DataSource infile = source->pub.src;
     register int ch;
 
-    ch = getc(infile);
+    ch = SRC_GETC(infile);
     if (ch == '#') {
         do {
-            ch = getc(infile);
+            ch = SRC_GETC(infile);
         } while (ch != '\n' && ch != EOF);
     }
     return ch;
@@ -92,7 +118,7 @@ static int pbm_getc (ppm_source_ptr source)
  */
 static unsigned int read_pbm_integer (ppm_source_ptr source)
 {
-    register FILE *infile = source->pub.fptr;
+    register DataSource infile = source->pub.src;
     register int ch;
     register unsigned int val;
 
@@ -115,6 +141,177 @@ static unsigned int read_pbm_integer (ppm_source_ptr source)
 }
 
 
+/*
+ * Build the table of character classes used to parse text-format files.
+ * Whitespace is the same set that read_pbm_integer skips.
+ */
+static void build_char_class (ppm_source_ptr source)
+{
+    int ch;
+
+    memset(source->char_class, CLASS_OTHER, sizeof(source->char_class));
+
+    for (ch = '0'; ch <= '9'; ch++)
+        source->char_class[ch] = CLASS_DIGIT;
+
+    source->char_class[' '] = CLASS_SPACE;
+    source->char_class['\t'] = CLASS_SPACE;
+    source->char_class['\n'] = CLASS_SPACE;
+    source->char_class['\r'] = CLASS_SPACE;
+    source->char_class['#'] = CLASS_COMMENT;
+}
+
+
+/*
+ * Parse the digits at the start of 4 bytes of text without testing them
+ * one at a time. The 4 bytes are taken as one word, a digit mask for all
+ * of them is made in one go, and the digits found are combined pairwise
+ * into the value. Returns the number of leading digits, 1 - 4, with val
+ * set to their value. The first byte must be a digit.
+ */
+static int parse_digits (const U_CHAR *inptr, unsigned int *val)
+{
+    /* Index of the lowest set bit of a 4 bit mask, 4 if none */
+    static const U_CHAR first_set[16] = {
+        4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+    };
+    unsigned int word, mask;
+    int len;
+
+    /* Flip the '0' bits off, so the digits become 0 - 9 */
+    word = ((unsigned int) inptr[0] | ((unsigned int) inptr[1] << 8) |
+            ((unsigned int) inptr[2] << 16) | ((unsigned int) inptr[3] << 24))
+           ^ 0x30303030;
+
+    /* Top bit of each byte set if it is not a digit, without carries */
+    mask = (((word & 0x7F7F7F7F) + 0x76767676) | word) & 0x80808080;
+    mask >>= 7;
+    len = first_set[(mask | (mask >> 7) | (mask >> 14) | (mask >> 21)) & 0xF];
+
+    /* Move the digits to the top, leaving leading zeros below them */
+    word = (word << ((4 - len) * 8)) & 0x0F0F0F0F;
+    word = ((word * 10) + (word >> 8)) & 0x00FF00FF;
+    *val = ((word * 100) + (word >> 16)) & 0xFFFF;
+
+    return len;
+}
+
+
+/*
+ * Parse count text-format samples straight into out, passing each one
+ * through the maxval rescale table.
+ *
+ * Rather than going a character at a time through pbm_getc, this scans the
+ * source's buffer directly a block at a time, using the character class
+ * table to tell whitespace and comments apart and parse_digits to read
+ * numbers of up to 3 digits in one step. Comments are skipped with one
+ * memchr for the end of line. A number or comment that is split across two
+ * blocks is carried over to the next block, so the parse is the same whether
+ * the data is in memory or coming off a stream. Sets the error flag on bad
+ * data.
+ */
+static void read_text_samples (ppm_source_ptr source, U_CHAR *out, int count)
+{
+    DataSource src = source->pub.src;
+    const U_CHAR *char_class = source->char_class;
+    const U_CHAR *rescale = source->rescale;
+    unsigned int maxval = (unsigned int) source->maxval;
+    const U_CHAR *inptr;
+    const U_CHAR *inend;
+    const U_CHAR *eol;
+    unsigned int val = 0;
+    int state = TEXT_SPACE;
+    int len;
+    int n = 0;
+
+    while (n < count) {
+        if (src->bytes_left == 0 && !src_fill(src)) {
+            /* The end of the data also ends a number */
+            if (state == TEXT_NUMBER && n == count - 1) {
+                if (val > maxval)
+                    ERREXIT(ERR_PPM_RANGE);
+
+                out[n] = rescale[val];
+                return;
+            }
+
+            ERREXIT(ERR_INPUT_EOF);
+        }
+
+        inptr = src->next_byte;
+        inend = inptr + src->bytes_left;
+
+        while (inptr < inend && n < count) {
+            switch (state == TEXT_SPACE ? char_class[*inptr] : CLASS_OTHER) {
+                case CLASS_SPACE:
+                    inptr++;
+                    continue;
+
+                case CLASS_DIGIT:
+                    if (inend - inptr < 4) {
+                        /* Too near the end of the block to look ahead */
+                        val = *inptr++ - '0';
+                        state = TEXT_NUMBER;
+                        continue;
+                    }
+
+                    len = parse_digits(inptr, &val);
+                    inptr += len;
+
+                    if (len == 4) {
+                        /* Long number, the rest is read one at a time */
+                        state = TEXT_NUMBER;
+                        continue;
+                    }
+
+                    if (val > maxval)
+                        ERREXIT(ERR_PPM_RANGE);
+
+                    out[n++] = rescale[val];
+                    continue;
+
+                case CLASS_COMMENT:
+                    inptr++;
+                    state = TEXT_COMMENT;
+                    continue;
+
+                case CLASS_OTHER:
+                    break;
+            }
+
+            if (state == TEXT_NUMBER) {
+                while (inptr < inend && char_class[*inptr] == CLASS_DIGIT) {
+                    val = val * 10 + (*inptr++ - '0');
+                    if (val > maxval)
+                        ERREXIT(ERR_PPM_RANGE);
+                }
+
+                if (inptr < inend) {
+                    if (val > maxval)
+                        ERREXIT(ERR_PPM_RANGE);
+
+                    out[n++] = rescale[val];
+                    state = TEXT_SPACE;
+                }
+            } else if (state == TEXT_COMMENT) {
+                eol = (const U_CHAR *) memchr(inptr, '\n', inend - inptr);
+                if (eol == NULL) {
+                    inptr = inend;
+                } else {
+                    inptr = eol + 1;
+                    state = TEXT_SPACE;
+                }
+            } else {
+                ERREXIT(ERR_PPM_NONNUMERIC);
+            }
+        }
+
+        src->bytes_left -= inptr - src->next_byte;
+        src->next_byte = inptr;
+    }
+}
+
+
 /*
  * Read one row of pixels.
  *
@@ -127,20 +324,20 @@ static unsigned int read_pbm_integer (ppm_source_ptr source)
 static void get_text_gray_row (Parameters params)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
-    register U_CHAR *rescale = source->rescale;
+    register U_CHAR *bufferptr;
     register int i;
     jint *data;
-    U_CHAR tmp;
+
+    read_text_samples(source, source->iobuffer, source->pub.width);
+    if (source->pub.error)
+        return;
 
     data = source->pub.buffer;
 
-    /* put each pixel into the buffer to send back to java */
+    bufferptr = source->iobuffer;
     for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-
         /* Required to return data in G format */
-        data[i] = (jint) rescale[read_pbm_integer(source)];
+        data[i] = (jint) *bufferptr++;
     }
 }
 
@@ -151,21 +348,22 @@ static void get_text_gray_row (Parameters params)
 static void get_text_rgb_row (Parameters params)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
-    register U_CHAR *rescale = source->rescale;
+    register U_CHAR *bufferptr;
     register int i;
     jint *data;
     jint r, g, b;
 
+    read_text_samples(source, source->iobuffer, source->pub.width * 3);
+    if (source->pub.error)
+        return;
+
     data = source->pub.buffer;
 
-    /* put each pixel into the buffer to send back to java */
+    bufferptr = source->iobuffer;
     for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-
-        r = (jint) rescale[read_pbm_integer(source)];
-        g = (jint) rescale[read_pbm_integer(source)];
-        b = (jint) rescale[read_pbm_integer(source)];
+        r = (jint) *bufferptr++;
+        g = (jint) *bufferptr++;
+        b = (jint) *bufferptr++;
 
         /* Required to return data in RGB format */
         data[i] = (r << 16) + (g << 8) + b;
@@ -174,204 +372,317 @@ static void get_text_rgb_row (Parameters params)
 
 
 /*
- * This version is for reading raw-byte-format PGM files with any maxval
+ * Packed bytes version for text-format files. The rescaled samples are
+ * already in the G or RGB byte order wanted, so parse them straight into
+ * the destination.
  */
-static void get_scaled_gray_row (Parameters params)
+static void get_text_byte_row (Parameters params, U_CHAR *dest)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
-    register U_CHAR * bufferptr;
-    register U_CHAR *rescale = source->rescale;
+
+    read_text_samples(source, dest,
+                      source->pub.width * source->pub.numComponents);
+}
+
+
+/*
+ * Get the next row of raw samples. A row that is all in the source's buffer,
+ * as it always is when the data is in memory, is used where it lies rather
+ * than being copied. Otherwise the row is read into the I/O buffer. Returns
+ * NULL, with the error set, at the end of the data.
+ */
+static const U_CHAR *next_raw_row (ppm_source_ptr source)
+{
+    DataSource src = source->pub.src;
+    const U_CHAR *row;
+
+    if (src->bytes_left >= source->buffer_width) {
+        row = src->next_byte;
+        src->next_byte += source->buffer_width;
+        src->bytes_left -= source->buffer_width;
+
+        return row;
+    }
+
+    if (! ReadOK(src, source->iobuffer, source->buffer_width))
+        ERREXIT_NULL(ERR_INPUT_EOF);
+
+    return source->iobuffer;
+}
+
+
+/*
+ * Convert count raw samples to 8 bits. Byte samples go through the rescale
+ * table. Word samples are stored most significant byte first. Full range
+ * ones are scaled with the same rounding as the table, but worked out in a
+ * loop of plain arithmetic that the compiler can vectorise. Any other word
+ * samples go through the table.
+ */
+static void convert_raw_samples (ppm_source_ptr source, const U_CHAR *inptr,
+                                 U_CHAR *outptr, int count)
+{
+    register const U_CHAR *rescale = source->rescale;
+    register unsigned int val;
+    register int i, j;
+    unsigned int block[RAW_BLOCK];
+
+    if (source->maxval == 255) {
+        memcpy(outptr, inptr, count);
+    } else if (source->maxval < 255) {
+        for (i = 0; i < count; i++)
+            outptr[i] = rescale[inptr[i]];
+    } else if (source->maxval == 65535) {
+        /* (val*255 + 32767)/65535 without the divide. Samples are done */
+        /* in blocks, all loaded before any are stored, so the compiler */
+        /* knows they can't overlap and will vectorise each block */
+        for (i = 0; i + RAW_BLOCK <= count; i += RAW_BLOCK) {
+            for (j = 0; j < RAW_BLOCK; j++)
+                block[j] = (((unsigned int) inptr[2*(i + j)] << 8) |
+                            inptr[2*(i + j) + 1]) * 255 + 32767;
+
+            for (j = 0; j < RAW_BLOCK; j++)
+                outptr[i + j] =
+                    (U_CHAR) ((block[j] + (block[j] >> 16) + 1) >> 16);
+        }
+
+        for (; i < count; i++) {
+            val = ((unsigned int) inptr[2*i] << 8) | inptr[2*i + 1];
+            val = val * 255 + 32767;
+            outptr[i] = (U_CHAR) ((val + (val >> 16) + 1) >> 16);
+        }
+    } else {
+        for (i = 0; i < count; i++)
+            outptr[i] = rescale[((unsigned int) inptr[2*i] << 8) |
+                                inptr[2*i + 1]];
+    }
+}
+
+
+/*
+ * This version is for reading raw-format PGM files with any maxval
+ */
+static void get_raw_gray_row (Parameters params)
+{
+    ppm_source_ptr source = (ppm_source_ptr) params;
+    register const U_CHAR *bufferptr;
     register int i;
     jint *data;
-    U_CHAR tmp;
 
-    if (! ReadOK(source->pub.fptr, source->iobuffer, source->buffer_width))
-        ERREXIT(ERR_INPUT_EOF);
+    bufferptr = next_raw_row(source);
+    if (bufferptr == NULL)
+        return;
+
+    if (source->maxval != 255) {
+        convert_raw_samples(source, bufferptr, source->samples,
+                            source->pub.width);
+        bufferptr = source->samples;
+    }
 
     data = source->pub.buffer;
 
-    bufferptr = source->iobuffer;
     for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-
         /* Required to return data in G format */
-        data[i] = (jint) rescale[UCH(*bufferptr++)];
+        data[i] = (jint) *bufferptr++;
     }
 }
 
 
 /*
- * This version is for reading raw-byte-format PPM files with any maxval
+ * This version is for reading raw-format PPM files with any maxval
  */
-static void get_scaled_rgb_row (Parameters params)
+static void get_raw_rgb_row (Parameters params)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
-    register U_CHAR * bufferptr;
-    register U_CHAR *rescale = source->rescale;
+    register const U_CHAR *bufferptr;
     register int i;
     jint *data;
     jint r, g, b;
 
-    if (! ReadOK(source->pub.fptr, source->iobuffer, source->buffer_width))
-        ERREXIT(ERR_INPUT_EOF);
+    bufferptr = next_raw_row(source);
+    if (bufferptr == NULL)
+        return;
+
+    if (source->maxval != 255) {
+        convert_raw_samples(source, bufferptr, source->samples,
+                            source->pub.width * 3);
+        bufferptr = source->samples;
+    }
 
     data = source->pub.buffer;
 
-    bufferptr = source->iobuffer;
     for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-        r = (jint) rescale[UCH(*bufferptr++)];
-        g = (jint) rescale[UCH(*bufferptr++)];
-        b = (jint) rescale[UCH(*bufferptr++)];
+        r = (jint) *bufferptr++;
+        g = (jint) *bufferptr++;
+        b = (jint) *bufferptr++;
 
-        /* Required to return data in ARGB format */
+        /* Required to return data in RGB format */
         data[i] = (r << 16) + (g << 8) + b;
     }
 }
 
 
 /*
- * This version is for reading raw-word-format PGM files with any maxval
+ * Packed bytes version for raw-format files. With a maxval of 255 the file
+ * already holds the G or RGB bytes wanted, so they are read straight into
+ * the destination. Other files are converted into it.
  */
-static void get_word_gray_row (Parameters params)
+static void get_raw_byte_row (Parameters params, U_CHAR *dest)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
-    register U_CHAR * bufferptr;
-    register U_CHAR *rescale = source->rescale;
-    register int i;
-    jint *data;
-    jint r, g, b;
-    U_CHAR tmp;
+    const U_CHAR *bufferptr;
 
-    if (! ReadOK(source->pub.fptr, source->iobuffer, source->buffer_width))
-        ERREXIT(ERR_INPUT_EOF);
+    if (source->maxval == 255) {
+        if (! ReadOK(source->pub.src, dest, source->buffer_width))
+            ERREXIT(ERR_INPUT_EOF);
 
-    data = source->pub.buffer;
-     
-    bufferptr = source->iobuffer;
-    for(i = 0; i < source->pub.width; i++) {
-        register int temp;
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-
-        temp  = UCH(*bufferptr++);
-        temp |= UCH(*bufferptr++) << 8;
-        tmp = rescale[temp];
-        r = (jint) tmp;
-        g = (jint) tmp;
-        b = (jint) tmp;
-
-        /* Required to return data in ARGB format */
-        data[i] = (r << 16) + (g << 8) + b;
+        return;
     }
+
+    bufferptr = next_raw_row(source);
+    if (bufferptr == NULL)
+        return;
+
+    convert_raw_samples(source, bufferptr, dest,
+                        source->pub.width * source->pub.numComponents);
 }
 
 
 /*
- * This version is for reading raw-word-format PPM files with any maxval
+ * Several rows at once version of get_raw_byte_row. When the rows are
+ * straight bytes that follow on from each other in the destination, the
+ * lot is read in one go.
  */
-static void get_word_rgb_row (Parameters params)
+static void get_raw_byte_rows (Parameters params, U_CHAR *dest, jint stride,
+                               jint num_rows)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
-    register U_CHAR * bufferptr;
-    register U_CHAR *rescale = source->rescale;
-    register int i;
-    jint *data;
-    jint r, g, b;
+    jint i;
 
-    if (! ReadOK(source->pub.fptr, source->iobuffer, source->buffer_width))
-        ERREXIT(ERR_INPUT_EOF);
+    if (source->maxval == 255 && (size_t) stride == source->buffer_width) {
+        if (! ReadOK(source->pub.src, dest,
+                     source->buffer_width * num_rows))
+            ERREXIT(ERR_INPUT_EOF);
 
-    data = source->pub.buffer;
+        return;
+    }
 
-    bufferptr = source->iobuffer;
-    for(i = 0; i < source->pub.width; i++) {
-        register int temp;
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-        temp  = UCH(*bufferptr++);
-        temp |= UCH(*bufferptr++) << 8;
-        r = (jint) rescale[temp];
-        temp  = UCH(*bufferptr++);
-        temp |= UCH(*bufferptr++) << 8;
-        g = (jint) rescale[temp];
-        temp  = UCH(*bufferptr++);
-        temp |= UCH(*bufferptr++) << 8;
-        b = (jint) rescale[temp];
-
-        /* Required to return data in ARGB format */
-        data[i] = (r << 16) + (g << 8) + b;
+    for (i = 0; i < num_rows && !source->pub.error; i++) {
+        get_raw_byte_row(params, dest);
+        dest += stride;
     }
 }
 
 
 /*
- * Read the file header; return image size and component count.
+ * Read the file header only; return image size and component count.
+ * The image data is left unread.
  */
-static void start_input_ppm (Parameters params)
+static void read_header_ppm (Parameters params)
 {
     ppm_source_ptr source = (ppm_source_ptr) params;
     int c;
     int w, h, maxval;
-    int need_iobuffer, need_rescale;
-    int input_components;
 
-    if (getc(source->pub.fptr) != 'P')
+    if (SRC_GETC(source->pub.src) != 'P')
         ERREXIT(ERR_PPM_NOT);
 
-    c = getc(source->pub.fptr); /* save format discriminator for a sec */
+    c = SRC_GETC(source->pub.src); /* save format discriminator for a sec */
 
     /* fetch the remaining header info */
     w = read_pbm_integer(source);
     h = read_pbm_integer(source);
     maxval = read_pbm_integer(source);
 
-    if (w <= 0 || h <= 0 || maxval <= 0) /* error check */
+    if (w <= 0 || h <= 0 || maxval <= 0 || maxval > 65535) /* error check */
         ERREXIT(ERR_PPM_NOT);
 
+    switch (c) {
+        case '2':                                /* text-format PGM file */
+        case '5':                                /* raw-format PGM file */
+            source->pub.numComponents = 1;
+            break;
+
+        case '3':                                /* text-format PPM file */
+        case '6':                                /* raw-format PPM file */
+            source->pub.numComponents = 3;
+            break;
+
+        default:
+            ERREXIT(ERR_PPM_NOT);
+            break;
+    }
+
+    source->format = c;
+    source->maxval = maxval;
+
     source->pub.width = (int) w;
     source->pub.height = (int) h;
 
+    /* bits needed to hold the largest sample value */
+    source->pub.bitDepth = 0;
+    while (maxval > 0) {
+        source->pub.bitDepth++;
+        maxval >>= 1;
+    }
+}
+
+
+/*
+ * Read the file header; return image size and component count.
+ */
+static void start_input_ppm (Parameters params)
+{
+    ppm_source_ptr source = (ppm_source_ptr) params;
+    int c;
+    int w, maxval;
+    int need_iobuffer, need_rescale;
+    int input_components;
+    size_t sample_size;
+
+    read_header_ppm(params);
+    if (source->pub.error)
+        return;
+
+    c = source->format;
+    w = source->pub.width;
+    maxval = source->maxval;
+
     /* initialize flags to most common settings */
     need_iobuffer = JNI_TRUE;                     /* do we need an I/O buffer? */
     need_rescale = JNI_TRUE;                      /* do we need a rescale array? */
+    sample_size = (maxval <= 255) ? 1 : 2;        /* bytes per buffered sample */
 
     switch (c) {
         case '2':                                /* it's a text-format PGM file */
             input_components = 1;
             source->pub.numComponents = 1;
             source->pub.get_pixel_row = get_text_gray_row;
-            need_iobuffer = JNI_FALSE;
+            source->pub.get_byte_row = get_text_byte_row;
+            sample_size = 1;              /* held after rescaling */
             break;
 
         case '3':                                /* it's a text-format PPM file */
             input_components = 3;
             source->pub.numComponents = 3;
             source->pub.get_pixel_row = get_text_rgb_row;
-            need_iobuffer = JNI_FALSE;
+            source->pub.get_byte_row = get_text_byte_row;
+            sample_size = 1;              /* held after rescaling */
             break;
 
         case '5':                                /* it's a raw-format PGM file */
             input_components = 1;
             source->pub.numComponents = 1;
-            if (maxval > 255) {
-                source->pub.get_pixel_row = get_word_gray_row;
-            } else {
-                source->pub.get_pixel_row = get_scaled_gray_row;
-
-            }
+            source->pub.get_pixel_row = get_raw_gray_row;
+            source->pub.get_byte_row = get_raw_byte_row;
+            source->pub.get_byte_rows = get_raw_byte_rows;
             break;
 
         case '6':                                /* it's a raw-format PPM file */
             input_components = 3;
             source->pub.numComponents = 3;
-            if (maxval > 255) {
-                source->pub.get_pixel_row = get_word_rgb_row;
-            } else {
-                source->pub.get_pixel_row = get_scaled_rgb_row;
-            }
+            source->pub.get_pixel_row = get_raw_rgb_row;
+            source->pub.get_byte_row = get_raw_byte_row;
+            source->pub.get_byte_rows = get_raw_byte_rows;
             break;
 
         default:
@@ -379,10 +690,13 @@ static void start_input_ppm (Parameters params)
             break;
     }
 
+    /* Text-format files are parsed using the character class table */
+    if (c == '2' || c == '3')
+        build_char_class(source);
+
     /* Allocate space for I/O buffer: 1 or 3 bytes or words/pixel. */
     if (need_iobuffer) {
-        source->buffer_width = (size_t) w * input_components *
-      ((maxval<=255) ? sizeof(U_CHAR) : (2*sizeof(U_CHAR)));
+        source->buffer_width = (size_t) w * input_components * sample_size;
 
         source->iobuffer = (U_CHAR *)
                                     malloc(source->buffer_width * sizeof(U_CHAR));
@@ -390,26 +704,34 @@ static void start_input_ppm (Parameters params)
             ERREXIT(ERR_OUT_OF_MEMORY);
     }
 
+    /* Raw samples that need scaling are converted a row at a time */
+    if ((c == '5' || c == '6') && maxval != 255) {
+        source->samples = (U_CHAR *) malloc((size_t) w * input_components);
+        if (!source->samples)
+            ERREXIT(ERR_OUT_OF_MEMORY);
+    }
+
     /* Compute the rescaling array if required. */
     if (need_rescale) {
-        int val, half_maxval;
+        int val, half_maxval, rescale_size;
 
-        /* On 16-bit-int machines we have to be careful of maxval = 65535 */
-        source->rescale = (U_CHAR *) malloc (maxval+1 * sizeof (U_CHAR));
+        /* Cover every value a sample can hold, so that raw samples */
+        /* over maxval can't read off the end. They come out as 255. */
+        rescale_size = (maxval <= 255) ? 256 : 65536;
+        source->rescale = (U_CHAR *) malloc (rescale_size * sizeof (U_CHAR));
 
         /* check memory allocation */
-        if (!source->rescale) {
-            if (source->iobuffer)
-                free(source->iobuffer);
-
+        if (!source->rescale)
             ERREXIT(ERR_OUT_OF_MEMORY);
-        }
 
         half_maxval = maxval / 2;
         for (val = 0; val <= maxval; val++) {
             /* The multiplication here must be done in 32 bits to avoid overflow */
             source->rescale[val] = (U_CHAR) ((val*255 + half_maxval)/maxval);
         }
+
+        for (; val < rescale_size; val++)
+            source->rescale[val] = 255;
     }
 }
 
@@ -428,6 +750,10 @@ static void finish_input_ppm (Parameters params)
     /* free io buffer */
     if (source->iobuffer)
         free(source->iobuffer);
+
+    /* free rescaled sample row */
+    if (source->samples)
+        free(source->samples);
 }
 
 
@@ -445,10 +771,12 @@ Parameters ppm_init ()
 
     if (source != NULL) {
         /* Initialise structure */
-        source->pub.fptr = NULL;
+        source->pub.src = NULL;
         source->pub.width = -1;
         source->pub.height = -1;
         source->pub.numComponents = 3;
+        source->pub.bitDepth = 8;
+        source->pub.interlaced = JNI_FALSE;
         source->pub.buffer = NULL;
         source->pub.row_num = 0;
         source->pub.error = JNI_FALSE;
@@ -456,11 +784,18 @@ Parameters ppm_init ()
 
         source->iobuffer = NULL;
         source->buffer_width = 0;
+        source->samples = NULL;
         source->rescale = NULL;
+        source->format = 0;
+        source->maxval = 0;
 
         /* Fill in method ptrs, except get_pixel_row which start_input sets */
+        source->pub.read_header = read_header_ppm;
         source->pub.start_input = start_input_ppm;
         source->pub.finish_input = finish_input_ppm;
+        source->pub.get_byte_row = NULL;
+        source->pub.get_byte_rows = NULL;
+        source->pub.count_pages = NULL;
     }
 
     /* return the reference to initialised parameter structure */
@@ -32,12 +32,6 @@
                   source->pub.error = JNI_TRUE; \
                   return; }
 
-#define ERREXIT_RET(str) { \
-                  strncpy(source->pub.error_msg, str, ERROR_LEN); \
-                  source->pub.error_msg[ERROR_LEN-1] = '\0'; \
-                  source->pub.error = JNI_TRUE; \
-                  return 1; }
-
 /* Private version of data source object */
 
 typedef struct _tga_source_struct * tga_source_ptr;
@@ -45,25 +39,35 @@ typedef struct _tga_source_struct * tga_source_ptr;
 typedef struct _tga_source_struct {
     struct param pub;      /* public fields */
 
-    U_CHAR **colormap;     /* Targa colormap (converted to my format) */
+    jint colormap[256];    /* Targa colormap as RGB pixels */
 
-    jint **whole_image;    /* Needed if funny input row order */
+    const U_CHAR *image_data;  /* whole image as stored, or NULL if the */
+                               /* rows are read as they are needed */
+    U_CHAR *image_copy;    /* image read in or decoded from RLE, or NULL */
+    U_CHAR *row_buffer;    /* one row of pixels read as it is needed */
     int current_row;        /* Current logical row number to read */
 
-    /* Pointer to routine to extract next Targa pixel from input file */
-    void (*read_pixel) (tga_source_ptr source);
-
-    /* Result of read_pixel is delivered here: */
-    U_CHAR tga_pixel[4];
+    int is_rle;             /* TRUE if the pixels are RLE coded */
+    U_CHAR tga_pixel[4];    /* pixel repeated by the current RLE packet */
 
     int pixel_size;         /* Bytes per Targa pixel (1 to 4) */
 
     /* State info for reading RLE-coded pixels; both counts must be init to 0 */
-    int block_count;        /* # of pixels remaining in RLE block */
-    int dup_pixel_count;  /* # of times to duplicate previous pixel */
-
-    /* This saves the correct pixel-row-expansion method for preload_image */
-    void (*get_pixel_row) (Parameters params);
+    int block_count;        /* # of literal pixels left in RLE packet */
+    int dup_pixel_count;  /* # of copies of tga_pixel left in RLE packet */
+
+    /* Converts a row of pixels as stored to ARGB pixels, or packed bytes */
+    void (*convert_row) (tga_source_ptr source, const U_CHAR *inptr, jint *data);
+    void (*convert_bytes) (tga_source_ptr source, const U_CHAR *inptr,
+                           U_CHAR *dest);
+
+    /* Header fields needed once the header itself has been read */
+    int id_length;          /* bytes of ID field following the header */
+    int has_colormap;       /* TRUE if the header promises a colormap */
+    unsigned int map_origin;  /* first colormap entry used */
+    unsigned int map_length;  /* number of colormap entries */
+    int map_entry_size;     /* bits per colormap entry */
+    int is_bottom_up;       /* TRUE if rows are stored bottom up */
 } tga_source_struct;
 
 
@@ -77,88 +81,162 @@ static const short c5to8bits[32] = {
 };
 
 
-/*
- * Read next byte from Targa file
- */
-static int read_byte (tga_source_ptr source)
-{
-    register FILE *infile = source->pub.fptr;
-    register int c;
-
-    if ((c = getc(infile)) == EOF)
-        ERREXIT_RET(ERR_INPUT_EOF);
-    return c;
-}
-
-
 /*
  * Read the colormap from a Targa file
  */
 static void read_colormap (tga_source_ptr source, int cmaplen, int mapentrysize)
 {
+    U_CHAR map[256 * 3];
+    U_CHAR *inptr = map;
+    jint r, g, b;
     int i;
 
     /* Presently only handles 24-bit BGR format */
     if (mapentrysize != 24)
         ERREXIT(ERR_TGA_BADCMAP);
 
-    for (i = 0; i < cmaplen; i++) {
-        source->colormap[2][i] = (U_CHAR) read_byte(source);
-        source->colormap[1][i] = (U_CHAR) read_byte(source);
-        source->colormap[0][i] = (U_CHAR) read_byte(source);
+    if (! ReadOK(source->pub.src, map, cmaplen * 3))
+        ERREXIT(ERR_INPUT_EOF);
+
+    /* indexes past the end of the map give black */
+    for (i = 0; i < 256; i++) {
+        if (i < cmaplen) {
+            b = (jint) *inptr++;
+            g = (jint) *inptr++;
+            r = (jint) *inptr++;
+        }
+        else
+            r = g = b = 0;
+
+        source->colormap[i] = (r << 16) + (g << 8) + b;
     }
 }
 
 
 /*
- * read_pixel methods: get a single pixel from Targa file into tga_pixel[]
- * Read one Targa pixel from the input file; no RLE expansion
+ * Read count pixels from the input file, expanding RLE data as needed.
+ * A repeated pixel is copied out in runs that double in length each
+ * time, and literal pixels are read straight across. Packets carry on
+ * from one call to the next, as they can run over the end of a row.
+ * Returns FALSE at the end of the data.
  */
-static void read_non_rle_pixel (tga_source_ptr source)
+static int read_rle_pixels (tga_source_ptr source, U_CHAR *out_ptr, int count)
 {
-    register FILE *infile = source->pub.fptr;
-    register int i;
+    register DataSource infile = source->pub.src;
+    int pixel_size = source->pixel_size;
+    int i, num_pixels, done, copy;
+
+    while (count > 0) {
+        /* Time to read RLE block header? */
+        if (source->block_count == 0 && source->dup_pixel_count == 0) {
+            if ((i = SRC_GETC(infile)) == EOF)
+                return JNI_FALSE;
+
+            if (i & 0x80) {                       /* duplicate-pixel block */
+                if (! ReadOK(infile, source->tga_pixel, pixel_size))
+                    return JNI_FALSE;
+                source->dup_pixel_count = (i & 0x7F) + 1;
+            } else {
+                source->block_count = (i & 0x7F) + 1;
+            }
+        }
+
+        if (source->dup_pixel_count > 0) {
+            num_pixels = (source->dup_pixel_count < count) ?
+                             source->dup_pixel_count : count;
+
+            if (pixel_size == 1)
+                memset(out_ptr, source->tga_pixel[0], num_pixels);
+            else {
+                memcpy(out_ptr, source->tga_pixel, pixel_size);
+                for (done = 1; done < num_pixels; done += copy) {
+                    copy = (done < num_pixels - done) ? done : num_pixels - done;
+                    memcpy(out_ptr + done * pixel_size, out_ptr, copy * pixel_size);
+                }
+            }
+
+            source->dup_pixel_count -= num_pixels;
+        } else {
+            num_pixels = (source->block_count < count) ?
+                             source->block_count : count;
+
+            if (! ReadOK(infile, out_ptr, num_pixels * pixel_size))
+                return JNI_FALSE;
+
+            source->block_count -= num_pixels;
+        }
 
-    for (i = 0; i < source->pixel_size; i++) {
-        source->tga_pixel[i] = (U_CHAR) getc(infile);
+        out_ptr += num_pixels * pixel_size;
+        count -= num_pixels;
     }
+
+    return JNI_TRUE;
 }
 
 
 /*
- * Read one Targa pixel from the input file, expanding RLE data as needed
+ * Return the next row of pixels as stored in the file, top row first, or
+ * NULL on error. A whole image held in memory is read by row offset.
+ * Otherwise the rows come in top-down order, and are read one at a time.
  */
-static void read_rle_pixel (tga_source_ptr source)
+static const U_CHAR *next_row (tga_source_ptr source)
 {
-    register FILE *infile = source->pub.fptr;
-    register int i;
+    size_t row_bytes = (size_t) source->pub.width * source->pixel_size;
+    int row = source->current_row++;
+    int ok;
 
-    /* Duplicate previously read pixel? */
-    if (source->dup_pixel_count > 0) {
-        source->dup_pixel_count--;
-        return;
-    }
+    if (source->image_data) {
+        if (source->is_bottom_up)
+            row = source->pub.height - 1 - row;
 
-    /* Time to read RLE block header? */
-    if (--source->block_count < 0) {     /* decrement pixels remaining in block */
-        i = read_byte(source);
-        if (i & 0x80) {                            /* Start of duplicate-pixel block? */
-            source->dup_pixel_count = i & 0x7F; /* number of dups after this one */
-            source->block_count = 0;                /* then read new block header */
-        } else {
-            source->block_count = i & 0x7F;    /* number of pixels after this one */
-        }
+        return source->image_data + row_bytes * row;
     }
 
-    /* Read next pixel */
-    for (i = 0; i < source->pixel_size; i++) {
-        source->tga_pixel[i] = (U_CHAR) getc(infile);
+    if (source->is_rle)
+        ok = read_rle_pixels(source, source->row_buffer, source->pub.width);
+    else
+        ok = ReadOK(source->pub.src, source->row_buffer, row_bytes);
+
+    if (!ok) {
+        strncpy(source->pub.error_msg, ERR_INPUT_EOF, ERROR_LEN);
+        source->pub.error_msg[ERROR_LEN-1] = '\0';
+        source->pub.error = JNI_TRUE;
+        return NULL;
     }
+
+    return source->row_buffer;
 }
 
 
 /*
  * Read one row of pixels.
+ */
+static void get_tga_row (Parameters params)
+{
+    tga_source_ptr source = (tga_source_ptr) params;
+    const U_CHAR *inptr;
+
+    inptr = next_row(source);
+    if (inptr != NULL)
+        (*source->convert_row) (source, inptr, source->pub.buffer);
+}
+
+/*
+ * Read one row of packed bytes.
+ */
+static void get_tga_byte_row (Parameters params, U_CHAR *dest)
+{
+    tga_source_ptr source = (tga_source_ptr) params;
+    const U_CHAR *inptr;
+
+    inptr = next_row(source);
+    if (inptr != NULL)
+        (*source->convert_bytes) (source, inptr, dest);
+}
+
+
+/*
+ * Convert one row of pixels as stored.
  *
  * We provide several different versions depending on input file format.
  */
@@ -167,101 +245,64 @@ static void read_rle_pixel (tga_source_ptr source)
 /*
  * This version is for reading 8-bit grayscale pixels
  */
-static void get_8bit_gray_row (Parameters params)
+static void convert_8bit_gray_row (tga_source_ptr source, const U_CHAR *inptr,
+                                   jint *data)
 {
     register int i;
-    jint *data;
-    jint r, g, b;
 
-    tga_source_ptr source = (tga_source_ptr) params;
-  
-    if (source->whole_image) {
-        /* whole_image exists so we assume that we are writing to the */
-        /* internal buffer */
-        data = source->whole_image[source->current_row];
-    }
-    else {
-        /* we are writing to user buffer */
-        data = source->pub.buffer;
-    }
-
-    /* put each pixel into the buffer to send back to java */
-    for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-        (*source->read_pixel) (source); /* Load next pixel into tga_pixel */
+    for (i = 0; i < source->pub.width; i++)
+        data[i] = (jint) inptr[i];
+}
 
-        data[i] = (jint) UCH(source->tga_pixel[0]);
-    }
+static void convert_8bit_gray_bytes (tga_source_ptr source,
+                                     const U_CHAR *inptr, U_CHAR *dest)
+{
+    memcpy(dest, inptr, source->pub.width);
 }
 
 /*
  * This version is for reading 8-bit colormap indexes
  */
-static void get_8bit_row (Parameters params)
+static void convert_8bit_row (tga_source_ptr source, const U_CHAR *inptr,
+                              jint *data)
 {
-    register int i, t;
-    jint *data;
-    jint r, g, b;
-
-    tga_source_ptr source = (tga_source_ptr) params;
-    U_CHAR **colormap = source->colormap;
-  
-    if (source->whole_image) {
-        /* whole_image exists so we assume that we are writing to the */
-        /* internal buffer */
-        data = source->whole_image[source->current_row];
-    }
-    else {
-        /* we are writing to user buffer */
-        data = source->pub.buffer;
-    }
-
-    /* put each pixel into the buffer to send back to java */
-    for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-        (*source->read_pixel) (source); /* Load next pixel into tga_pixel */
+    register const jint *colormap = source->colormap;
+    register int i;
 
-        t = UCH(source->tga_pixel[0]);
+    /* the colormap already holds the RGB value of each index */
+    for (i = 0; i < source->pub.width; i++)
+        data[i] = colormap[inptr[i]];
+}
 
-        r = (jint) colormap[0][t];
-        g = (jint) colormap[1][t];
-        b = (jint) colormap[2][t];
+static void convert_8bit_bytes (tga_source_ptr source, const U_CHAR *inptr,
+                                U_CHAR *dest)
+{
+    register const jint *colormap = source->colormap;
+    register jint pixel;
+    register int i;
 
-        /* Required to return data in ARGB format */
-        data[i] = (r << 16) + (g << 8) + b;
+    /* colormapped images are returned with an empty alpha channel */
+    for (i = 0; i < source->pub.width; i++) {
+        pixel = colormap[inptr[i]];
+        *dest++ = (U_CHAR) (pixel >> 16);
+        *dest++ = (U_CHAR) (pixel >> 8);
+        *dest++ = (U_CHAR) pixel;
+        *dest++ = 0;
     }
 }
 
 /*
  * This version is for reading 16-bit pixels
  */
-static void get_16bit_row (Parameters params)
+static void convert_16bit_row (tga_source_ptr source, const U_CHAR *inptr,
+                               jint *data)
 {
     register int i, t;
-    jint *data;
     jint r, g, b;
-    tga_source_ptr source = (tga_source_ptr) params;
-  
-    if (source->whole_image) {
-        /* whole_image exists so we assume that we are writing to the */
-        /* internal buffer */
-        data = source->whole_image[source->current_row];
-    }
-    else {
-        /* we are writing to user buffer */
-        data = source->pub.buffer;
-    }
 
-    /* put each pixel into the buffer to send back to java */
-    for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-        (*source->read_pixel) (source); /* Load next pixel into tga_pixel */
-
-        t = UCH(source->tga_pixel[0]);
-        t += UCH(source->tga_pixel[1]) << 8;
+    for (i = 0; i < source->pub.width; i++) {
+        t = inptr[0] + (inptr[1] << 8);
+        inptr += 2;
 
         /* We expand 5 bit data to 8 bit sample width.
          * The format of the 16-bit (LSB first) input word is
@@ -275,134 +316,95 @@ static void get_16bit_row (Parameters params)
 
         /* Required to return data in ARGB format */
         data[i] = (r << 16) + (g << 8) + b;
-  }
+    }
 }
 
-/*
- * This version is for reading 24-bit pixels
- */
-static void get_24bit_row (Parameters params)
+static void convert_16bit_bytes (tga_source_ptr source, const U_CHAR *inptr,
+                                 U_CHAR *dest)
 {
     register int i, t;
-    jint *data;
-    jint r, g, b;
-
-    tga_source_ptr source = (tga_source_ptr) params;
-    U_CHAR **colormap = source->colormap;
-  
-    if (source->whole_image) {
-        /* whole_image exists so we assume that we are writing to the */
-        /* internal buffer */
-        data = source->whole_image[source->current_row];
-    }
-    else {
-        /* we are writing to user buffer */
-        data = source->pub.buffer;
-    }
-
-    /* put each pixel into the buffer to send back to java */
-    for(i = 0; i < source->pub.width; i++) {
-        /* extract components from byte array and store them */
-        /* in the int array which is accessible by caller */
-        /* Note that tga is in BGR order */
-        (*source->read_pixel) (source); /* Load next pixel into tga_pixel */
 
-        t = UCH(source->tga_pixel[0]);
+    for (i = 0; i < source->pub.width; i++) {
+        t = inptr[0] + (inptr[1] << 8);
+        inptr += 2;
 
-        r = (jint) UCH(source->tga_pixel[2]);
-        g = (jint) UCH(source->tga_pixel[1]);
-        b = (jint) UCH(source->tga_pixel[0]);
-
-        /* Required to return data in RGB format */
-        data[i] = (r << 16) + (g << 8) + b;
+        *dest++ = (U_CHAR) c5to8bits[(t >> 10) & 0x1F];
+        *dest++ = (U_CHAR) c5to8bits[(t >> 5) & 0x1F];
+        *dest++ = (U_CHAR) c5to8bits[t & 0x1F];
     }
 }
 
 /*
+ * This version is for reading 24-bit pixels, and 32-bit pixels.
  * Targa also defines a 32-bit pixel format with order B,G,R,A.
- * We presently ignore the attribute byte, so the code for reading
- * these pixels is identical to the 24-bit routine above.
- * This works because the actual pixel length is only known to read_pixel.
+ * We presently ignore the attribute byte, so only the pixel size differs.
  */
-
-#define get_32bit_row  get_24bit_row
-
-
-/*
- * This method is for re-reading the input data in standard top-down
- * row order.  The entire image has already been read into whole_image
- * with proper conversion of pixel format, but it's in a funny row order.
- */
-static void get_memory_row (Parameters params)
+static void convert_24bit_row (tga_source_ptr source, const U_CHAR *inptr,
+                               jint *data)
 {
-    tga_source_ptr source = (tga_source_ptr) params;
+    register int i;
+    int pixel_size = source->pixel_size;
+    jint r, g, b;
 
-    /* Fetch that row from virtual array */
-    memcpy(source->pub.buffer, source->whole_image[source->current_row],
-             source->pub.width * sizeof(jint));
+    /* Note that tga is in BGR order */
+    for (i = 0; i < source->pub.width; i++) {
+        r = (jint) inptr[2];
+        g = (jint) inptr[1];
+        b = (jint) inptr[0];
+        inptr += pixel_size;
 
-    /* increment row for next time */
-    source->current_row++;
+        /* Required to return data in RGB format */
+        data[i] = (r << 16) + (g << 8) + b;
+    }
 }
 
-
-/*
- * This method loads the image into whole_image during the first call on
- * get_pixel_row.  The get_pixel_row pointer is then adjusted to call
- * get_memory_row on subsequent calls.
- */
-static void preload_image (Parameters params)
+static void convert_24bit_bytes (tga_source_ptr source, const U_CHAR *inptr,
+                                 U_CHAR *dest)
 {
-    tga_source_ptr source = (tga_source_ptr) params;
-    int row;
-
-    /* Read the data into a virtual array in top-down row order. */
-    source->current_row = source->pub.height;
-    for (row = 0; row < source->pub.height; row++) {
-        source->current_row--;
+    register int i;
+    int pixel_size = source->pixel_size;
 
-        /* read a row of pixels into the internal buffer */
-        (*source->get_pixel_row) (params);
+    for (i = 0; i < source->pub.width; i++) {
+        *dest++ = inptr[2];
+        *dest++ = inptr[1];
+        *dest++ = inptr[0];
+        inptr += pixel_size;
     }
-
-    /* Set up to read from the virtual array in unscrambled order */
-    source->pub.get_pixel_row = get_memory_row;
-    source->current_row = 0;
 }
 
 
 /*
- * Read the file header; return image size and component count.
+ * Read the file header only; return image size and component count.
+ * The ID field, colormap and image data are left unread.
  */
-static void start_input_tga (Parameters params)
+static void read_header_tga (Parameters params)
 {
     tga_source_ptr source = (tga_source_ptr) params;
     U_CHAR targaheader[18];
-    int idlen, cmaptype, subtype, flags, interlace_type, components;
-    unsigned int width, height, maplen;
-    int is_bottom_up;
+    int cmaptype, subtype, flags, interlace_type;
 
 #define GET_2B(offset)((unsigned int) UCH(targaheader[offset]) + \
         (((unsigned int) UCH(targaheader[offset+1])) << 8))
 
-    if (! ReadOK(source->pub.fptr, targaheader, 18))
+    if (! ReadOK(source->pub.src, targaheader, 18))
         ERREXIT(ERR_INPUT_EOF);
 
     /* Pretend "15-bit" pixels are 16-bit --- we ignore attribute bit anyway */
     if (targaheader[16] == 15)
         targaheader[16] = 16;
 
-    idlen = UCH(targaheader[0]);
+    source->id_length = UCH(targaheader[0]);
     cmaptype = UCH(targaheader[1]);
     subtype = UCH(targaheader[2]);
-    maplen = GET_2B(5);
-    width = GET_2B(12);
-    height = GET_2B(14);
+    source->map_origin = GET_2B(3);
+    source->map_length = GET_2B(5);
+    source->map_entry_size = UCH(targaheader[7]);
     source->pixel_size = UCH(targaheader[16]) >> 3;
     flags = UCH(targaheader[17]);/* Image Descriptor byte */
 
-    is_bottom_up = ((flags & 0x20) == 0);/* bit 5 set => top-down */
+    source->is_bottom_up = ((flags & 0x20) == 0);/* bit 5 set => top-down */
     interlace_type = flags >> 6;/* bits 6/7 are interlace code */
+    source->has_colormap = cmaptype;
 
     if (cmaptype > 1 ||                          /* cmaptype must be 0 or 1 */
          source->pixel_size < 1 ||
@@ -413,22 +415,24 @@ static void start_input_tga (Parameters params)
 
     if (subtype > 8) {
         /* It's an RLE-coded file */
-        source->read_pixel = read_rle_pixel;
+        source->is_rle = JNI_TRUE;
         source->block_count = source->dup_pixel_count = 0;
         subtype -= 8;
     } else {
         /* Non-RLE file */
-        source->read_pixel = read_non_rle_pixel;
+        source->is_rle = JNI_FALSE;
     }
 
     /* Now should have subtype 1, 2, or 3 */
-    components = 4;              /* until proven different */
-    source->pub.numComponents = 4;
+    source->pub.numComponents = 4;     /* until proven different */
+    source->pub.bitDepth = 8;
 
     switch (subtype) {
         case 1:/* Colormapped image */
-            if (source->pixel_size == 1 && cmaptype == 1)
-                source->get_pixel_row = get_8bit_row;
+            if (source->pixel_size == 1 && cmaptype == 1) {
+                source->convert_row = convert_8bit_row;
+                source->convert_bytes = convert_8bit_bytes;
+            }
             else
                 ERREXIT(ERR_TGA_BADPARMS);
             break;
@@ -436,13 +440,14 @@ static void start_input_tga (Parameters params)
             source->pub.numComponents = 3;
             switch (source->pixel_size) {
                 case 2:
-                    source->get_pixel_row = get_16bit_row;
+                    source->convert_row = convert_16bit_row;
+                    source->convert_bytes = convert_16bit_bytes;
+                    source->pub.bitDepth = 5;
                     break;
                 case 3:
-                    source->get_pixel_row = get_24bit_row;
-                    break;
                 case 4:
-                    source->get_pixel_row = get_32bit_row;
+                    source->convert_row = convert_24bit_row;
+                    source->convert_bytes = convert_24bit_bytes;
                     break;
                 default:
                     ERREXIT(ERR_TGA_BADPARMS);
@@ -451,8 +456,10 @@ static void start_input_tga (Parameters params)
             break;
         case 3:/* Grayscale image */
             source->pub.numComponents = 1;
-            if (source->pixel_size == 1)
-                source->get_pixel_row = get_8bit_gray_row;
+            if (source->pixel_size == 1) {
+                source->convert_row = convert_8bit_gray_row;
+                source->convert_bytes = convert_8bit_gray_bytes;
+            }
             else
                 ERREXIT(ERR_TGA_BADPARMS);
             break;
@@ -461,35 +468,79 @@ static void start_input_tga (Parameters params)
             break;
     }
 
-    if (is_bottom_up) {
-        /* Create a virtual array to buffer the upside-down image. */
-        source->whole_image = alloc2DJIntArray(height, width);
+    source->pub.width = GET_2B(12);
+    source->pub.height = GET_2B(14);
+}
 
-        source->pub.get_pixel_row = preload_image;
-    } else {
-        /* Don't need a virtual array */
-        source->whole_image = NULL;
-        source->pub.get_pixel_row = source->get_pixel_row;
-    }
 
-    while (idlen--)                      /* Throw away ID field */
-        (void) read_byte(source);
+/*
+ * Read the file header; return image size and component count.
+ * Top-down images are read a row at a time as they are asked for.
+ * Bottom-up ones are read by row offset when the source is in memory,
+ * or else read in, or RLE decoded, to one block of pixels as stored.
+ */
+static void start_input_tga (Parameters params)
+{
+    tga_source_ptr source = (tga_source_ptr) params;
+    DataSource src = source->pub.src;
+    unsigned int maplen;
+    size_t row_bytes, image_bytes;
+
+    read_header_tga(params);
+    if (source->pub.error)
+        return;
+
+    /* Throw away ID field */
+    if (src_skip(src, source->id_length) != (size_t) source->id_length)
+        ERREXIT(ERR_INPUT_EOF);
 
+    maplen = source->map_length;
     if (maplen > 0) {
-        if (maplen > 256 || GET_2B(3) != 0)
+        if (maplen > 256 || source->map_origin != 0)
             ERREXIT(ERR_TGA_BADCMAP);
-        /* Allocate space to store the colormap */
-        source->colormap = alloc2DByteArray(3, maplen);
-        /* and read it from the file */
-        read_colormap(source, (int) maplen, UCH(targaheader[7]));
+        /* read the colormap from the file */
+        read_colormap(source, (int) maplen, source->map_entry_size);
+        if (source->pub.error)
+            return;
     } else {
-        if (cmaptype)/* but you promised a cmap! */
+        if (source->has_colormap)/* but you promised a cmap! */
             ERREXIT(ERR_TGA_BADPARMS);
-        source->colormap = NULL;
     }
 
-    source->pub.width = width;
-    source->pub.height = height;
+    source->current_row = 0;
+    source->pub.get_pixel_row = get_tga_row;
+    source->pub.get_byte_row = get_tga_byte_row;
+
+    row_bytes = (size_t) source->pub.width * source->pixel_size;
+    image_bytes = row_bytes * source->pub.height;
+
+    if (!source->is_rle && src->base != NULL) {
+        /* the pixels are in memory already, so read them in place */
+        if (src->bytes_left < image_bytes)
+            ERREXIT(ERR_INPUT_EOF);
+
+        source->image_data = src->next_byte;
+    }
+    else if (source->is_bottom_up) {
+        /* the bottom row comes first, so all of it has to be read */
+        if ( !(source->image_copy = (U_CHAR *) malloc(image_bytes)))
+            ERREXIT(ERR_OUT_OF_MEMORY);
+
+        if (source->is_rle) {
+            if (!read_rle_pixels(source, source->image_copy,
+                                 source->pub.width * source->pub.height))
+                ERREXIT(ERR_INPUT_EOF);
+        }
+        else if (! ReadOK(src, source->image_copy, image_bytes))
+            ERREXIT(ERR_INPUT_EOF);
+
+        source->image_data = source->image_copy;
+    }
+    else {
+        /* Don't need to hold the image, the rows are read in order */
+        if ( !(source->row_buffer = (U_CHAR *) malloc(row_bytes)))
+            ERREXIT(ERR_OUT_OF_MEMORY);
+    }
 }
 
 
@@ -500,13 +551,13 @@ static void finish_input_tga (Parameters params)
 {
     tga_source_ptr source = (tga_source_ptr) params;
 
-    /* free memory allocated to colormap */
-    if (source->colormap)
-        free2DByteArray(source->colormap);
-
     /* free memory allocated to image data */
-    if (source->whole_image)
-        free2DJIntArray(source->whole_image);
+    free(source->image_copy);
+    free(source->row_buffer);
+
+    source->image_data = NULL;
+    source->image_copy = NULL;
+    source->row_buffer = NULL;
 }
 
 
@@ -524,24 +575,39 @@ Parameters targa_init ()
 
     if (source != NULL) {
         /* Initialise structure */
-        source->pub.fptr = NULL;
+        source->pub.src = NULL;
         source->pub.width = -1;
         source->pub.height = -1;
         source->pub.buffer = NULL;
         source->pub.numComponents = 3;
+        source->pub.bitDepth = 8;
+        source->pub.interlaced = JNI_FALSE;
         source->pub.row_num = 0;
         source->pub.error = JNI_FALSE;
         source->pub.error_msg[0] = '\0';
 
         source->current_row = 0;
-        source->colormap = NULL;
-        source->whole_image = NULL;
+        source->image_data = NULL;
+        source->image_copy = NULL;
+        source->row_buffer = NULL;
+        source->is_rle = JNI_FALSE;
         source->pixel_size = 0;
+        source->block_count = 0;
         source->dup_pixel_count = 0;
+        source->id_length = 0;
+        source->has_colormap = JNI_FALSE;
+        source->map_origin = 0;
+        source->map_length = 0;
+        source->map_entry_size = 0;
+        source->is_bottom_up = JNI_TRUE;
 
         /* Fill in method ptrs, except get_pixel_row which start_input sets */
+        source->pub.read_header = read_header_tga;
         source->pub.start_input = start_input_tga;
         source->pub.finish_input = finish_input_tga;
+        source->pub.get_byte_row = NULL;
+        source->pub.get_byte_rows = NULL;
+        source->pub.count_pages = NULL;
     }
 
     /* return the reference to initialised parameter structure */
@@ -20,31 +20,26 @@
  * The libtiff library does not like to operate with pipes because it performs
  * random seeks into the stream. To deal with this the code makes use of
  * the TIFFClientOpen function and replaces all the normal internal routines
- * with our own custom work. It then takes the entire pipe's contents into an
- * internal buffer which the library can then use to search into.
+ * with our own custom work. When the image is already held in memory the
+ * library reads straight out of that memory. Otherwise it takes the entire
+ * stream's contents into one internal block of memory which the library can
+ * then use to search into. Either way the memory is handed to the library
+ * as a mapped file, so strips are read from it without being copied.
  */
 
 #include "decode_image.h"
 #include <tiffio.h>
 
-#ifdef _WIN32
-/* Windoze silliness. */
-#include <io.h>
-#define read _read
-
-#else
-#include <unistd.h>
-#endif
-
 /* Error Strings */
 #define ERR_TIF_NO_OPEN "Error with tiff internals"
-#define ERR_FD_SIZE "File descriptor is too large"
+#define ERR_TIF_READ "Error reading tiff image data"
+#define ERR_TIF_NO_PAGE "No such page in the tiff image"
 
-/* buffer size, chosen for typical block size */
-#define BUF_SIZE 8192
+/* initial size of the buffer a stream is read into, doubled as needed */
+#define BUF_SIZE 65536
 
-/* Must be greater than the largest file descriptor that can be opened */
-#define MAX_FD 1024
+/* fewest decoded pixels worth starting another thread for */
+#define MIN_THREAD_PIXELS 262144
 
 #define ERREXIT(str) { \
                   strncpy(source->pub.error_msg, str, ERROR_LEN); \
@@ -52,18 +47,48 @@
                   source->pub.error = JNI_TRUE; \
                   return; }
 
-#define MIN(x,y)((x)<(y)?(x):(y))
-
-/* buffer used to simulate reading from a file */
-typedef struct _file_buffer * file_buffer_ptr;
-
-typedef struct _file_buffer {
-   char **rows;               /* pntr to array of rows */
-   int num_rows;              /* number of rows */
-   int buffer_size;           /* total number of bytes in buffer */
-   int current_row;           /* current row */
-   int current_offset;        /* current offset in the current row */
-} file_buffer;
+#define ERRRETURN(str, val) { \
+                  strncpy(source->pub.error_msg, str, ERROR_LEN); \
+                  source->pub.error_msg[ERROR_LEN-1] = '\0'; \
+                  source->pub.error = JNI_TRUE; \
+                  return(val); }
+
+/* view of an image that is held in memory, either by the caller or */
+/* in a buffer the stream has been read into */
+typedef struct _mem_buffer * mem_buffer_ptr;
+
+typedef struct _mem_buffer {
+   const U_CHAR *data;        /* start of the image data */
+   toff_t size;               /* total number of bytes */
+   toff_t offset;             /* current read position */
+   U_CHAR *owned;             /* buffer to free on close, NULL if the */
+                              /* memory belongs to the caller */
+} mem_buffer;
+
+/* encoded data looked at while reading just the header of an image. */
+/* Everything from the start of the file is kept, as the directory */
+/* can point back to values anywhere before it. */
+typedef struct _probe_buffer * probe_buffer_ptr;
+
+typedef struct _probe_buffer {
+   DataSource src;            /* where the data comes from */
+   const U_CHAR *data;        /* start of the file */
+   U_CHAR *copy;              /* data copied out of a stream, or NULL */
+   uint32 length;             /* number of bytes available at data */
+   uint32 allocated;          /* size of copy */
+   int big_endian;            /* TRUE for "MM" byte order */
+} probe_buffer;
+
+/* Decoding state for one thread. Each has its own view of the file so */
+/* they can all read from it at once. */
+typedef struct _tiff_worker * tiff_worker_ptr;
+
+typedef struct _tiff_worker {
+  TIFF *tif;                       /* this thread's view of the image */
+  TIFFRGBAImage img;               /* converts the image data to ARGB */
+  int img_started;                 /* TRUE if img needs to be ended */
+  int failed;                      /* TRUE if its last part didn't read */
+} tiff_worker;
 
 /* Private version of data source object */
 typedef struct _tiff_source_struct * tiff_source_ptr;
@@ -71,24 +96,172 @@ typedef struct _tiff_source_struct * tiff_source_ptr;
 typedef struct _tiff_source_struct {
   struct param pub;                /* public fields */
 
-  int current_row;                 /* current row that we should be returning */
-  uint32 *raster;                  /* contains all the image data in ARGB format */
+  mem_buffer_ptr file;             /* the whole file, once loaded */
+  int num_pages;                   /* pages in the file, 0 if not counted */
+  tiff_worker workers[MAX_THREADS];/* each with its own view of file */
+  int num_workers;                 /* threads decoding each window */
+  int bottom_up;                   /* TRUE if the file stores the bottom row first */
+  uint32 band_height;              /* rows in one strip, or one row of tiles */
+  uint32 window_bands;             /* bands decoded in one go */
+  uint32 part_rows;                /* file rows each worker decodes of that */
+  uint32 window_start;             /* first file row of the current window */
+  uint32 window_end;               /* file row after the current window */
+  int native;                      /* TRUE if rows are read as stored, */
+                                   /* FALSE if converted to ARGB */
+  U_CHAR *raster;                  /* the current window, top down */
+  tsize_t row_size;                /* bytes in one row of raster */
+  uint32 window_rows;              /* number of rows held in raster */
+  uint32 current_row;              /* next row of raster to return */
+  uint32 image_row;                /* image row that row is, counted from the top */
 } tiff_source_struct;
 
-/* static list of buffers */
-static file_buffer_ptr buffers[MAX_FD];
-
-static int initialized = 0;
-
 /* Function forward decls */
-static tsize_t pipeRead(thandle_t fd, tdata_t buf, tsize_t size);
 static tsize_t pipeWrite(thandle_t fd, tdata_t buf, tsize_t size);
-static toff_t pipeSeek(thandle_t fd, toff_t off, int whence);
-static int pipeClose(thandle_t fd);
-static toff_t pipeSize(thandle_t fd);
-static void buffer_file(int fd);
-static int pipeMMap(thandle_t fd, tdata_t* pbase, toff_t* psize);
+static mem_buffer_ptr buffer_file(DataSource src);
 static void pipeUnMMap(thandle_t fd, tdata_t base, toff_t size);
+static tsize_t memRead(thandle_t fd, tdata_t buf, tsize_t size);
+static toff_t memSeek(thandle_t fd, toff_t off, int whence);
+static int memClose(thandle_t fd);
+static toff_t memSize(thandle_t fd);
+static int memMMap(thandle_t fd, tdata_t* pbase, toff_t* psize);
+
+/*
+ * Decode one worker's part of the current window into the raster.
+ * Each part is a whole number of bands, and the parts are handed out in
+ * file order, so no two workers ever decode the same strip or tile.
+ */
+static void decode_part(void *data, int part)
+{
+    tiff_source_ptr source = (tiff_source_ptr) data;
+    tiff_worker_ptr worker = &source->workers[part];
+    uint32 w = (uint32) source->pub.width;
+    uint32 start, end, offset, row;
+    U_CHAR *out;
+
+    worker->failed = JNI_FALSE;
+
+    if(source->window_end - source->window_start <= part * source->part_rows)
+        return;
+
+    start = source->window_start + part * source->part_rows;
+    end = source->window_end;
+    if(end - start > source->part_rows)
+        end = start + source->part_rows;
+
+    /* rows come back top down, so a bottom up file fills from the end */
+    if(source->bottom_up)
+        offset = source->window_end - end;
+    else
+        offset = start - source->window_start;
+
+    out = source->raster + source->row_size * offset;
+
+    if(source->native)
+    {
+        /* strips decode straight into place, one band at a time */
+        for(row = start; row < end; row += source->band_height)
+        {
+            if(TIFFReadEncodedStrip(worker->tif,
+                                    TIFFComputeStrip(worker->tif, row, 0),
+                                    out + source->row_size * (row - start),
+                                    (tsize_t) -1) < 0)
+            {
+                worker->failed = JNI_TRUE;
+                return;
+            }
+        }
+    }
+    else
+    {
+        worker->img.row_offset = start;
+        worker->img.col_offset = 0;
+
+        if(!TIFFRGBAImageGet(&worker->img, (uint32 *) out, w, end - start))
+            worker->failed = JNI_TRUE;
+    }
+}
+
+/*
+ * Decode the window of bands holding the next image row. The window is
+ * split between the workers, each decoding its own part in parallel.
+ * Returns FALSE if any part could not be read.
+ */
+static int decode_window(tiff_source_ptr source)
+{
+    uint32 h = (uint32) source->pub.height;
+    uint32 file_row, last_band, first_band;
+    int i;
+
+    if(source->bottom_up)
+    {
+        file_row = h - 1 - source->image_row;
+        last_band = file_row / source->band_height;
+        if(last_band >= source->window_bands)
+            first_band = last_band - source->window_bands + 1;
+        else
+            first_band = 0;
+
+        source->window_start = first_band * source->band_height;
+        source->window_end = file_row + 1;
+    }
+    else
+    {
+        source->window_start = source->image_row;
+        source->window_end = h;
+        if(h - source->window_start > source->window_bands * source->band_height)
+            source->window_end = source->window_start +
+                                 source->window_bands * source->band_height;
+    }
+
+    if(source->num_workers > 1)
+        run_parallel(decode_part, source, source->num_workers);
+    else
+        decode_part(source, 0);
+
+    for(i = 0; i < source->num_workers; i++)
+    {
+        if(source->workers[i].failed)
+            return JNI_FALSE;
+    }
+
+    source->window_rows = source->window_end - source->window_start;
+    source->current_row = 0;
+
+    return JNI_TRUE;
+}
+
+/*
+ * Return the next row of the image, or NULL on error. The row is either
+ * in ARGB format or, for the images that allow it, the samples as stored.
+ * The image is decoded a window at a time, a window being a run of
+ * bands, and a band being one strip or one row of tiles. Only that much
+ * of the decoded image is ever held. The library is asked for each band
+ * top down. When the file stores the bottom row first the windows are
+ * taken from the end of the file.
+ */
+static U_CHAR *next_row(tiff_source_ptr source)
+{
+    U_CHAR *row;
+
+    if(source->pub.error)
+        return NULL;
+
+    if(source->current_row >= source->window_rows &&
+       !decode_window(source))
+    {
+        strncpy(source->pub.error_msg, ERR_TIF_READ, ERROR_LEN);
+        source->pub.error_msg[ERROR_LEN-1] = '\0';
+        source->pub.error = JNI_TRUE;
+        return NULL;
+    }
+
+    row = source->raster + source->row_size * source->current_row;
+
+    source->current_row++;
+    source->image_row++;
+
+    return row;
+}
 
 /*
  * Read one row of pixels.
@@ -103,7 +276,10 @@ static void get_row_rgba(Parameters params)
     jint *data;
     jint a, r, g, b;
 
-    inptr = source->raster + source->pub.width * source->current_row;
+    inptr = (uint32 *) next_row(source);
+    if(inptr == NULL)
+        return;
+
     data = source->pub.buffer;
 
     /* put each pixel into the buffer to send back to java */
@@ -121,8 +297,6 @@ static void get_row_rgba(Parameters params)
 
         data[i] = (a << 24) +(r << 16) +(g << 8) + b;
     }
-
-    source->current_row--;
 }
 
 static void get_row_rgb(Parameters params)
@@ -134,7 +308,10 @@ static void get_row_rgb(Parameters params)
     jint *data;
     jint r, g, b;
 
-    inptr = source->raster + source->pub.width * source->current_row;
+    inptr = (uint32 *) next_row(source);
+    if(inptr == NULL)
+        return;
+
     data = source->pub.buffer;
 
     /* put each pixel into the buffer to send back to java */
@@ -152,8 +329,6 @@ static void get_row_rgb(Parameters params)
         data[i] = (r << 16) +(g << 8) + b;
 
     }
-
-    source->current_row--;
 }
 
 static void get_row_gray(Parameters params)
@@ -164,7 +339,10 @@ static void get_row_gray(Parameters params)
     register uint32 *inptr;
     jint *data;
 
-    inptr = source->raster + source->pub.width * source->current_row;
+    inptr = (uint32 *) next_row(source);
+    if(inptr == NULL)
+        return;
+
     data = source->pub.buffer;
 
     /* put each pixel into the buffer to send back to java */
@@ -175,62 +353,86 @@ static void get_row_gray(Parameters params)
 
         data[i] = (jint)(tmp & 0xff);
     }
+}
+
+/*
+ * Read one row of pixels.
+ * These versions are for 8-bit gray or RGB samples read as stored.
+ */
+static void get_row_native_gray(Parameters params)
+{
+    tiff_source_ptr source = (tiff_source_ptr)params;
+    unsigned int i;
+    register U_CHAR *inptr;
+    jint *data;
+
+    inptr = next_row(source);
+    if(inptr == NULL)
+        return;
+
+    data = source->pub.buffer;
+
+    for(i = 0; i < source->pub.width; i++)
+        data[i] = (jint) *inptr++;
+}
+
+static void get_row_native_rgb(Parameters params)
+{
+    tiff_source_ptr source = (tiff_source_ptr)params;
+    unsigned int i;
+    register U_CHAR *inptr;
+    jint *data;
+    jint r, g, b;
+
+    inptr = next_row(source);
+    if(inptr == NULL)
+        return;
+
+    data = source->pub.buffer;
+
+    for(i = 0; i < source->pub.width; i++)
+    {
+        r = (jint) *inptr++;
+        g = (jint) *inptr++;
+        b = (jint) *inptr++;
 
-    source->current_row--;
+        data[i] = (r << 16) +(g << 8) + b;
+    }
 }
 
 /*
- * Read the file header; return image size and component count.
+ * Read one row of packed bytes. The stored samples are already in the
+ * packed layout, so they are copied across as is.
  */
-static void start_input_tiff(Parameters params)
+static void get_byte_row_native(Parameters params, U_CHAR *dest)
 {
-    tiff_source_ptr source = (tiff_source_ptr) params;
-    uint32 w, h;
-    uint32 components = 0;
-    uint32 type = 0;
-    size_t npixels;
-    TIFF *tif;
-    int fd;
-
-    /* open file with tiff fdopen */
-    fd = fileno(source->pub.fptr);
-    if(fd >= MAX_FD)
-       ERREXIT(ERR_FD_SIZE);
-
-    /* read in the file into memory */
-    buffer_file(fd);
-
-    tif = TIFFClientOpen("imagefile",
-                         "rm",
-                        (thandle_t)fd,
-                        pipeRead,
-                        pipeWrite,
-                        pipeSeek,
-                        pipeClose,
-                        pipeSize,
-                        pipeMMap,
-                        pipeUnMMap);
-
-    if(tif)
-    {
-        TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
-        TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &h);
-        TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &type);
-        TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &components);
-
-        switch(type)
-        {
-            case PHOTOMETRIC_MINISWHITE:
-            case PHOTOMETRIC_MINISBLACK:
-            case PHOTOMETRIC_MASK:
-                source->pub.numComponents = 1;
-                source->pub.get_pixel_row = get_row_gray;
-                break;
+    tiff_source_ptr source = (tiff_source_ptr)params;
+    U_CHAR *inptr;
 
-            case PHOTOMETRIC_RGB:
-            case PHOTOMETRIC_SEPARATED:
-            case PHOTOMETRIC_YCBCR:
-            case PHOTOMETRIC_CIELAB:
+    inptr = next_row(source);
+    if(inptr == NULL)
+        return;
+
+    memcpy(dest, inptr, source->pub.width * source->pub.numComponents);
+}
+
+/*
+ * Work out how many components we return for the given photometric
+ * interpretation. Anything that isn't gray is read as RGBA.
+ */
+static int tiff_components(uint32 photometric)
+{
+    switch(photometric)
+    {
+        case PHOTOMETRIC_MINISWHITE:
+        case PHOTOMETRIC_MINISBLACK:
+        case PHOTOMETRIC_MASK:
+            return 1;
+
+        case PHOTOMETRIC_RGB:
+        case PHOTOMETRIC_SEPARATED:
+        case PHOTOMETRIC_YCBCR:
+        case PHOTOMETRIC_CIELAB:
 /*
     NOTE: Comment out to allow to fall through to 4 component color. Needed
     because there's some odd bug with Sun's JPEG encoder when they are deal
@@ -239,42 +441,634 @@ static void start_input_tiff(Parameters params)
     and blue components(almost like BGR, rather than RGB) :(
 */
 /*
-                source->pub.numComponents = 3;
-                source->pub.get_pixel_row = get_row_rgb;
-                break;
+            return 3;
 */
-            case PHOTOMETRIC_PALETTE:
-                source->pub.numComponents = 4;
-                source->pub.get_pixel_row = get_row_rgba;
-                break;
-        }
+        case PHOTOMETRIC_PALETTE:
+        default:
+            return 4;
+    }
+}
 
-        /* how many pixels in array? */
-        npixels = w * h;
-        source->raster = (uint32*) _TIFFmalloc(npixels * sizeof(uint32));
+/*
+ * Work out whether the image can be handed back just as it is stored,
+ * skipping the library's conversion to ARGB. That is 8-bit unsigned gray
+ * or RGB samples held together in strips, top row first. Returns the
+ * number of components if so, or 0 if the image has to be converted.
+ */
+static int native_components(uint32 photometric,
+                             uint32 bits,
+                             uint32 samples,
+                             uint32 planar,
+                             uint32 format,
+                             uint32 orientation,
+                             int tiled)
+{
+    if(tiled ||
+       bits != 8 ||
+       planar != PLANARCONFIG_CONTIG ||
+       format != SAMPLEFORMAT_UINT ||
+       orientation != ORIENTATION_TOPLEFT)
+        return 0;
+
+    if(photometric == PHOTOMETRIC_MINISBLACK && samples == 1)
+        return 1;
+
+    if(photometric == PHOTOMETRIC_RGB && samples == 3)
+        return 3;
+
+    return 0;
+}
+
+/*
+ * Make sure the first end bytes of the file are available for probing,
+ * reading more from a stream if needed. Returns FALSE if the file is
+ * too short or memory runs out.
+ */
+static int probe_need(probe_buffer_ptr pb, uint32 end)
+{
+    uint32 new_size;
+    U_CHAR *new_copy;
+    size_t num_read;
+
+    if(end <= pb->length)
+        return JNI_TRUE;
+
+    /* memory that isn't our own copy has everything there is already */
+    if(pb->data != NULL && pb->copy == NULL)
+        return JNI_FALSE;
+
+    if(end > pb->allocated)
+    {
+        /* double the buffer, but no further than end so the size can't */
+        /* wrap around for an end past 2GB */
+        new_size = pb->allocated ? pb->allocated : BUF_SIZE;
+        while(new_size < end)
+            new_size = (new_size > end / 2) ? end : new_size * 2;
+
+        new_copy = (U_CHAR *) realloc(pb->copy, new_size);
+        if(!new_copy)
+            return JNI_FALSE;
+
+        pb->copy = new_copy;
+        pb->data = new_copy;
+        pb->allocated = new_size;
+    }
+
+    num_read = src_read(pb->src, pb->copy + pb->length, end - pb->length);
+    pb->length += (uint32) num_read;
+
+    return(end <= pb->length);
+}
+
+/*
+ * Fetch a 2 or 4 byte value from the probe buffer in the byte order of
+ * the file. The caller must have checked the bytes are available.
+ */
+static uint32 probe_get2(probe_buffer_ptr pb, uint32 offset)
+{
+    const U_CHAR *ptr = pb->data + offset;
 
-        if(source->raster != NULL)
+    if(pb->big_endian)
+        return((uint32) ptr[0] << 8) | ptr[1];
+    else
+        return((uint32) ptr[1] << 8) | ptr[0];
+}
+
+static uint32 probe_get4(probe_buffer_ptr pb, uint32 offset)
+{
+    const U_CHAR *ptr = pb->data + offset;
+
+    if(pb->big_endian)
+        return((uint32) ptr[0] << 24) | ((uint32) ptr[1] << 16) |
+              ((uint32) ptr[2] << 8) | ptr[3];
+    else
+        return((uint32) ptr[3] << 24) | ((uint32) ptr[2] << 16) |
+              ((uint32) ptr[1] << 8) | ptr[0];
+}
+
+/*
+ * Return the first value of the directory entry at the given offset,
+ * or def if it is not a SHORT or LONG value that can be found.
+ */
+static uint32 probe_entry_value(probe_buffer_ptr pb, uint32 entry, uint32 def)
+{
+    uint32 type = probe_get2(pb, entry + 2);
+    uint32 count = probe_get4(pb, entry + 4);
+    uint32 offset;
+
+    switch(type)
+    {
+        case TIFF_SHORT:
+            if(count <= 2)
+                return probe_get2(pb, entry + 8);
+
+            offset = probe_get4(pb, entry + 8);
+            if(offset > 0x7FFFFFFF || !probe_need(pb, offset + 2))
+                return def;
+
+            return probe_get2(pb, offset);
+
+        case TIFF_LONG:
+            if(count <= 1)
+                return probe_get4(pb, entry + 8);
+
+            offset = probe_get4(pb, entry + 8);
+            if(offset > 0x7FFFFFFF || !probe_need(pb, offset + 4))
+                return def;
+
+            return probe_get4(pb, offset);
+    }
+
+    return def;
+}
+
+/*
+ * Read the file header only; return image size without decoding.
+ * Rather than loading the whole file for the library, the directory of
+ * the selected page is parsed directly. Only the data up to the end of
+ * that directory is read from a stream, unless the file has already
+ * been loaded to count its pages.
+ */
+static void read_header_tiff(Parameters params)
+{
+    tiff_source_ptr source = (tiff_source_ptr) params;
+    probe_buffer pb;
+    uint32 ifd, num_entries, entry, tag, i;
+    uint32 next;
+    uint32 w = 0, h = 0, bits = 1, type = 0;
+    uint32 samples = 1, planar = PLANARCONFIG_CONTIG;
+    uint32 format = SAMPLEFORMAT_UINT, orientation = ORIENTATION_TOPLEFT;
+    int tiled = JNI_FALSE;
+    int native;
+
+    pb.src = source->pub.src;
+    pb.copy = NULL;
+    pb.allocated = 0;
+    pb.big_endian = JNI_FALSE;
+
+    if(source->file != NULL)
+    {
+        pb.data = source->file->data;
+        pb.length = (source->file->size > 0x7FFFFFFF) ?
+                        0x7FFFFFFF : (uint32) source->file->size;
+    }
+    else if(pb.src->base != NULL)
+    {
+        pb.data = pb.src->base;
+        pb.length = (pb.src->size > 0x7FFFFFFF) ?
+                        0x7FFFFFFF : (uint32) pb.src->size;
+    }
+    else
+    {
+        pb.data = NULL;
+        pb.length = 0;
+    }
+
+    /* byte order, version and the offset of the first directory */
+    if(!probe_need(&pb, 8) ||
+       !((pb.data[0] == 'I' && pb.data[1] == 'I') ||
+         (pb.data[0] == 'M' && pb.data[1] == 'M')))
+    {
+        free(pb.copy);
+        ERREXIT(ERR_TIF_NO_OPEN);
+    }
+
+    pb.big_endian = (pb.data[0] == 'M');
+    ifd = probe_get4(&pb, 4);
+
+    if(probe_get2(&pb, 2) != TIFF_VERSION ||
+       ifd > 0x7FFFFFFF ||
+       !probe_need(&pb, ifd + 2))
+    {
+        free(pb.copy);
+        ERREXIT(ERR_TIF_NO_OPEN);
+    }
+
+    /* follow the chain of directories along to the page wanted */
+    for(i = 0; i < (uint32) source->pub.page; i++)
+    {
+        next = ifd + 2 + probe_get2(&pb, ifd) * 12;
+        if(!probe_need(&pb, next + 4))
         {
-            if(!TIFFReadRGBAImage(tif, w, h, source->raster, 0))
-            {
-                /* do error message here */
-                ;
-            }
+            free(pb.copy);
+            ERREXIT(ERR_TIF_NO_OPEN);
         }
-        else
+
+        ifd = probe_get4(&pb, next);
+        if(ifd == 0 || ifd > 0x7FFFFFFF || !probe_need(&pb, ifd + 2))
         {
-            ERREXIT(ERR_OUT_OF_MEMORY);
+            free(pb.copy);
+            ERREXIT(ERR_TIF_NO_PAGE);
         }
+    }
+
+    num_entries = probe_get2(&pb, ifd);
+    if(!probe_need(&pb, ifd + 2 + num_entries * 12))
+    {
+        free(pb.copy);
+        ERREXIT(ERR_TIF_NO_OPEN);
+    }
+
+    for(i = 0; i < num_entries; i++)
+    {
+        entry = ifd + 2 + i * 12;
+        tag = probe_get2(&pb, entry);
+
+        switch(tag)
+        {
+            case TIFFTAG_IMAGEWIDTH:
+                w = probe_entry_value(&pb, entry, 0);
+                break;
+
+            case TIFFTAG_IMAGELENGTH:
+                h = probe_entry_value(&pb, entry, 0);
+                break;
+
+            case TIFFTAG_BITSPERSAMPLE:
+                bits = probe_entry_value(&pb, entry, 1);
+                break;
+
+            case TIFFTAG_PHOTOMETRIC:
+                type = probe_entry_value(&pb, entry, 0);
+                break;
+
+            case TIFFTAG_SAMPLESPERPIXEL:
+                samples = probe_entry_value(&pb, entry, 1);
+                break;
 
-        TIFFClose(tif);
+            case TIFFTAG_PLANARCONFIG:
+                planar = probe_entry_value(&pb, entry, PLANARCONFIG_CONTIG);
+                break;
 
-        source->current_row = h-1;
+            case TIFFTAG_SAMPLEFORMAT:
+                format = probe_entry_value(&pb, entry, SAMPLEFORMAT_UINT);
+                break;
+
+            case TIFFTAG_ORIENTATION:
+                orientation = probe_entry_value(&pb, entry, ORIENTATION_TOPLEFT);
+                break;
 
-        source->pub.width = (int) w;
-        source->pub.height = (int) h;
+            case TIFFTAG_TILEWIDTH:
+                tiled = JNI_TRUE;
+                break;
+        }
     }
-    else
+
+    free(pb.copy);
+
+    if(w == 0 || h == 0)
         ERREXIT(ERR_TIF_NO_OPEN);
+
+    native = native_components(type, bits, samples, planar, format,
+                               orientation, tiled);
+
+    source->pub.width = (int) w;
+    source->pub.height = (int) h;
+    source->pub.numComponents = native ? native : tiff_components(type);
+    source->pub.bitDepth = (int) bits;
+}
+
+/*
+ * Get an opened image ready for converting to ARGB.
+ * Returns FALSE if the library can't convert it, with the reason in emsg.
+ */
+static int begin_convert(tiff_worker_ptr worker, char *emsg)
+{
+    if(!TIFFRGBAImageOK(worker->tif, emsg) ||
+       !TIFFRGBAImageBegin(&worker->img, worker->tif, 0, emsg))
+        return JNI_FALSE;
+
+    worker->img_started = JNI_TRUE;
+
+    /* have the library hand back each band top down, the right way round */
+    worker->img.req_orientation = ORIENTATION_TOPLEFT;
+
+    return JNI_TRUE;
+}
+
+/*
+ * Open the given page of the image held in the buffer, and if convert is
+ * set get it ready for converting to ARGB. The buffer is released when
+ * the image is closed, or straight away if it can't be opened. Returns
+ * FALSE on error, with the reason in emsg.
+ */
+static int open_worker(tiff_worker_ptr worker, mem_buffer_ptr mem_buf,
+                       int page, int convert, char *emsg)
+{
+    worker->tif = TIFFClientOpen("imagefile",
+                                 "r",
+                                (thandle_t)mem_buf,
+                                memRead,
+                                pipeWrite,
+                                memSeek,
+                                memClose,
+                                memSize,
+                                memMMap,
+                                pipeUnMMap);
+
+    if(!worker->tif)
+    {
+        memClose((thandle_t)mem_buf);
+        strcpy(emsg, ERR_TIF_NO_OPEN);
+        return JNI_FALSE;
+    }
+
+    if(page > 0 && !TIFFSetDirectory(worker->tif, (tdir_t) page))
+    {
+        strcpy(emsg, ERR_TIF_NO_PAGE);
+        return JNI_FALSE;
+    }
+
+    return(!convert || begin_convert(worker, emsg));
+}
+
+/*
+ * Release everything a worker holds.
+ */
+static void close_worker(tiff_worker_ptr worker)
+{
+    if(worker->img_started)
+        TIFFRGBAImageEnd(&worker->img);
+
+    if(worker->tif)
+        TIFFClose(worker->tif);
+
+    worker->tif = NULL;
+    worker->img_started = JNI_FALSE;
+}
+
+/*
+ * Release the workers and decoded rows of the last page, leaving the
+ * loaded file for the next one.
+ */
+static void close_page(tiff_source_ptr source)
+{
+    int i;
+
+    for(i = 0; i < MAX_THREADS; i++)
+        close_worker(&source->workers[i]);
+
+    if(source->raster)
+        _TIFFfree(source->raster);
+
+    source->raster = NULL;
+    source->num_workers = 0;
+    source->window_rows = 0;
+    source->current_row = 0;
+    source->image_row = 0;
+}
+
+/*
+ * Get the whole file into memory, if it isn't already, so the library
+ * can seek about it. This is done only the once, however many pages are
+ * then decoded from it. Returns FALSE if out of memory.
+ */
+static int load_file(tiff_source_ptr source)
+{
+    DataSource src = source->pub.src;
+    mem_buffer_ptr mem_buf;
+
+    if(source->file)
+        return JNI_TRUE;
+
+    if(src->base != NULL)
+    {
+        /* the whole image is in memory already, so read it in place */
+        mem_buf = (mem_buffer_ptr) malloc(sizeof(mem_buffer));
+        if(!mem_buf)
+            return JNI_FALSE;
+
+        mem_buf->data = src->base;
+        mem_buf->size = (toff_t) src->size;
+        mem_buf->offset = 0;
+        mem_buf->owned = NULL;
+    }
+    else
+    {
+        /* read in the file into memory */
+        mem_buf = buffer_file(src);
+        if(!mem_buf)
+            return JNI_FALSE;
+    }
+
+    source->file = mem_buf;
+
+    return JNI_TRUE;
+}
+
+/*
+ * Create another view of the loaded file, with its own read position.
+ * Closing the view leaves the file alone. Returns NULL if out of memory.
+ */
+static mem_buffer_ptr file_view(tiff_source_ptr source)
+{
+    mem_buffer_ptr view;
+
+    view = (mem_buffer_ptr) malloc(sizeof(mem_buffer));
+
+    if(view)
+    {
+        view->data = source->file->data;
+        view->size = source->file->size;
+        view->offset = 0;
+        view->owned = NULL;
+    }
+
+    return view;
+}
+
+/*
+ * Count the pages in the file, loading it in to do so. The count is
+ * kept, so this is only done the once.
+ */
+static int count_pages_tiff(Parameters params)
+{
+    tiff_source_ptr source = (tiff_source_ptr) params;
+    tiff_worker worker;
+    mem_buffer_ptr view;
+    char emsg[1024];
+
+    if(source->num_pages > 0)
+        return source->num_pages;
+
+    if(!load_file(source) || (view = file_view(source)) == NULL)
+        ERRRETURN(ERR_OUT_OF_MEMORY, 0);
+
+    worker.tif = NULL;
+    worker.img_started = JNI_FALSE;
+
+    if(!open_worker(&worker, view, 0, JNI_FALSE, emsg))
+    {
+        close_worker(&worker);
+        ERRRETURN(emsg, 0);
+    }
+
+    source->num_pages = (int) TIFFNumberOfDirectories(worker.tif);
+    close_worker(&worker);
+
+    if(source->num_pages < 1)
+        source->num_pages = 1;
+
+    return source->num_pages;
+}
+
+/*
+ * Read the file header; return image size and component count.
+ * The image itself is decoded a window at a time by next_row(). Large
+ * images are split between threads, each of which opens its own view of
+ * the buffered file. This may be called again to decode another page,
+ * which reuses the file loaded the first time.
+ */
+static void start_input_tiff(Parameters params)
+{
+    tiff_source_ptr source = (tiff_source_ptr) params;
+    uint32 w, h;
+    uint16 type = 0;
+    uint16 bits = 1;
+    uint16 samples = 1;
+    uint16 planar = PLANARCONFIG_CONTIG;
+    uint16 format = SAMPLEFORMAT_UINT;
+    uint16 orientation = ORIENTATION_TOPLEFT;
+    int native;
+    uint32 band = 0;
+    uint32 num_bands, part_bands;
+    size_t band_pixels;
+    int threads, i;
+    char emsg[1024];
+    TIFF *tif;
+    mem_buffer_ptr view;
+
+    /* drop anything left from decoding the previous page */
+    close_page(source);
+
+    if(!load_file(source) || (view = file_view(source)) == NULL)
+        ERREXIT(ERR_OUT_OF_MEMORY);
+
+    /* from here on finish_input_tiff() closes it again */
+    if(!open_worker(&source->workers[0], view, source->pub.page,
+                    JNI_FALSE, emsg))
+        ERREXIT(emsg);
+
+    tif = source->workers[0].tif;
+
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &h);
+    TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &type);
+    TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bits);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samples);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &format);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &orientation);
+
+    native = native_components(type, bits, samples, planar, format,
+                               orientation, TIFFIsTiled(tif));
+
+    if(native)
+    {
+        /* the samples are used just as they are stored */
+        source->native = JNI_TRUE;
+        source->row_size = TIFFScanlineSize(tif);
+        source->pub.numComponents = native;
+        source->pub.get_byte_row = get_byte_row_native;
+
+        if(native == 1)
+            source->pub.get_pixel_row = get_row_native_gray;
+        else
+            source->pub.get_pixel_row = get_row_native_rgb;
+    }
+    else
+    {
+        if(!begin_convert(&source->workers[0], emsg))
+            ERREXIT(emsg);
+
+        source->native = JNI_FALSE;
+        source->row_size = (tsize_t) (w * sizeof(uint32));
+        source->pub.numComponents = tiff_components(type);
+        source->pub.get_byte_row = NULL;
+
+        if(source->pub.numComponents == 1)
+            source->pub.get_pixel_row = get_row_gray;
+        else
+            source->pub.get_pixel_row = get_row_rgba;
+    }
+
+    source->pub.width = (int) w;
+    source->pub.height = (int) h;
+    source->pub.bitDepth = (int) bits;
+
+    switch(orientation)
+    {
+        case ORIENTATION_BOTRIGHT:
+        case ORIENTATION_BOTLEFT:
+        case ORIENTATION_RIGHTBOT:
+        case ORIENTATION_LEFTBOT:
+            source->bottom_up = JNI_TRUE;
+            break;
+
+        default:
+            source->bottom_up = JNI_FALSE;
+    }
+
+    /* the library decodes a whole strip or row of tiles at a time */
+    if(TIFFIsTiled(tif))
+        TIFFGetField(tif, TIFFTAG_TILELENGTH, &band);
+    else
+        TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &band);
+
+    if(band == 0 || band > h)
+        band = h;
+
+    /* Only split the image when there are enough bands to go round, */
+    /* and give each thread enough pixels to be worth starting it for */
+    num_bands = h / band + (h % band != 0);
+    band_pixels = (size_t) w * band;
+
+    threads = num_processors();
+    if(threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if((uint32) threads > num_bands)
+        threads = (int) num_bands;
+    if((size_t) threads > band_pixels * num_bands / MIN_THREAD_PIXELS)
+        threads = (int) (band_pixels * num_bands / MIN_THREAD_PIXELS);
+
+    part_bands = 1;
+
+    if(threads > 1)
+    {
+        part_bands = (uint32) ((MIN_THREAD_PIXELS + band_pixels - 1) / band_pixels);
+        if(part_bands > num_bands / threads)
+            part_bands = num_bands / threads;
+
+        for(i = 1; i < threads; i++)
+        {
+            view = file_view(source);
+            if(!view)
+                break;
+
+            if(!open_worker(&source->workers[i], view, source->pub.page,
+                            !source->native, emsg))
+            {
+                close_worker(&source->workers[i]);
+                break;
+            }
+        }
+
+        /* make do with the threads that could be set up */
+        threads = i;
+    }
+    else
+        threads = 1;
+
+    source->num_workers = threads;
+    source->band_height = band;
+    source->window_bands = part_bands * threads;
+    source->part_rows = part_bands * band;
+
+    source->raster = (U_CHAR *) _TIFFmalloc((size_t) source->row_size * band *
+                                            source->window_bands);
+
+    if(source->raster == NULL)
+        ERREXIT(ERR_OUT_OF_MEMORY);
 }
 
 
@@ -286,7 +1080,14 @@ static void finish_input_tiff(Parameters params)
 {
     tiff_source_ptr source = (tiff_source_ptr) params;
 
-    _TIFFfree(source->raster);
+    close_page(source);
+
+    /* the workers only had views, so the file goes last */
+    if(source->file)
+        memClose((thandle_t)source->file);
+
+    source->file = NULL;
+    source->num_pages = 0;
 }
 
 /*
@@ -297,15 +1098,7 @@ static void finish_input_tiff(Parameters params)
 Parameters tiff_init()
 {
     tiff_source_ptr source;
-
-    if(!initialized)
-    {
-        int i;
-        for(i = 0; i < MAX_FD; i++)
-            buffers[i] = NULL;
-
-        initialized = 1;
-    }
+    int i;
 
     /* Create module interface object */
     source = (tiff_source_ptr) malloc(sizeof(tiff_source_struct));
@@ -313,22 +1106,49 @@ Parameters tiff_init()
     if(source != NULL)
     {
         /* Initialise structure */
-        source->pub.fptr = NULL;
+        source->pub.src = NULL;
         source->pub.width = -1;
         source->pub.height = -1;
         source->pub.numComponents = 4;
+        source->pub.bitDepth = 8;
+        source->pub.interlaced = JNI_FALSE;
         source->pub.buffer = NULL;
         source->pub.row_num = 0;
         source->pub.error = JNI_FALSE;
         source->pub.error_msg[0] = '\0';
 
-        source->current_row = 0;
+        source->file = NULL;
+        source->num_pages = 0;
+
+        for(i = 0; i < MAX_THREADS; i++)
+        {
+            source->workers[i].tif = NULL;
+            source->workers[i].img_started = JNI_FALSE;
+            source->workers[i].failed = JNI_FALSE;
+        }
+
+        source->num_workers = 0;
+        source->bottom_up = JNI_FALSE;
+        source->band_height = 0;
+        source->window_bands = 0;
+        source->part_rows = 0;
+        source->window_start = 0;
+        source->window_end = 0;
+        source->native = JNI_FALSE;
         source->raster = NULL;
+        source->row_size = 0;
+        source->window_rows = 0;
+        source->current_row = 0;
+        source->image_row = 0;
 
         /* Fill in method ptrs */
+        source->pub.read_header = read_header_tiff;
         source->pub.start_input = start_input_tiff;
         source->pub.get_pixel_row = get_row_rgba;
         source->pub.finish_input = finish_input_tiff;
+        source->pub.get_byte_row = NULL;
+        source->pub.get_byte_rows = NULL;
+        source->pub.count_pages = count_pages_tiff;
     }
 
     /* return the reference to initialised parameter structure */
@@ -354,297 +1174,162 @@ void tiffWarningHandler(const char* module, const char* fmt, va_list ap)
 }
 
 /*
- * Reads the number of given bytes from the buffer.
- * Behaves like read(2)
+ * Writes data into the buffer.
+ * Not implemented for our reader.
+ */
+static tsize_t pipeWrite(thandle_t fd, tdata_t buf, tsize_t size)
+{
+    tiffErrorHandler("pipeWrite",
+                        "Writing of tiff images not supported", NULL);
+    return(tsize_t) -1;
+}
+
+/*
+ * Reads all the data from the source into one block of memory, doubling
+ * it in size whenever it fills.  This is needed in case the source is a
+ * stream, where we can not seek backwards.  The block belongs to the
+ * returned buffer and is released by memClose().
+ * Returns NULL if there was not enough memory.
  */
-static tsize_t pipeRead(thandle_t fd, tdata_t buf, tsize_t size)
+static mem_buffer_ptr buffer_file(DataSource src)
 {
-    file_buffer_ptr ptr;
-    int bytes_left, bytes_on_line, bytes_to_read, total, overflow;
-    char *inptr, *outptr;
+    mem_buffer_ptr ptr;
+    U_CHAR *data = NULL;
+    U_CHAR *new_data;
+    size_t allocated = 0;
+    size_t size = 0;
+    size_t wanted;
+    size_t num_read;
 
-    ptr = buffers[(int)fd];
+    ptr = (mem_buffer_ptr) malloc(sizeof(mem_buffer));
 
-    total = size;
-    bytes_left = size;
-    outptr = (char *) buf;
+    if(!ptr)
+    {
+        tiffErrorHandler("buffer_file", "Out of memory", NULL);
+        return NULL;
+    }
 
     do
     {
-        bytes_on_line = BUF_SIZE - ptr->current_offset;
-        bytes_to_read = MIN(bytes_left, bytes_on_line);
-
-        /* overflow is used to see if we try to read more bytes than exist */
-        overflow =  ptr->current_row * BUF_SIZE +
-                        ptr->current_offset + bytes_to_read - ptr->buffer_size;
-
-        if(overflow > 0)
+        if(size == allocated)
         {
-            total -= overflow;
-            bytes_to_read -= overflow;
-            bytes_left = bytes_to_read;
+            allocated = allocated ? allocated * 2 : BUF_SIZE;
+            new_data = (U_CHAR *) realloc(data, allocated);
+            if(!new_data)
+            {
+                /* not enough memory */
+                tiffErrorHandler("buffer_file", "Out of memory", NULL);
+                free(data);
+                free(ptr);
+                return NULL;
+            }
+
+            data = new_data;
         }
 
-        /* copy the data into output buffer */
-        inptr = ptr->rows[ptr->current_row] + ptr->current_offset;
-        memcpy(outptr, inptr, bytes_to_read);
-        ptr->current_offset += bytes_to_read;
-        bytes_left -= bytes_to_read;
+        wanted = allocated - size;
+        num_read = src_read(src, data + size, wanted);
+        size += num_read;
 
-        if(bytes_left > 0)
-        {
-            /* move to next row in buffer */
-            outptr += bytes_to_read;
-            ptr->current_row++;
-            ptr->current_offset = 0;
-        }
+        /* a short read means we have reached EOF */
+    } while(num_read == wanted);
+
+    ptr->data = data;
+    ptr->size = (toff_t) size;
+    ptr->offset = 0;
+    ptr->owned = data;
 
-    } while(bytes_left > 0);
+    return ptr;
+}
 
-    return(tsize_t) total;
+static void pipeUnMMap(thandle_t fd, tdata_t base, toff_t size)
+{
+    (void) fd;(void) base;(void) size;
 }
 
 /*
- * Writes data into the buffer.
- * Not implemented for our reader.
+ * Reads data straight out of the memory.
+ * Behaves like read(2)
  */
-static tsize_t pipeWrite(thandle_t fd, tdata_t buf, tsize_t size)
+static tsize_t memRead(thandle_t fd, tdata_t buf, tsize_t size)
 {
-    tiffErrorHandler("pipeWrite",
-                        "Writing of tiff images not supported", NULL);
-    return(tsize_t) -1;
+    mem_buffer_ptr ptr = (mem_buffer_ptr)fd;
+    toff_t bytes_left;
+
+    if(ptr->offset >= ptr->size)
+        return 0;
+
+    bytes_left = ptr->size - ptr->offset;
+    if((toff_t)size > bytes_left)
+        size = (tsize_t)bytes_left;
+
+    memcpy(buf, ptr->data + ptr->offset, size);
+    ptr->offset += size;
+
+    return size;
 }
 
 /*
- * Seeks to the given position in the buffer.
+ * Seeks to the given position in the memory.
  * Behaves like lseek(2)
  */
-static toff_t pipeSeek(thandle_t fd, toff_t off, int whence)
+static toff_t memSeek(thandle_t fd, toff_t off, int whence)
 {
-    file_buffer_ptr ptr;
-    int ret_val;
-    int seek_off;
-
-    ptr = buffers[(int)fd];
+    mem_buffer_ptr ptr = (mem_buffer_ptr)fd;
+    long seek_off;
 
     /* calculate absolute offset in buffer */
     if(whence == 0)
-        seek_off = off;
+        seek_off = (long)off;
     else if(whence == 1)
-        seek_off = ptr->current_row * BUF_SIZE + ptr->current_offset + off;
+        seek_off = (long)ptr->offset + (long)(int)off;
     else if(whence == 2)
-        seek_off = ptr->buffer_size + off;
+        seek_off = (long)ptr->size + (long)(int)off;
     else
     {
-        tiffWarningHandler("pipeSeek", "invalid whence", NULL);
-        seek_off = -1;
+        tiffWarningHandler("memSeek", "invalid whence", NULL);
+        return (toff_t) -1;
     }
 
     /* ensure offset is valid */
-    if(seek_off < 0 || seek_off >= ptr->buffer_size)
-        ret_val = -1;
-    else
-        ret_val = seek_off;
-
-    if(ret_val != -1)
-    {
-        /* now seek! */
-        ptr->current_row = seek_off / BUF_SIZE;
-        ptr->current_offset = seek_off % BUF_SIZE;
-    }
-
-    return(toff_t) ret_val;
-}
-
-/*
- * Frees the memory allocated to the internal buffers in
- * file buffer.
- */
-static void free_buffer(file_buffer_ptr ptr)
-{
-    int i;
-
-    /* free each of the rows */
-    for(i = 0; i < ptr->num_rows; i++)
-        free(ptr->rows[i]);
+    if(seek_off < 0 || seek_off > (long)ptr->size)
+        return (toff_t) -1;
 
-    /* free the array of row pointers */
-    free(ptr->rows);
+    ptr->offset = (toff_t)seek_off;
+    return ptr->offset;
 }
 
 /*
- * Assume that this is a cleanup function.
- * This releases memory allocated to our buffer.
- * File descriptor is left alone.
+ * Releases our view of the memory, along with the memory itself if
+ * it was read in from a stream.
  */
-static int pipeClose(thandle_t fd)
+static int memClose(thandle_t fd)
 {
-    file_buffer_ptr ptr = buffers[(int)fd];
+    mem_buffer_ptr ptr = (mem_buffer_ptr)fd;
 
-    /* assume that the file descriptor will be closed elsewhere */
-
-    /* however, free memory as it is assumed that this is a general */
-    /* cleanup function */
-    free_buffer(ptr);
+    free(ptr->owned);
     free(ptr);
-    buffers[(int)fd] = NULL;
-
     return 0;
 }
 
 /*
- * Returns size of the buffer
- */
-static toff_t pipeSize(thandle_t fd)
-{
-    file_buffer_ptr ptr = buffers[(int)fd];
-    return ptr->buffer_size;
-}
-
-/*
- * This fuction will attempt to fill the current buffer of the
- * file_buffer_ptr structure, from the input file descriptor.
- * Returns 1 on EOF, 0 otherwise
- * Called by buffer_file()
+ * Returns size of the memory block
  */
-static int read_one_buffer(int fd, file_buffer_ptr ptr)
+static toff_t memSize(thandle_t fd)
 {
-    char *buf_ptr;
-    int num_read;
-    int ret_val;
-
-    ret_val = 0;
-    buf_ptr = ptr->rows[ptr->current_row] + ptr->current_offset;
-    num_read = read(fd, buf_ptr,(BUF_SIZE - ptr->current_offset));
-
-    if(num_read == 0)
-    {
-        /* we have reached EOF */
-        ret_val = 1;
-    }
-    else if(num_read == -1)
-    {
-        /* error occured reading! */
-        tiffErrorHandler("read_one_buffer",
-                         "Error reading from file descriptor",
-                         NULL);
-        /* free any memory allocated */
-        free_buffer(ptr);
-        ret_val = 1;
-    }
-    else
-    {
-        /* everything is okay */
-        ptr->buffer_size += num_read;
-        ptr->current_offset += num_read;
-        if(ptr->current_offset >= BUF_SIZE)
-        {
-            ptr->current_offset = 0;
-            ptr->current_row++;
-        }
-    }
-
-    /* return whether we are at EOF or not */
-    return ret_val;
+    return ((mem_buffer_ptr)fd)->size;
 }
 
 /*
- * Reads all the data from the file descriptor into a temporary
- * buffer in memory.  This is needed in case the file descriptor
- * is a stream, where we can not seek backwards
+ * The image is already in memory, so hand it straight to the library
+ * rather than letting it copy each strip.
  */
-static void buffer_file(int fd)
+static int memMMap(thandle_t fd, tdata_t* pbase, toff_t* psize)
 {
-    file_buffer_ptr ptr;
-    int done;
-    char **tmp_ptr;
-
-    if(buffers[fd])
-        printf("pre-allocated buffer!\n");
-
-    buffers[fd] = (file_buffer_ptr) malloc(sizeof(file_buffer));
-    ptr = buffers[fd];
-
-    if(ptr)
-    {
-        /* initialise structure */
-        ptr->rows = NULL;
-        ptr->num_rows = 0;
-        ptr->buffer_size = 0;
-        ptr->current_row = 0;
-        ptr->current_offset = 0;
-
-        /* init flag */
-        done = 0;
-
-        do
-        {
-            if(ptr->current_offset != 0)
-            {
-                /* our last read did not fill up the buffer */
-                /* so attempt to fill the buffer now */
-                done = read_one_buffer(fd, ptr);
-            }
-            else
-            {
-                /* we are reading a new row into our buffer */
-
-                if(ptr->current_row >= ptr->num_rows)
-                {
-                    /* need to re allocate row pntrs */
-                    /* use malloc and memcpy as m$ realloc seems to be acting up */
-                    tmp_ptr = malloc((ptr->current_row+1)*sizeof(char *));
-                    if(tmp_ptr)
-                    {
-                        memcpy(tmp_ptr, ptr->rows, ptr->current_row * sizeof(char *));
-                        free(ptr->rows);
-
-                        ptr->rows = tmp_ptr;
-                        ptr->num_rows = ptr->current_row+1;
-                    }
-                    else
-                    {
-                        /* not enough memory */
-                        tiffErrorHandler("buffer_file", "Out of memory", NULL);
-                        free_buffer(ptr);
-                        done = 1;
-                    }
-                }
-
-                /* allocate memory for the new row */
-                ptr->rows[ptr->current_row] = (char *)malloc(BUF_SIZE * sizeof(char));
-                if(!ptr->rows[ptr->current_row])
-                {
-                    /* not enough memory */
-                    tiffErrorHandler("buffer_file", "Out of memory", NULL);
-                    free_buffer(ptr);
-                    done = 1;
-                }
-
-                /* attempt to fill this newly allocated row */
-                if(!done)
-                    done = read_one_buffer(fd, ptr);
-            }
-        } while(!done);
-
-        /* have finished reading so set file pointer to beginning */
-        ptr->current_row = 0;
-        ptr->current_offset = 0;
-    }
-    else
-    {
-        /* not enough memory */
-        tiffErrorHandler("buffer_file", "Out of memory", NULL);
-    }
-}
+    mem_buffer_ptr ptr = (mem_buffer_ptr)fd;
 
-static int pipeMMap(thandle_t fd, tdata_t* pbase, toff_t* psize)
-{
-    (void) fd;(void) pbase;(void) psize;
-     return(0);
-}
+    *pbase = (tdata_t)ptr->data;
+    *psize = ptr->size;
 
-static void pipeUnMMap(thandle_t fd, tdata_t base, toff_t size)
-{
-    (void) fd;(void) base;(void) size;
+    return(1);
 }
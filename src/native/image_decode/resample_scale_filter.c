@@ -0,0 +1,597 @@
+#include <math.h>
+#include "image_scale_filter.h"
+
+/*
+ * Separable resampling filters. Every destination pixel is a weighted sum
+ * of the source pixels under a filter kernel centred on it, worked out a
+ * row at a time across and then down. The weights only depend on the
+ * source and destination sizes, so they are worked out once per axis and
+ * kept as fixed point numbers, leaving the inner loops as plain integer
+ * multiply and adds.
+ */
+
+/* fixed point weights are in units of 1 / ( 1 << WEIGHT_BITS ) */
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE ( 1 << WEIGHT_BITS )
+
+/* largest component count handled */
+#define MAX_COMPONENTS 4
+
+/* Number of strip samples filtered down together */
+#define SUM_BLOCK 16
+
+/* filter kernel, giving the weight of a sample at distance x */
+typedef double (*kernel_func)( double x );
+
+/* structure containing shared scalor parameters */
+typedef struct _resample_struct *resample_ptr;
+typedef struct _resample_struct {
+	struct param pub;
+	kernel_func kernel;                     /* filter to weigh the samples with */
+	double support;                         /* distance beyond which the filter is 0 */
+} resample_struct;
+
+/*
+ * The source samples each destination pixel along one axis is made from.
+ * Every pixel uses the same number of taps, starting at its own source
+ * index, with any taps it does not need given no weight. Samples the
+ * filter reaches past the edges of the image are folded back onto the
+ * edge pixel.
+ */
+typedef struct _weight_table {
+	int taps;                               /* source samples per destination pixel */
+	int *start;                             /* first source pixel of each destination pixel */
+	int *weights;                           /* taps weights for each destination pixel */
+} weight_table;
+
+/* Triangle filter, for bilinear interpolation */
+static double triangle_kernel( double x ) {
+
+	if ( x < 0 ) {
+		x = -x;
+	}
+	if ( x < 1 ) {
+		return( 1 - x );
+	}
+	return( 0 );
+}
+
+/*
+ * Cubic filter from the B and C parameters of Mitchell and Netravali.
+ */
+static double cubic_kernel( double x, double B, double C ) {
+
+	if ( x < 0 ) {
+		x = -x;
+	}
+	if ( x < 1 ) {
+		return( ( ( 12 - 9 * B - 6 * C ) * x * x * x +
+		          ( -18 + 12 * B + 6 * C ) * x * x +
+		          ( 6 - 2 * B ) ) / 6 );
+	}
+	if ( x < 2 ) {
+		return( ( ( -B - 6 * C ) * x * x * x +
+		          ( 6 * B + 30 * C ) * x * x +
+		          ( -12 * B - 48 * C ) * x +
+		          ( 8 * B + 24 * C ) ) / 6 );
+	}
+	return( 0 );
+}
+
+/* Catmull-Rom cubic, which passes through the samples */
+static double catmull_rom_kernel( double x ) {
+	return( cubic_kernel( x, 0.0, 0.5 ) );
+}
+
+/* Mitchell-Netravali cubic, softer with less ringing */
+static double mitchell_kernel( double x ) {
+	return( cubic_kernel( x, 1.0 / 3, 1.0 / 3 ) );
+}
+
+/* sin(x) / x of pi times x */
+static double sinc( double x ) {
+
+	if ( x == 0 ) {
+		return( 1 );
+	}
+	x *= 3.14159265358979323846;
+	return( sin( x ) / x );
+}
+
+/* Lanczos windowed sinc with three lobes */
+static double lanczos3_kernel( double x ) {
+
+	if ( x < 0 ) {
+		x = -x;
+	}
+	if ( x < 3 ) {
+		return( sinc( x ) * sinc( x / 3 ) );
+	}
+	return( 0 );
+}
+
+/*
+ * Release the memory of a weight table.
+ */
+static void free_weights( weight_table *table ) {
+
+	free( table->start );
+	free( table->weights );
+	table->start = NULL;
+	table->weights = NULL;
+}
+
+/*
+ * Work out the weights for scaling one axis from srcSize to dstSize
+ * pixels. When shrinking, the filter is stretched to cover the source
+ * pixels falling inside each destination pixel. The fixed point weights
+ * of each destination pixel add up to exactly WEIGHT_ONE, so flat areas
+ * come out unchanged. Returns 0 if out of memory.
+ */
+static int build_weights( weight_table *table, int srcSize, int dstSize,
+                          kernel_func kernel, double support ) {
+
+	double scale, filter_scale, radius;
+	double center, total, v;
+	double *contrib;
+	int taps, first, last, lo, hi;
+	int i, j, t, k, sum, biggest;
+	int *w;
+
+	scale = (double)srcSize / dstSize;
+	filter_scale = ( scale > 1 ) ? scale : 1;
+	radius = support * filter_scale;
+
+	taps = (int)ceil( radius * 2 ) + 1;
+	if ( taps > srcSize ) {
+		taps = srcSize;
+	}
+
+	table->taps = taps;
+	table->start = (int*)malloc( dstSize * sizeof( int ) );
+	table->weights = (int*)malloc( (size_t)dstSize * taps * sizeof( int ) );
+	contrib = (double*)malloc( srcSize * sizeof( double ) );
+
+	if ( table->start == NULL || table->weights == NULL || contrib == NULL ) {
+		free_weights( table );
+		free( contrib );
+		return( 0 );
+	}
+
+	for ( i = 0; i < dstSize; i++ ) {
+		center = ( i + 0.5 ) * scale - 0.5;
+		first = (int)floor( center - radius ) + 1;
+		last = (int)ceil( center + radius ) - 1;
+
+		/*
+		 * weigh the samples strictly inside the filter, folding those off
+		 * the edge onto the edge. The range is taken from the filter rather
+		 * than from which weights are 0, so it only ever moves forward.
+		 */
+		lo = ( first < 0 ) ? 0 : ( first >= srcSize ) ? srcSize - 1 : first;
+		hi = ( last < 0 ) ? 0 : ( last >= srcSize ) ? srcSize - 1 : last;
+		for ( j = lo; j <= hi; j++ ) {
+			contrib[j] = 0;
+		}
+		total = 0;
+		for ( j = first; j <= last; j++ ) {
+			v = kernel( ( j - center ) / filter_scale );
+			k = ( j < 0 ) ? 0 : ( j >= srcSize ) ? srcSize - 1 : j;
+			contrib[k] += v;
+			total += v;
+		}
+		if ( total == 0 ) {
+			/* only when the filter misses every sample, use the nearest */
+			k = (int)floor( center + 0.5 );
+			k = ( k < 0 ) ? 0 : ( k >= srcSize ) ? srcSize - 1 : k;
+			contrib[k] = total = 1;
+			lo = hi = k;
+		}
+
+		/* keep the taps inside the image */
+		table->start[i] = ( lo < srcSize - taps ) ? lo : srcSize - taps;
+		w = table->weights + (size_t)i * taps;
+
+		sum = 0;
+		biggest = 0;
+		for ( t = 0; t < taps; t++ ) {
+			j = table->start[i] + t;
+			if ( j < lo || j > hi ) {
+				w[t] = 0;
+				continue;
+			}
+			w[t] = (int)floor( contrib[j] / total * WEIGHT_ONE + 0.5 );
+			sum += w[t];
+			if ( w[t] > w[biggest] ) {
+				biggest = t;
+			}
+		}
+		/* rounding leftovers go on the heaviest tap */
+		w[biggest] += WEIGHT_ONE - sum;
+	}
+
+	free( contrib );
+	return( 1 );
+}
+
+/*
+ * Widen one source row to integer samples. Without alpha each sample is
+ * its value times 256. Gray alpha and RGBA images have their colour
+ * premultiplied by the alpha and the alpha multiplied by 255, so all of
+ * the components stay within the same range.
+ */
+static void load_row( const jbyte *src, int *samples, int width, int cmp,
+                      int has_alpha ) {
+
+	const unsigned char *in = (const unsigned char *)src;
+	int i, k, a;
+
+	if ( !has_alpha ) {
+		for ( i = 0; i < width * cmp; i++ ) {
+			samples[i] = in[i] << 8;
+		}
+		return;
+	}
+
+	for ( i = 0; i < width; i++ ) {
+		a = in[cmp - 1];
+		for ( k = 0; k < cmp - 1; k++ ) {
+			samples[k] = in[k] * a;
+		}
+		samples[cmp - 1] = a * 255;
+
+		in += cmp;
+		samples += cmp;
+	}
+}
+
+/*
+ * Filter one widened source row across into a row of the strip. The
+ * results are kept at half the sample scale, which leaves room for the
+ * vertical pass to add up its taps without overflowing. Each component
+ * count has its own loop, so the components of a pixel stay in locals.
+ */
+static void filter_row_x( const weight_table *table, const int *samples,
+                          int *out, int width, int cmp ) {
+
+	const int round = 1 << WEIGHT_BITS;
+	const int shift = WEIGHT_BITS + 1;
+	const int taps = table->taps;
+	const int *w;
+	const int *in;
+	int s0, s1, s2, s3;
+	int i, t;
+
+	w = table->weights;
+
+	switch ( cmp ) {
+		case 1:
+		for ( i = 0; i < width; i++, w += taps ) {
+			in = samples + table->start[i];
+			s0 = round;
+			for ( t = 0; t < taps; t++ ) {
+				s0 += w[t] * in[t];
+			}
+			*out++ = s0 >> shift;
+		}
+		break;
+		case 2:
+		for ( i = 0; i < width; i++, w += taps ) {
+			in = samples + table->start[i] * 2;
+			s0 = s1 = round;
+			for ( t = 0; t < taps; t++, in += 2 ) {
+				s0 += w[t] * in[0];
+				s1 += w[t] * in[1];
+			}
+			*out++ = s0 >> shift;
+			*out++ = s1 >> shift;
+		}
+		break;
+		case 3:
+		for ( i = 0; i < width; i++, w += taps ) {
+			in = samples + table->start[i] * 3;
+			s0 = s1 = s2 = round;
+			for ( t = 0; t < taps; t++, in += 3 ) {
+				s0 += w[t] * in[0];
+				s1 += w[t] * in[1];
+				s2 += w[t] * in[2];
+			}
+			*out++ = s0 >> shift;
+			*out++ = s1 >> shift;
+			*out++ = s2 >> shift;
+		}
+		break;
+		case 4:
+		for ( i = 0; i < width; i++, w += taps ) {
+			in = samples + table->start[i] * 4;
+			s0 = s1 = s2 = s3 = round;
+			for ( t = 0; t < taps; t++, in += 4 ) {
+				s0 += w[t] * in[0];
+				s1 += w[t] * in[1];
+				s2 += w[t] * in[2];
+				s3 += w[t] * in[3];
+			}
+			*out++ = s0 >> shift;
+			*out++ = s1 >> shift;
+			*out++ = s2 >> shift;
+			*out++ = s3 >> shift;
+		}
+		break;
+	}
+}
+
+/*
+ * Filter the strip rows covering one destination row down into totals
+ * back at the full sample scale. The row is done in blocks, each summed
+ * over every tap in a local array before any of it is stored, so the
+ * compiler knows the sums can't overlap the rows and vectorises them.
+ */
+static void filter_rows_y( int **rows, const int *w, int taps, int *totals,
+                           int length ) {
+
+	const int round = 1 << ( WEIGHT_BITS - 2 );
+	const int shift = WEIGHT_BITS - 1;
+	const int *in;
+	int block[SUM_BLOCK];
+	int i, j, t, wt, sum;
+
+	for ( i = 0; i + SUM_BLOCK <= length; i += SUM_BLOCK ) {
+		for ( j = 0; j < SUM_BLOCK; j++ ) {
+			block[j] = round;
+		}
+		for ( t = 0; t < taps; t++ ) {
+			in = rows[t] + i;
+			wt = w[t];
+			for ( j = 0; j < SUM_BLOCK; j++ ) {
+				block[j] += wt * in[j];
+			}
+		}
+		for ( j = 0; j < SUM_BLOCK; j++ ) {
+			totals[i + j] = block[j] >> shift;
+		}
+	}
+	for ( ; i < length; i++ ) {
+		sum = round;
+		for ( t = 0; t < taps; t++ ) {
+			sum += w[t] * rows[t][i];
+		}
+		totals[i] = sum >> shift;
+	}
+}
+
+/*
+ * Turn the totals for one destination row into bytes, clamping any
+ * overshoot of the filter. Premultiplied colour is divided back out by
+ * the pixel's alpha, and pixels whose alpha rounds to clear come out all 0.
+ */
+static void store_row( const int *totals, jbyte *out, int width, int cmp,
+                       int has_alpha ) {
+
+	int i, k, v, a;
+
+	if ( !has_alpha ) {
+		for ( i = 0; i < width * cmp; i++ ) {
+			v = totals[i];
+			if ( v < 0 ) {
+				v = 0;
+			} else if ( v > 255 << 8 ) {
+				v = 255 << 8;
+			}
+			out[i] = (jbyte)( ( v + 128 ) >> 8 );
+		}
+		return;
+	}
+
+	for ( i = 0; i < width; i++ ) {
+		a = totals[cmp - 1];
+		v = ( a + 127 ) / 255;
+		if ( v <= 0 ) {
+			for ( k = 0; k < cmp; k++ ) {
+				out[k] = 0;
+			}
+		} else {
+			out[cmp - 1] = (jbyte)( ( v > 255 ) ? 255 : v );
+			for ( k = 0; k < cmp - 1; k++ ) {
+				v = totals[k];
+				if ( v <= 0 ) {
+					v = 0;
+				} else {
+					v = ( v * 255 + a / 2 ) / a;
+					if ( v > 255 ) {
+						v = 255;
+					}
+				}
+				out[k] = (jbyte)v;
+			}
+		}
+
+		totals += cmp;
+		out += cmp;
+	}
+}
+
+/*
+ * Initialize num_rows rows of the destination byte buffer, starting at
+ * first_row, with image data scaled to the width and height specified
+ * from the source byte buffer.
+ *
+ * Source rows are filtered across into a strip holding just the rows
+ * the current destination row needs, which stays in cache. Destination
+ * rows move down the source in order, so each source row is filtered
+ * across once and the strip is used as a ring. Every destination row
+ * only depends on its own source rows, so a band of rows comes out the
+ * same however the image is split up. Source rows are fetched once each
+ * and in order, so they can be decoded as they are needed, and the scale
+ * stops early if one can't be had. Returns 0 if out of memory.
+ */
+static int resample_scale( FilterParam params, int first_row, int num_rows ) {
+
+	int srcWidth, srcHeight, srcComponents;
+	int dstWidth, dstHeight;
+	int has_alpha;
+
+	weight_table x_table;
+	weight_table y_table;
+	weight_table *y_weights;
+	int *samples;
+	int *strip;
+	int *totals;
+	int **rows;
+
+	int dstRowLength;
+	int next_sy;
+	int sy, dy, t, taps;
+
+	const jbyte *srcRow;
+	jbyte *dstBuffer;
+
+	resample_ptr source = (resample_ptr)params;
+
+	srcWidth = source->pub.srcWidth;
+	srcHeight = source->pub.srcHeight;
+	srcComponents = source->pub.srcComponents;
+
+	dstWidth = source->pub.dstWidth;
+	dstHeight = source->pub.dstHeight;
+	dstBuffer = source->pub.dst_pixel_data;
+
+	if ( srcComponents < 1 || srcComponents > MAX_COMPONENTS ||
+	     srcWidth < 1 || srcHeight < 1 || dstWidth < 1 || dstHeight < 1 ) {
+		return( 1 );
+	}
+
+	/* gray alpha and RGBA images have alpha as the last component */
+	has_alpha = ( srcComponents == 2 || srcComponents == 4 );
+	dstRowLength = dstWidth * srcComponents;
+
+	x_table.start = x_table.weights = NULL;
+	y_table.start = y_table.weights = NULL;
+
+	if ( !build_weights( &x_table, srcWidth, dstWidth,
+	                     source->kernel, source->support ) ) {
+		return( 0 );
+	}
+
+	/* square images scaled evenly share the one table */
+	if ( srcWidth == srcHeight && dstWidth == dstHeight ) {
+		y_weights = &x_table;
+	} else if ( build_weights( &y_table, srcHeight, dstHeight,
+	                           source->kernel, source->support ) ) {
+		y_weights = &y_table;
+	} else {
+		free_weights( &x_table );
+		return( 0 );
+	}
+	taps = y_weights->taps;
+
+	samples = (int*)malloc( (size_t)srcWidth * srcComponents * sizeof( int ) );
+	strip = (int*)malloc( (size_t)taps * dstRowLength * sizeof( int ) );
+	totals = (int*)malloc( dstRowLength * sizeof( int ) );
+	rows = (int**)malloc( taps * sizeof( int* ) );
+
+	if ( samples == NULL || strip == NULL || totals == NULL || rows == NULL ) {
+		free( samples );
+		free( strip );
+		free( totals );
+		free( rows );
+		free_weights( &x_table );
+		free_weights( &y_table );
+		return( 0 );
+	}
+
+	///////////////////////////////////////////////////////////////////
+	next_sy = 0;
+
+	for ( dy = first_row; dy < first_row + num_rows; dy++ ) {
+		sy = y_weights->start[dy];
+		if ( next_sy < sy ) {
+			next_sy = sy;
+		}
+
+		/* filter across the source rows not yet in the strip */
+		while ( next_sy < sy + taps ) {
+			srcRow = SRC_ROW( &source->pub, next_sy );
+			if ( srcRow == NULL ) {
+				break;
+			}
+			load_row( srcRow, samples, srcWidth, srcComponents, has_alpha );
+			filter_row_x( &x_table, samples,
+			              strip + (size_t)( next_sy % taps ) * dstRowLength,
+			              dstWidth, srcComponents );
+			next_sy++;
+		}
+		if ( next_sy < sy + taps ) {
+			break;
+		}
+
+		for ( t = 0; t < taps; t++ ) {
+			rows[t] = strip + (size_t)( ( sy + t ) % taps ) * dstRowLength;
+		}
+
+		filter_rows_y( rows, y_weights->weights + (size_t)dy * taps, taps,
+		               totals, dstRowLength );
+		store_row( totals, dstBuffer + (size_t)dy * dstRowLength,
+		           dstWidth, srcComponents, has_alpha );
+	}
+	///////////////////////////////////////////////////////////////////
+	free( samples );
+	free( strip );
+	free( totals );
+	free( rows );
+	free_weights( &x_table );
+	free_weights( &y_table );
+	return( 1 );
+}
+
+/*
+ * Allocate and return a parameter structure to contain the shared data
+ * of the scaling operation, filtering with the kernel given.
+ */
+static FilterParam resample_init( kernel_func kernel, double support ) {
+
+	resample_ptr source;
+
+	/* Create module interface object */
+	source = (resample_ptr)malloc(sizeof(resample_struct));
+
+	if (source != NULL) {
+		source->pub.srcWidth = -1;
+		source->pub.srcHeight = -1;
+		source->pub.srcComponents = 3;
+		source->pub.src_pixel_data = NULL;
+		source->pub.get_src_row = NULL;
+		source->pub.src_row_data = NULL;
+		source->pub.dstWidth = -1;
+		source->pub.dstHeight = -1;
+		source->pub.dstComponents = 3;
+		source->pub.dst_pixel_data = NULL;
+
+		source->pub.scale_func = resample_scale;
+
+		source->kernel = kernel;
+		source->support = support;
+	}
+
+	/* return the reference to initialized parameter structure */
+	return( (FilterParam)source );
+}
+
+/* Bilinear interpolation */
+FilterParam bilinear_init( ) {
+	return( resample_init( triangle_kernel, 1 ) );
+}
+
+/* Catmull-Rom bicubic interpolation */
+FilterParam bicubic_init( ) {
+	return( resample_init( catmull_rom_kernel, 2 ) );
+}
+
+/* Mitchell-Netravali cubic filter */
+FilterParam mitchell_init( ) {
+	return( resample_init( mitchell_kernel, 2 ) );
+}
+
+/* Lanczos filter with three lobes */
+FilterParam lanczos3_init( ) {
+	return( resample_init( lanczos3_kernel, 3 ) );
+}
@@ -0,0 +1,219 @@
+/*****************************************************************************
+ *                The Virtual Light Company Copyright (c) 1999 - 2000
+ *                               C Source
+ *
+ * This code is licensed under the GNU Library GPL. Please read license.txt
+ * for the full details. A copy of the LGPL may be found at
+ *
+ * http://www.gnu.org/copyleft/lgpl.html
+ *
+ * Project:    Image Content Handlers
+ * URL:        http://www.vlc.com.au/imageloader/
+ *
+ ****************************************************************************/
+
+/*
+ * Minimal threading support for splitting the work of decoding an image
+ * across processors. Work is handed out as a fixed number of parts and
+ * the caller waits for all of them to finish, so all that is needed from
+ * the platform is starting a thread and joining it again. The threads
+ * never call back into java.
+ *
+ * Threads are started for each piece of work rather than kept in a pool,
+ * but the number running at once is shared between every caller, so
+ * several images being scaled or decoded together can't start more
+ * threads between them than there are processors to run them.
+ */
+
+#include <stdlib.h>
+
+#include "decode_image.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* One part of the work, and the thread running it */
+typedef struct _thread_part {
+   ThreadTask task;                 /* the work to do */
+   void *data;                      /* shared data passed to the task */
+   int part;                        /* which part this is */
+   int started;                     /* TRUE if running in its own thread */
+#ifdef _WIN32
+   HANDLE thread;
+#else
+   pthread_t thread;
+#endif
+} thread_part;
+
+/* Threads started by run_parallel() that are still running, across all */
+/* callers. The calling threads themselves aren't counted.              */
+static int threads_busy = 0;
+
+#ifdef _WIN32
+static LONG busy_lock = 0;
+#else
+static pthread_mutex_t busy_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+/*
+ * Take or give back entries in the shared count of running threads.
+ */
+static void lock_busy(void)
+{
+#ifdef _WIN32
+   while (InterlockedCompareExchange(&busy_lock, 1, 0) != 0)
+      Sleep(0);
+#else
+   pthread_mutex_lock(&busy_lock);
+#endif
+}
+
+static void unlock_busy(void)
+{
+#ifdef _WIN32
+   InterlockedExchange(&busy_lock, 0);
+#else
+   pthread_mutex_unlock(&busy_lock);
+#endif
+}
+
+/*
+ * Reserve up to wanted extra threads, so that the threads started by
+ * all callers together stay below the number of processors. Returns
+ * how many may be started, possibly 0.
+ */
+static int reserve_threads(int wanted)
+{
+   int spare;
+
+   lock_busy();
+
+   spare = num_processors() - 1 - threads_busy;
+   if (spare < 0)
+      spare = 0;
+   if (wanted > spare)
+      wanted = spare;
+   threads_busy += wanted;
+
+   unlock_busy();
+
+   return wanted;
+}
+
+static void release_threads(int count)
+{
+   lock_busy();
+   threads_busy -= count;
+   unlock_busy();
+}
+
+
+/*
+ * Entry point of each thread started by run_parallel().
+ */
+#ifdef _WIN32
+static DWORD WINAPI run_part(LPVOID arg)
+#else
+static void *run_part(void *arg)
+#endif
+{
+   thread_part *part = (thread_part *) arg;
+
+   part->task(part->data, part->part);
+
+   return 0;
+}
+
+/*
+ * Work out how many processors are available to run threads on.
+ * Always returns at least 1.
+ */
+int num_processors(void)
+{
+   long count;
+
+#ifdef _WIN32
+   SYSTEM_INFO info;
+
+   GetSystemInfo(&info);
+   count = (long) info.dwNumberOfProcessors;
+#else
+   count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+   if (count < 1)
+      return 1;
+
+   return (int) count;
+}
+
+/*
+ * Run task once for each of num_parts parts and wait for them all to
+ * finish. Part 0 runs on the calling thread and the rest get a thread
+ * each, as long as a processor is free for it once the threads of other
+ * callers are counted. Any part that doesn't get a thread, because
+ * there are too many or one can't be started, is run on the calling
+ * thread instead, so the work is always done.
+ */
+void run_parallel(ThreadTask task, void *data, int num_parts)
+{
+   thread_part *parts;
+   int num_threads;
+   int reserved;
+   int i;
+
+   reserved = (num_parts > 1) ? reserve_threads(num_parts - 1) : 0;
+   num_threads = reserved + 1;
+
+   parts = NULL;
+   if (reserved > 0) {
+      parts = (thread_part *) malloc(num_threads * sizeof(thread_part));
+      if (parts == NULL) {
+         release_threads(reserved);
+         reserved = 0;
+         num_threads = 1;
+      }
+   }
+
+   for (i = 1; i < num_threads; i++) {
+      parts[i].task = task;
+      parts[i].data = data;
+      parts[i].part = i;
+
+#ifdef _WIN32
+      parts[i].thread = CreateThread(NULL, 0, run_part, &parts[i], 0, NULL);
+      parts[i].started = (parts[i].thread != NULL);
+#else
+      parts[i].started =
+         (pthread_create(&parts[i].thread, NULL, run_part, &parts[i]) == 0);
+#endif
+   }
+
+   if (num_parts > 0)
+      task(data, 0);
+
+   for (i = num_threads; i < num_parts; i++)
+      task(data, i);
+
+   for (i = 1; i < num_threads; i++) {
+      if (parts[i].started) {
+#ifdef _WIN32
+         WaitForSingleObject(parts[i].thread, INFINITE);
+         CloseHandle(parts[i].thread);
+#else
+         pthread_join(parts[i].thread, NULL);
+#endif
+      }
+      else
+         task(data, i);
+   }
+
+   if (reserved > 0)
+      release_threads(reserved);
+
+   free(parts);
+}
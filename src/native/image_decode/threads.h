@@ -0,0 +1,38 @@
+/*****************************************************************************
+ *                The Virtual Light Company Copyright (c) 1999 - 2000
+ *                               C Source
+ *
+ * This code is licensed under the GNU Library GPL. Please read license.txt
+ * for the full details. A copy of the LGPL may be found at
+ *
+ * http://www.gnu.org/copyleft/lgpl.html
+ *
+ ****************************************************************************/
+
+/*****************************************************************************/
+#ifndef _THREADS_H
+#define _THREADS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most threads a caller keeping its per thread state in a fixed */
+/* table splits its work between. run_parallel() has no limit.   */
+#define MAX_THREADS 32
+
+/* A piece of work that can be split across threads.  It is called   */
+/* once for each part, with the same data, and must only touch the   */
+/* output belonging to its own part.                                 */
+typedef void (*ThreadTask)(void *data, int part);
+
+/* from threads.c */
+extern int num_processors(void);
+extern void run_parallel(ThreadTask task, void *data, int num_parts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _THREADS_H */
+/******************************************************************************/